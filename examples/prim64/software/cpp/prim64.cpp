@@ -20,19 +20,29 @@
  * Code for running a Parquet to Arrow converter for 64 bit primitives on FPGA.
  *
  * Inputs:
- *  parquet_hw_input_file_path: file_path to hardware compatible Parquet file
+ *  parquet_hw_input_file_path: file_path to hardware compatible Parquet file, or index_path:column_name to read only the pages of
+ *    a plain encoded column listed in the index.tsv of a transcoded directory
  *  reference_parquet_file_path: file_path to Parquet file compatible with the standard Arrow library Parquet reading functions. 
  *    This file should contain the same values as the first file and is used for verifying the hardware output.
  *  num_val: How many values to read.
+ *  segment_size: Optional, bytes of pages per segment when pipelining the copies with the kernel. 0 (default) disables pipelining.
+ *  cpu_threads: Optional, splits the column between the FPGA and this many software decoding threads. 0 (default) reads it on
+ *    the FPGA only. Without earlier reads to measure the throughput of both sides on, half of the values go to either side.
+ *  runs: Optional, how often the column is read, 1 by default. The readers are reused, so from the second run on the hybrid
+ *    split follows the throughput of both sides in the run before.
+ *  instances: Optional, reads with MultiKernelReader on this many ParquetReader instances instead of with FpgaReader. 0 (default)
+ *    reads with FpgaReader. Only the emulated platform has multi-instance register blocks, so run with PTOA_PLATFORM=ptoa_emu and
+ *    PTOA_EMU_INSTANCES set to the same number. segment_size doesn't apply, and cpu_threads can't be combined with it.
+ *  poll_interval_us: Optional, polls the kernel status every this many microseconds. 0 (default) polls adaptively, see
+ *    CompletionPoller.
  */
 
-#include <chrono>
+#include <algorithm>
 #include <memory>
 #include <vector>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
-#include <random>
 #include <stdlib.h>
 #include <unistd.h>
 
@@ -40,67 +50,17 @@
 #include <arrow/api.h>
 #include <arrow/io/api.h>
 #include <parquet/arrow/reader.h>
-#include <parquet/arrow/writer.h>
 
-// Fletcher
-#include "fletcher/api.h"
+// Host runtime for the ParquetReader kernels
+#include "FpgaReader.h"
+#include "HybridReader.h"
+#include "MultiKernelReader.h"
 
-#define REG_BASE 10
+// Chrome trace export, enabled by setting PTOA_TRACE
+#include "trace.h"
 
 #define PRIM_WIDTH 64
 
-std::shared_ptr<arrow::RecordBatch> prepareRecordBatch(uint32_t num_val) {
-  std::shared_ptr<arrow::Buffer> values;
-
-  arrow::Result<std::shared_ptr<arrow::Buffer>> bufResult = arrow::AllocateBuffer(sizeof(int64_t)*num_val);
-  if (bufResult.ok()) {
-	  values = bufResult.ValueOrDie();
-  } else {
-    throw std::runtime_error("Could not allocate values buffer.");
-  }
-
-  auto array = std::make_shared<arrow::Int64Array>(arrow::int64(), num_val, values);
-
-//  This function no longer exists, not sure if passing meta data is necessary
-//  auto schema_meta = metaMode(fletcher::Mode::WRITE);
-  std::shared_ptr<arrow::Schema> schema = arrow::schema({arrow::field("int", arrow::int64(), false)});//, schema_meta);
-
-  auto rb = arrow::RecordBatch::Make(schema, num_val, {array});
-
-  return rb;
-}
-
-void setPtoaArguments(std::shared_ptr<fletcher::Platform> platform, uint32_t num_val,
-		uint64_t max_size, da_t device_parquet_address) {
-  dau_t mmio64_writer;
-
-  platform->WriteMMIO(REG_BASE + 0, num_val);
-
-  mmio64_writer.full = device_parquet_address;
-  platform->WriteMMIO(REG_BASE + 1, mmio64_writer.lo);
-  platform->WriteMMIO(REG_BASE + 2, mmio64_writer.hi);
-  
-  mmio64_writer.full = max_size;
-  platform->WriteMMIO(REG_BASE + 3, mmio64_writer.lo);
-  platform->WriteMMIO(REG_BASE + 4, mmio64_writer.hi);
-  
-  return;
-}
-
-void checkMMIO(std::shared_ptr<fletcher::Platform> platform, uint32_t num_val) {
-  uint32_t value32;
-
-  platform->ReadMMIO(REG_BASE + 0, &value32);
-
-  std::cout << "MMIO num_val=" << value32 << ", should be " << num_val << std::endl;
-
-  for (int i = 0; i < 15; i++) {
-    platform->ReadMMIO(i, &value32);
-  }
-
-
-}
-
 //Use standard Arrow library functions to read Arrow array from Parquet file
 //Only works for Parquet version 1 style files.
 std::shared_ptr<arrow::ChunkedArray> readArray(std::string hw_input_file_path) {
@@ -125,153 +85,176 @@ std::shared_ptr<arrow::ChunkedArray> readArray(std::string hw_input_file_path) {
 
 int main(int argc, char **argv) {
 
-  fletcher::Status status;
-  std::shared_ptr<fletcher::Platform> platform;
-  std::shared_ptr<fletcher::Context> context;
-
   fletcher::Timer t;
 
   char* hw_input_file_path;
   char* reference_parquet_file_path;
   uint32_t num_val;
-  uint64_t file_size;
-  uint8_t* file_data;
+  int64_t segment_size = 0;
+  int cpu_threads = 0;
+  int runs = 1;
+  int instances = 0;
+  int poll_interval_us = 0;
 
   if (argc > 3) {
     hw_input_file_path = argv[1];
     reference_parquet_file_path = argv[2];
     num_val = (uint32_t) std::strtoul(argv[3], nullptr, 10);
+    if (argc > 4) {
+      segment_size = std::strtoll(argv[4], nullptr, 10);
+    }
+    if (argc > 5) {
+      cpu_threads = std::atoi(argv[5]);
+    }
+    if (argc > 6) {
+      runs = std::max(1, std::atoi(argv[6]));
+    }
+    if (argc > 7) {
+      instances = std::max(0, std::atoi(argv[7]));
+    }
+    if (argc > 8) {
+      poll_interval_us = std::max(0, std::atoi(argv[8]));
+    }
+    if (instances > 0 && cpu_threads > 0) {
+      std::cerr << "cpu_threads and instances can't be combined, hybrid reads run on FpgaReader" << std::endl;
+      return 1;
+    }
 
   } else {
-    std::cerr << "Usage: prim64 <parquet_hw_input_file_path> <reference_parquet_file_path> <num_values>" << std::endl;
+    std::cerr << "Usage: prim64 <parquet_hw_input_file_path or index_path:column_name> <reference_parquet_file_path> <num_values> [segment_size] [cpu_threads] [runs] [instances] [poll_interval_us]" << std::endl;
     return 1;
   }
 
-  // Create a Fletcher platform object, attempting to autodetect the platform.
-  status = fletcher::Platform::Make(&platform, false);
-
-  if (!status.ok()) {
-	std::cerr << "Could not create Fletcher platform." << std::endl;
-	return -1;
-  }
+  Trace::global().enable_from_env();
+  Trace::global().name_thread("host");
 
   /*************************************************************
   * Parquet file reading
   *************************************************************/
 
-  //Open parquet file
-  std::ifstream parquet_file;
-  parquet_file.open(hw_input_file_path, std::ifstream::binary);
-
-  if(!parquet_file.is_open()) {
-    std::cerr << "Error opening Parquet file" << std::endl;
-    return 1;
-  }
-
-  //Get filesize
-  parquet_file.seekg (0, parquet_file.end);
-  file_size = parquet_file.tellg();
-  parquet_file.seekg (4, parquet_file.beg); //Skip past Parquet magic number
-
-  //Read file data
-  //file_data = (uint8_t*)std::malloc(file_size);
-  posix_memalign((void**)&file_data, 4096, file_size - 4);
-  parquet_file.read((char *)file_data, file_size - 4);
-  unsigned int checksum = 0;
-  for (int i = 0; i < file_size; i++) {
-    checksum += file_data[i];
+  // Skip the magic number, the kernel starts at the first page. A column in an index starts at the offset the index lists.
+  std::string hw_input(hw_input_file_path);
+  size_t index_separator = hw_input.find(".tsv:");
+  std::shared_ptr<arrow::Buffer> file_data;
+  {
+    TraceSpan span("read file", "io");
+    if (index_separator != std::string::npos) {
+      ptoa::column_index_entry entry;
+      if (ptoa::FpgaReader::load_column(hw_input.substr(0, index_separator + 4), hw_input.substr(index_separator + 5), &entry, &file_data) != ptoa::status::OK) {
+        return 1;
+      }
+      // The kernels of the examples read PLAIN pages
+      if (entry.prim_width != PRIM_WIDTH || entry.enc != ptoa::encoding::PLAIN || entry.num_values < num_val) {
+        std::cerr << "Column " << entry.column_name << " is not a plain encoded " << PRIM_WIDTH << " bit column with at least "
+                  << num_val << " values" << std::endl;
+        return 1;
+      }
+    } else if (ptoa::FpgaReader::load_file(hw_input_file_path, 4, &file_data) != ptoa::status::OK) {
+      return 1;
+    }
   }
-  printf("Parquet file checksum 0x%lu\n", checksum);
 
   /*************************************************************
-  * FPGA RecordBatch preparation
+  * FPGA Initialization
   *************************************************************/
 
   t.start();
-  auto arrow_rb_fpga = prepareRecordBatch(num_val);
+  ptoa::FpgaReader reader;
+  ptoa::MultiKernelReader multi_reader;
+  if (instances > 0) {
+    if (multi_reader.init(instances) != ptoa::status::OK) {
+      return -1;
+    }
+    multi_reader.set_poll_interval(poll_interval_us);
+  } else {
+    if (reader.init() != ptoa::status::OK) {
+      return -1;
+    }
+    reader.set_segment_size(segment_size);
+    reader.set_poll_interval(poll_interval_us);
+  }
   t.stop();
-  std::cout << "Prepare FPGA RecordBatch         : "
+  std::cout << "FPGA Initialize                  : "
             << t.seconds() << std::endl;
-  auto result_array = std::dynamic_pointer_cast<arrow::Int64Array>(arrow_rb_fpga->column(0));
-  auto result_buffer_raw_data = result_array->values()->mutable_data();
-  auto result_buffer_size = result_array->values()->size();
 
   /*************************************************************
-  * FPGA Initilialization
+  * FPGA processing
   *************************************************************/
 
-   // Create and initialize platform
-   fletcher::Platform::Make(&platform).ewf("Could not create platform.");
-   platform->Init();
-
-   //Create context and kernel
-   fletcher::Context::Make(&context, platform);
-   fletcher::Kernel kernel(context);
-
-   t.start();
-   kernel.Reset();
-
-   //Setup destination recordbatch on device
-   context->QueueRecordBatch(arrow_rb_fpga);
-   context->Enable();
-
-  //Malloc parquet file on device
-   da_t device_parquet_address;
-   if (strcmp("oc-accel", platform->name().c_str()) == 0
-   		  || strcmp("snap", platform->name().c_str()) == 0) {
-       printf("Platform [%s]: Skipping device buffer allocation and host to device copy.\n",
-       		platform->name().c_str());
-       // Set all the MMIO registers to their correct value
-       setPtoaArguments(platform, num_val, file_size, (da_t)(file_data));
-     } else {
-       platform->DeviceMalloc(&device_parquet_address, file_size);
-
-       // Set all the MMIO registers to their correct value
-       setPtoaArguments(platform, num_val, file_size, device_parquet_address);
-    }
-  t.stop();
-  std::cout << "FPGA Initialize                  : "
-               << t.seconds() << std::endl;
-  checkMMIO(platform, num_val);
-
-  // Make sure all buffer memory is allocated
-  memset(result_buffer_raw_data, 0, result_buffer_size);
+  std::shared_ptr<arrow::PrimitiveArray> prim_array;
+  // Reused by all runs, so that every run is split on the throughput measured in the run before
+  std::unique_ptr<ptoa::HybridReader> hybrid_reader;
+  if (cpu_threads > 0) {
+    hybrid_reader.reset(new ptoa::HybridReader(&reader, cpu_threads));
+  }
 
-  /*************************************************************
-  * FPGA host to device copy
-  *************************************************************/
+  for (int run = 0; run < runs; run++) {
+    if (runs > 1) {
+      std::cout << "Run                              : "
+                << run << std::endl;
+    }
 
-  t.start();
-  platform->CopyHostToDevice(file_data, device_parquet_address, file_size);
-  t.stop();
-  std::cout << "FPGA host to device copy         : "
-              << t.seconds() << std::endl;
+    if (instances > 0) {
+      if (multi_reader.read_prim(PRIM_WIDTH, num_val, file_data->data(), file_data->size(), &prim_array) != ptoa::status::OK) {
+        return 1;
+      }
 
-  /*************************************************************
-  * FPGA processing
-  *************************************************************/
+      for (const ptoa::fpga_task_stats& task_stats : multi_reader.get_last_task_stats()) {
+        std::cout << "Instance " << std::setw(3) << std::left << task_stats.instance << std::right << " processing time     : "
+                  << task_stats.processing << std::endl;
+      }
+      std::cout << "Multi-instance end to end time   : "
+                << multi_reader.get_last_run_seconds() << std::endl;
+      continue;
+    }
 
-  t.start();
-  kernel.Start();
-  kernel.PollUntilDoneInterval(10);
-  t.stop();
-  std::cout << "FPGA processing time             : "
-            << t.seconds() << std::endl;
+    if (hybrid_reader) {
+      // The kernels of the examples read PLAIN pages
+      if (hybrid_reader->read_prim(PRIM_WIDTH, num_val, file_data->data(), file_data->size(), ptoa::encoding::PLAIN, &prim_array) != ptoa::status::OK) {
+        return 1;
+      }
 
-  /*************************************************************
-  * FPGA device to host copy
-  *************************************************************/
+      const ptoa::hybrid_read_stats& hybrid_stats = hybrid_reader->get_last_read_stats();
+      std::cout << "Hybrid FPGA pages / values       : "
+                << hybrid_stats.fpga_pages << " / " << hybrid_stats.fpga_values << std::endl;
+      std::cout << "Hybrid FPGA time                 : "
+                << hybrid_stats.fpga_seconds << std::endl;
+      std::cout << "Hybrid CPU pages / values        : "
+                << hybrid_stats.cpu_pages << " / " << hybrid_stats.cpu_values << std::endl;
+      std::cout << "Hybrid CPU time                  : "
+                << hybrid_stats.cpu_seconds << std::endl;
+      std::cout << "Hybrid end to end time           : "
+                << hybrid_stats.total << std::endl;
+    } else if (reader.read_prim(PRIM_WIDTH, num_val, file_data->data(), file_data->size(), &prim_array) != ptoa::status::OK) {
+      return 1;
+    }
 
-  t.start();
-  platform->CopyDeviceToHost(context->device_buffer(0).device_address,
-                             result_buffer_raw_data,
-                             sizeof(int64_t) * (num_val));
-  t.stop();
+    const ptoa::fpga_read_stats& stats = reader.get_last_read_stats();
+
+    std::cout << "FPGA host to device copy         : "
+              << stats.copy_to_device << std::endl;
+    std::cout << "FPGA processing time             : "
+              << stats.processing << std::endl;
+    std::cout << "FPGA device to host copy         : "
+              << stats.copy_to_host << std::endl;
+    std::cout << "FPGA end to end time             : "
+              << stats.total << std::endl;
+    std::cout << "FPGA segments                    : "
+              << stats.num_segments << std::endl;
+  }
 
+  // Accumulated over all runs. Completion is the time from the start of a kernel until a poll saw it done, detection the most
+  // that poll could have been late.
+  const ptoa::poll_stats poll_stats = instances > 0 ? multi_reader.get_poll_stats() : reader.get_poll_stats();
+  std::cout << "Kernel completions / polls       : "
+            << poll_stats.num_completions << " / " << poll_stats.total_polls << std::endl;
+  std::cout << "Kernel completion p50/p90/p99    : "
+            << poll_stats.completion.p50 << " / " << poll_stats.completion.p90 << " / " << poll_stats.completion.p99 << std::endl;
+  std::cout << "Kernel detection p50/p90/p99     : "
+            << poll_stats.detection.p50 << " / " << poll_stats.detection.p90 << " / " << poll_stats.detection.p99 << std::endl;
+  auto result_array = std::static_pointer_cast<arrow::Int64Array>(prim_array);
   size_t total_arrow_size = sizeof(int64_t) * num_val;
-  
-  std::cout << "FPGA device to host copy         : "
-            << t.seconds() << std::endl;
+
   std::cout << "Arrow buffers total size         : "
             << total_arrow_size << std::endl;
 
@@ -307,7 +290,7 @@ int main(int argc, char **argv) {
     }
   }
 
-  std::free(file_data);
+  Trace::global().write();
 
   return 0;
 
@@ -24,15 +24,16 @@
  *  reference_parquet_file_path: file_path to Parquet file compatible with the standard Arrow library Parquet reading functions. 
  *    This file should contain the same values as the first file and is used for verifying the hardware output.
  *  num_val: How many values to read.
+ *  poll_interval_us: Optional, polls the kernel status every this many microseconds. 0 (default) polls adaptively, see
+ *    CompletionPoller.
  */
 
-#include <chrono>
+#include <algorithm>
 #include <memory>
 #include <array>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
-#include <random>
 #include <stdlib.h>
 #include <unistd.h>
 
@@ -40,65 +41,18 @@
 #include <arrow/api.h>
 #include <arrow/io/api.h>
 #include <parquet/arrow/reader.h>
-#include <parquet/arrow/writer.h>
 
-// Fletcher
-#include "fletcher/api.h"
+// Host runtime for the ParquetReader kernels
+#include "FpgaReader.h"
 
-#define REG_BASE 10
+// Chrome trace export, enabled by setting PTOA_TRACE
+#include "trace.h"
 
 int min(int a, int b) {
 	if (a < b) return a;
 	else return b;
 }
 
-std::shared_ptr<arrow::RecordBatch> prepareRecordBatch(uint32_t num_strings, uint32_t num_chars) {
-  std::shared_ptr<arrow::Buffer> values;
-  std::shared_ptr<arrow::Buffer> offsets;
-
-  arrow::Result<std::shared_ptr<arrow::Buffer>> bufResult = arrow::AllocateBuffer(num_chars);
-  if (bufResult.ok()) {
-	  values = bufResult.ValueOrDie();
-  } else {
-    throw std::runtime_error("Could not allocate values buffer.");
-  }
-
-  bufResult = arrow::AllocateBuffer(sizeof(int32_t)*(num_strings+1));
-  if (bufResult.ok()) {
-	offsets = bufResult.ValueOrDie();
-  } else {
-    throw std::runtime_error("Could not allocate offsets buffer.");
-  }
-
-  auto array = std::make_shared<arrow::StringArray>(num_strings, offsets, values);
-
-//  This function no longer exists, not sure if passing meta data is necessary
-//  auto schema_meta = metaMode(fletcher::Mode::WRITE);
-  std::shared_ptr<arrow::Schema> schema = arrow::schema({arrow::field("str", arrow::utf8(), false)});//, schema_meta);
-
-  auto rb = arrow::RecordBatch::Make(schema, num_strings, {array});
-
-  return rb;
-}
-
-
-void setPtoaArguments(std::shared_ptr<fletcher::Platform> platform, uint32_t num_val,
-		uint64_t max_size, da_t device_parquet_address) {
-  dau_t mmio64_writer;
-
-  platform->WriteMMIO(REG_BASE + 0, num_val);
-
-  mmio64_writer.full = device_parquet_address;
-  platform->WriteMMIO(REG_BASE + 1, mmio64_writer.lo);
-  platform->WriteMMIO(REG_BASE + 2, mmio64_writer.hi);
-  
-  mmio64_writer.full = max_size;
-  platform->WriteMMIO(REG_BASE + 3, mmio64_writer.lo);
-  platform->WriteMMIO(REG_BASE + 4, mmio64_writer.hi);
-  
-  return;
-}
-
 //Use standard Arrow library functions to read Arrow array from Parquet file
 //Only works for Parquet version 1 style files.
 std::shared_ptr<arrow::ChunkedArray> readArray(std::string file_path) {
@@ -139,44 +93,34 @@ std::shared_ptr<arrow::ChunkedArray> readArray(std::string file_path) {
 }
 
 int main(int argc, char **argv) {
-  fletcher::Status status;
-  std::shared_ptr<fletcher::Platform> platform;
-  std::shared_ptr<fletcher::Context> context;
-
   fletcher::Timer t;
 
   char* hw_input_file_path;
   char* reference_parquet_file_path;
   uint32_t num_strings;
   uint32_t num_chars;
-  uint64_t file_size;
-  uint8_t* file_data;
+  int poll_interval_us = 0;
 
   if (argc > 3) {
     hw_input_file_path = argv[1];
     reference_parquet_file_path = argv[2];
     num_strings = (uint32_t) std::strtoul(argv[3], nullptr, 10);
+    if (argc > 4) {
+      poll_interval_us = std::max(0, std::atoi(argv[4]));
+    }
 
   } else {
-    std::cerr << "Usage: str <parquet_hw_input_file_path> <reference_parquet_file_path> <num_strings>" << std::endl;
+    std::cerr << "Usage: str <parquet_hw_input_file_path> <reference_parquet_file_path> <num_strings> [poll_interval_us]" << std::endl;
     return 1;
   }
 
+  Trace::global().enable_from_env();
+  Trace::global().name_thread("host");
+
   /*************************************************************
   * Parquet file reading
   *************************************************************/
 
-  t.start();
-
-  //Open parquet file
-  std::ifstream parquet_file;
-  parquet_file.open(hw_input_file_path, std::ifstream::binary);
-
-  if(!parquet_file.is_open()) {
-    std::cerr << "Error opening Parquet file" << std::endl;
-    return 1;
-  }
-
   //Reference array
   auto correct_array = std::dynamic_pointer_cast<arrow::StringArray>(readArray(
 		  std::string(reference_parquet_file_path))->chunk(0));
@@ -186,121 +130,61 @@ int main(int argc, char **argv) {
 			  correct_array->Slice(0, num_strings));
   num_chars = correct_array->value_offset(num_strings);
 
-  //Get filesize
-  parquet_file.seekg (0, parquet_file.end);
-  file_size = parquet_file.tellg();
-  parquet_file.seekg (4, parquet_file.beg);
-
-  //Read file data
-  //file_data = (uint8_t*)std::malloc(file_size);
-  posix_memalign((void**)&file_data, 4096, file_size - 4);
-  parquet_file.read((char *)file_data, file_size - 4);
-  unsigned int checksum = 0;
-  for (int i = 0; i < file_size - 4; i++) {
-    checksum += file_data[i];
+  // Skip the magic number, the kernel starts at the first page
+  std::shared_ptr<arrow::Buffer> file_data;
+  {
+    TraceSpan span("read file", "io");
+    if (ptoa::FpgaReader::load_file(hw_input_file_path, 4, &file_data) != ptoa::status::OK) {
+      return 1;
+    }
   }
-  printf("Parquet file checksum 0x%lu\n", checksum);
-
-
-  /*************************************************************
-  * FPGA RecordBatch preparation
-  *************************************************************/
-
-  t.start();
-  auto arrow_rb_fpga = prepareRecordBatch(num_strings, num_chars);
-  t.stop();
-  std::cout << "Prepare FPGA RecordBatch         : "
-            << t.seconds() << std::endl;
-  auto result_array = std::dynamic_pointer_cast<arrow::StringArray>(arrow_rb_fpga->column(0));
-  auto result_buffer_raw_offsets = result_array->value_offsets()->mutable_data();
-  auto result_buffer_raw_values = result_array->value_data()->mutable_data();
-  auto result_buffer_offsets_size = result_array->value_offsets()->size();
-  auto result_buffer_values_size = result_array->value_data()->size();
 
   /*************************************************************
   * FPGA Initialization
   *************************************************************/
 
-  // Create and initialize platform
-  fletcher::Platform::Make(&platform).ewf("Could not create platform.");
-  platform->Init();
-
-  //Create context and kernel
-  fletcher::Context::Make(&context, platform);
-  fletcher::Kernel kernel(context);
-  
   t.start();
-  kernel.Reset();
-
-  //Setup destination recordbatch on device
-  context->QueueRecordBatch(arrow_rb_fpga);
-  context->Enable();
-
-  //Malloc parquet file on device
-  da_t device_parquet_address;
-  if (strcmp("oc-accel", platform->name().c_str()) == 0
-		  || strcmp("snap", platform->name().c_str()) == 0) {
-    printf("Platform [%s]: Skipping device buffer allocation and host to device copy.\n",
-    		platform->name().c_str());
-    // Set all the MMIO registers to their correct value
-    setPtoaArguments(platform, num_strings, file_size, (da_t)(file_data));
-  } else {
-    platform->DeviceMalloc(&device_parquet_address, file_size);
-
-    // Set all the MMIO registers to their correct value
-    setPtoaArguments(platform, num_strings, file_size, device_parquet_address);
+  ptoa::FpgaReader reader;
+  if (reader.init() != ptoa::status::OK) {
+    return -1;
   }
+  reader.set_poll_interval(poll_interval_us);
   t.stop();
   std::cout << "FPGA Initialize                  : "
             << t.seconds() << std::endl;
-    
-  // Make sure the buffers are allocated
-  memset(result_buffer_raw_offsets, 0, result_buffer_offsets_size);
-  memset(result_buffer_raw_values, 0, result_buffer_values_size);
-
-  /*************************************************************
-  * FPGA host to device copy
-  *************************************************************/
-
-  t.start();
-  platform->CopyHostToDevice(file_data, device_parquet_address, file_size);
-  t.stop();
-  std::cout << "FPGA host to device copy         : "
-            << t.seconds() << std::endl;
 
   /*************************************************************
   * FPGA processing
   *************************************************************/
 
-  t.start();
-  kernel.Start();
-  kernel.PollUntilDoneInterval(10);
-  t.stop();
-  std::cout << "FPGA processing time             : "
-            << t.seconds() << std::endl;
-
-  /*************************************************************
-  * FPGA device to host copy
-  *************************************************************/
-
-  t.start();
-
-  platform->CopyDeviceToHost(context->device_buffer(0).device_address,
-  						 result_buffer_raw_offsets,
-  						 sizeof(int32_t) * (num_strings+1));
-
-  platform->CopyDeviceToHost(context->device_buffer(1).device_address,
-  						 result_buffer_raw_values,
-  						 num_chars);
-  t.stop();
+  std::shared_ptr<arrow::StringArray> result_array;
+  if (reader.read_string(num_strings, num_chars, file_data->data(), file_data->size(), &result_array) != ptoa::status::OK) {
+    return 1;
+  }
 
+  const ptoa::fpga_read_stats& stats = reader.get_last_read_stats();
   size_t total_arrow_size = sizeof(int32_t) * (num_strings+1) + num_chars;
 
+  std::cout << "FPGA host to device copy         : "
+            << stats.copy_to_device << std::endl;
+  std::cout << "FPGA processing time             : "
+            << stats.processing << std::endl;
   std::cout << "FPGA device to host copy         : "
-            << t.seconds() << std::endl;
+            << stats.copy_to_host << std::endl;
+  std::cout << "FPGA end to end time             : "
+            << stats.total << std::endl;
   std::cout << "Arrow buffers total size         : "
             << total_arrow_size << std::endl;
 
+  // Completion is the time from the start of a kernel until a poll saw it done, detection the most that poll could have been late.
+  const ptoa::poll_stats poll_stats = reader.get_poll_stats();
+  std::cout << "Kernel completions / polls       : "
+            << poll_stats.num_completions << " / " << poll_stats.total_polls << std::endl;
+  std::cout << "Kernel completion p50/p90/p99    : "
+            << poll_stats.completion.p50 << " / " << poll_stats.completion.p90 << " / " << poll_stats.completion.p99 << std::endl;
+  std::cout << "Kernel detection p50/p90/p99     : "
+            << poll_stats.detection.p50 << " / " << poll_stats.detection.p90 << " / " << poll_stats.detection.p99 << std::endl;
+
   /*************************************************************
   * Check results
   *************************************************************/
@@ -350,7 +234,7 @@ int main(int argc, char **argv) {
 	}
   }
 }
-  std::free(file_data);
+  Trace::global().write();
 
   return 0;
 
@@ -0,0 +1,196 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Measures fastpack, fastunpack, int64fastpack and int64fastunpack for every bit width, like the benchmark in the header comment of
+ * LemireBitUnpacking.cpp. Every function call handles 32 values, so the buffers are processed in groups of 32 values,
+ * the same way the DELTA_BINARY_PACKED decoder calls them for every miniblock.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_TSC 1
+#else
+#define HAS_TSC 0
+#endif
+
+#include <SWParquetReader.h>
+#include <LemireBitUnpacking.h>
+#include <timer.h>
+
+#define VALUES_PER_CALL 32
+
+// Time and cycle count of the fastest of all iterations
+struct measurement {
+    double seconds;
+    double cycles;
+};
+
+volatile uint64_t result_sink;
+
+inline uint64_t read_cycles() {
+#if HAS_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+template<typename F>
+measurement measure(F function, int iterations) {
+    Timer t;
+    double min_cycles = 0;
+
+    for(int i=0; i<iterations; i++) {
+        t.start();
+        uint64_t start_cycles = read_cycles();
+        function();
+        uint64_t stop_cycles = read_cycles();
+        t.stop();
+        t.record();
+
+        double cycles = (double) (stop_cycles - start_cycles);
+        if((i == 0) || (cycles < min_cycles)) {
+            min_cycles = cycles;
+        }
+    }
+
+    return {t.min(), min_cycles};
+}
+
+void print_cell(const measurement& m, int64_t num_values) {
+    std::cout << std::setw(12) << std::fixed << std::setprecision(3) << m.seconds*1e9/num_values;
+    if(HAS_TSC) {
+        std::cout << std::setw(12) << std::setprecision(3) << num_values/m.cycles;
+    } else {
+        std::cout << std::setw(12) << "-";
+    }
+}
+
+void print_empty_cell() {
+    std::cout << std::setw(12) << "-" << std::setw(12) << "-";
+}
+
+int main(int argc, char **argv) {
+    int64_t num_values;
+    int iterations;
+
+    if (argc > 2) {
+      num_values = std::strtoll(argv[1], nullptr, 10);
+      iterations = (int) std::strtoul(argv[2], nullptr, 10);
+    } else {
+      std::cerr << "Usage: bitunpack num_values iterations" << std::endl;
+      return 1;
+    }
+
+    // Round to whole calls
+    num_values = std::max((int64_t) VALUES_PER_CALL, num_values - num_values % VALUES_PER_CALL);
+    int64_t num_calls = num_values / VALUES_PER_CALL;
+
+    std::mt19937_64 gen(42);
+
+    std::vector<uint> values32(num_values);
+    std::vector<uint> packed32(num_values);
+    std::vector<uint> unpacked32(num_values);
+
+    std::vector<uint64_t> values64(num_values);
+    // Extra word at the end because int64fastunpack reads whole 64 bit words at odd bit widths
+    std::vector<uint64_t> packed64(num_values + 1);
+    std::vector<uint64_t> unpacked64(num_values);
+
+    for(int64_t i=0; i<num_values; i++) {
+        values32[i] = (uint) gen();
+    }
+    for(int64_t i=0; i<num_values; i++) {
+        values64[i] = gen();
+    }
+
+    std::cout << "Bit (un)packing of " << num_values << " values, fastest of " << iterations << " iterations" << std::endl;
+    if(HAS_TSC) {
+        std::cout << "Cycles are TSC reference cycles" << std::endl;
+    }
+    std::cout << std::left << std::setw(6) << "bits" << std::right
+              << std::setw(12) << "pack ns/v" << std::setw(12) << "pack v/c"
+              << std::setw(12) << "unpack ns/v" << std::setw(12) << "unpack v/c"
+              << std::setw(12) << "pack64 ns/v" << std::setw(12) << "pack64 v/c"
+              << std::setw(12) << "unp64 ns/v" << std::setw(12) << "unp64 v/c" << std::endl;
+
+    for(uint bit=0; bit<=64; bit++) {
+        std::cout << std::left << std::setw(6) << bit << std::right;
+
+        if(bit <= 32) {
+            // Packed miniblocks of 32 values take up bit words
+            measurement pack = measure([&]() {
+                for(int64_t k=0; k<num_calls; k++) {
+                    fastpack(&values32[k*VALUES_PER_CALL], &packed32[k*bit], bit);
+                }
+            }, iterations);
+
+            measurement unpack = measure([&]() {
+                for(int64_t k=0; k<num_calls; k++) {
+                    fastunpack(&packed32[k*bit], &unpacked32[k*VALUES_PER_CALL], bit);
+                }
+            }, iterations);
+
+            // Check the round trip so the measurements are known to be of working code
+            uint mask = (bit == 32) ? 0xFFFFFFFF : (1U << bit) - 1;
+            for(int64_t i=0; i<num_values; i++) {
+                if(unpacked32[i] != (values32[i] & mask)) {
+                    std::cerr << std::endl << "[ERROR] fastpack/fastunpack round trip failed for bit width " << bit << " at value " << i << std::endl;
+                    return 1;
+                }
+            }
+            result_sink = unpacked32[num_values-1];
+
+            print_cell(pack, num_values);
+            print_cell(unpack, num_values);
+        } else {
+            print_empty_cell();
+            print_empty_cell();
+        }
+
+        // Packed miniblocks of 32 values take up 4*bit bytes, which is not a whole amount of 64 bit words at odd bit widths
+        measurement pack64 = measure([&]() {
+            uint8_t* out = (uint8_t*) packed64.data();
+            for(int64_t k=0; k<num_calls; k++) {
+                int64fastpack(&values64[k*VALUES_PER_CALL], (uint64_t*) (out + k*4*bit), bit);
+            }
+        }, iterations);
+
+        measurement unpack64 = measure([&]() {
+            const uint8_t* in = (const uint8_t*) packed64.data();
+            for(int64_t k=0; k<num_calls; k++) {
+                int64fastunpack((const uint64_t*) (in + k*4*bit), &unpacked64[k*VALUES_PER_CALL], bit);
+            }
+        }, iterations);
+
+        uint64_t mask64 = (bit == 64) ? 0xFFFFFFFFFFFFFFFF : (1ULL << bit) - 1;
+        for(int64_t i=0; i<num_values; i++) {
+            if(unpacked64[i] != (values64[i] & mask64)) {
+                std::cerr << std::endl << "[ERROR] int64fastpack/int64fastunpack round trip failed for bit width " << bit << " at value " << i << std::endl;
+                return 1;
+            }
+        }
+        result_sink = unpacked64[num_values-1];
+
+        print_cell(pack64, num_values);
+        print_cell(unpack64, num_values);
+        std::cout << std::defaultfloat << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,337 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Head to head comparison of SWParquetReader and parquet::arrow::FileReader. For every encoding a file is written once with
+ * parquet-cpp and then read by both readers with the same thread counts, both with a cold cache (file evicted from the page
+ * cache and CPU caches flushed) and a warm cache. The row groups of the file are distributed over the threads in the same
+ * way for both readers, and the outputs of both readers are checked for equality.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <arrow/util/config.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/arrow/writer.h>
+#include <parquet/exception.h>
+#include <parquet/properties.h>
+
+#include <SWParquetReader.h>
+#include <timer.h>
+#include <results.h>
+#include <datagen.h>
+#include <cache.h>
+
+#define MIN_STRING_LENGTH 0
+#define MAX_STRING_LENGTH 32
+
+enum column_type {INT32, INT64, STRING};
+
+struct compare_config {
+    const char* name;
+    column_type type;
+    parquet::Encoding::type parquet_encoding;
+};
+
+static const compare_config configs[] = {
+    {"int32_plain", INT32, parquet::Encoding::PLAIN},
+    {"int64_plain", INT64, parquet::Encoding::PLAIN},
+    {"int32_delta", INT32, parquet::Encoding::DELTA_BINARY_PACKED},
+    {"int64_delta", INT64, parquet::Encoding::DELTA_BINARY_PACKED},
+    {"str_delta_length", STRING, parquet::Encoding::DELTA_LENGTH_BYTE_ARRAY}
+};
+
+arrow::Result<std::shared_ptr<arrow::Table>> generate_table(column_type type, int64_t num_values) {
+    const uint64_t seed = 42;
+    const int num_threads = std::thread::hardware_concurrency();
+    std::shared_ptr<arrow::Array> array;
+
+    if(type == STRING) {
+        datagen::string_options options;
+        options.min_length = MIN_STRING_LENGTH;
+        options.max_length = MAX_STRING_LENGTH;
+        ARROW_ASSIGN_OR_RAISE(array, datagen::generate_strings(num_values, options, seed, num_threads));
+        return datagen::make_table("str", array);
+    }
+
+    // Random walk, so delta encoding has something to gain
+    datagen::int_options options;
+    options.distribution = datagen::RANDOM_WALK;
+    if(type == INT32) {
+        options.max_step = 1024;
+        ARROW_ASSIGN_OR_RAISE(array, datagen::generate_int32(num_values, options, seed, num_threads));
+    } else {
+        options.max_step = 1LL << 39;
+        ARROW_ASSIGN_OR_RAISE(array, datagen::generate_int64(num_values, options, seed, num_threads));
+    }
+    return datagen::make_table("int", array);
+}
+
+// Write a file SWParquetReader can read: uncompressed v1 data pages without dictionary or statistics.
+// Older parquet-cpp versions cannot write every encoding, in which case error is set and false is returned.
+bool write_file(const arrow::Table& table, const std::string& file_path, int64_t row_group_size, parquet::Encoding::type encoding, std::string* error) {
+    try {
+        std::shared_ptr<arrow::io::FileOutputStream> outfile;
+        PARQUET_ASSIGN_OR_THROW(outfile, arrow::io::FileOutputStream::Open(file_path));
+
+        parquet::WriterProperties::Builder builder;
+        builder.disable_statistics();
+        builder.compression(parquet::Compression::UNCOMPRESSED);
+        builder.disable_dictionary();
+        builder.encoding(encoding);
+
+        PARQUET_THROW_NOT_OK(parquet::arrow::WriteTable(table, arrow::default_memory_pool(), outfile, row_group_size, builder.build()));
+        PARQUET_THROW_NOT_OK(outfile->Close());
+    } catch(const std::exception& e) {
+        *error = e.what();
+        return false;
+    }
+
+    return true;
+}
+
+// Read column 0 of all row groups with parquet::arrow::FileReader. Thread t reads row groups t, t+num_threads, ...
+bool read_arrow(const std::string& file_path, int num_row_groups, int num_threads, std::vector<std::shared_ptr<arrow::ChunkedArray>>* columns) {
+    // Not vector<bool>, the threads write their own element concurrently
+    std::vector<char> results(num_threads, true);
+    std::vector<std::thread> threads;
+
+    auto worker = [&](int t) {
+        try {
+            std::shared_ptr<arrow::io::ReadableFile> infile;
+            PARQUET_ASSIGN_OR_THROW(infile, arrow::io::ReadableFile::Open(file_path, arrow::default_memory_pool()));
+
+            std::unique_ptr<parquet::arrow::FileReader> reader;
+#if ARROW_VERSION_MAJOR >= 19
+            PARQUET_ASSIGN_OR_THROW(reader, parquet::arrow::OpenFile(infile, arrow::default_memory_pool()));
+#else
+            PARQUET_THROW_NOT_OK(parquet::arrow::OpenFile(infile, arrow::default_memory_pool(), &reader));
+#endif
+            reader->set_use_threads(false);
+
+            for(int rg=t; rg<num_row_groups; rg+=num_threads) {
+                std::shared_ptr<arrow::Table> table;
+                PARQUET_THROW_NOT_OK(reader->ReadRowGroup(rg, {0}, &table));
+                (*columns)[rg] = table->column(0);
+            }
+        } catch(const std::exception& e) {
+            std::cerr << "[ERROR] parquet::arrow::FileReader: " << e.what() << std::endl;
+            results[t] = false;
+        }
+    };
+
+    for(int t=1; t<num_threads; t++) {
+        threads.emplace_back(worker, t);
+    }
+    worker(0);
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for(char result : results) {
+        if(!result) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Read column 0 of all row groups with SWParquetReader, distributed over the threads in the same way as read_arrow
+bool read_sw(const std::string& file_path, int num_row_groups, int num_threads, std::vector<std::shared_ptr<arrow::Array>>* columns) {
+    ptoa::SWParquetReader reader(file_path);
+    std::vector<ptoa::status> results(num_threads, ptoa::status::OK);
+    std::vector<std::thread> threads;
+
+    auto worker = [&](int t) {
+        for(int rg=t; rg<num_row_groups; rg+=num_threads) {
+            std::shared_ptr<arrow::RecordBatch> batch;
+            if(reader.read_record_batch(rg, {0}, &batch, 1) != ptoa::status::OK) {
+                results[t] = ptoa::status::FAIL;
+                return;
+            }
+            (*columns)[rg] = batch->column(0);
+        }
+    };
+
+    for(int t=1; t<num_threads; t++) {
+        threads.emplace_back(worker, t);
+    }
+    worker(0);
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for(ptoa::status result : results) {
+        if(result != ptoa::status::OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool outputs_equal(const std::vector<std::shared_ptr<arrow::ChunkedArray>>& arrow_columns, const std::vector<std::shared_ptr<arrow::Array>>& sw_columns) {
+    for(size_t rg=0; rg<arrow_columns.size(); rg++) {
+        if((arrow_columns[rg] == nullptr) || (sw_columns[rg] == nullptr)) {
+            return false;
+        }
+        if(!arrow_columns[rg]->Equals(arrow::ChunkedArray(std::vector<std::shared_ptr<arrow::Array>>{sw_columns[rg]}))) {
+            std::cerr << "Outputs differ in row group " << rg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int64_t num_values;
+    int iterations;
+    std::vector<int> thread_counts;
+    int num_row_groups = 0;
+    std::string work_dir = ".";
+
+    if (argc > 3) {
+      num_values = std::strtoll(argv[1], nullptr, 10);
+      iterations = (int) std::strtoul(argv[2], nullptr, 10);
+
+      std::istringstream thread_list(argv[3]);
+      std::string thread_count;
+      while(std::getline(thread_list, thread_count, ',')) {
+        thread_counts.push_back(std::max(1, std::atoi(thread_count.c_str())));
+      }
+
+      if(argc > 4) {
+        num_row_groups = std::atoi(argv[4]);
+      }
+      if(argc > 5) {
+        work_dir = argv[5];
+      }
+
+      if((iterations < 1) || thread_counts.empty()) {
+        std::cerr << "Invalid argument. At least one iteration and one thread count are needed" << std::endl;
+        return 1;
+      }
+    } else {
+      std::cerr << "Usage: compare num_values iterations thread_counts(comma separated) [row_groups] [work_dir]" << std::endl;
+      std::cerr << "row_groups defaults to four times the largest thread count" << std::endl;
+      return 1;
+    }
+
+    // Set PTOA_RESULTS to a .json or .csv path to append the timings of both readers for compare_results.py
+    Results::global().enable_from_env();
+
+    if(num_row_groups <= 0) {
+        num_row_groups = 4*(*std::max_element(thread_counts.begin(), thread_counts.end()));
+    }
+    int64_t row_group_size = (num_values + num_row_groups - 1)/num_row_groups;
+    num_row_groups = (int) ((num_values + row_group_size - 1)/row_group_size);
+
+    std::cout << std::left << std::setw(18) << "encoding" << std::setw(6) << "cache" << std::right
+              << std::setw(5) << "thr"
+              << std::setw(12) << "arrow(ms)"
+              << std::setw(12) << "ptoa(ms)"
+              << std::setw(10) << "speedup"
+              << std::setw(7) << "equal" << std::endl;
+
+    int failures = 0;
+
+    for(const compare_config& config : configs) {
+        std::string file_path = work_dir + "/compare_" + config.name + ".parquet";
+        std::string error;
+
+        arrow::Result<std::shared_ptr<arrow::Table>> table = generate_table(config.type, num_values);
+        if(!table.ok()) {
+            std::cerr << "[ERROR] Could not generate the column of " << config.name << ": " << table.status().ToString() << std::endl;
+            return 1;
+        }
+
+        if(!write_file(*table.ValueOrDie(), file_path, row_group_size, config.parquet_encoding, &error)) {
+            std::cout << std::left << std::setw(18) << config.name << "skipped, could not write file: " << error << std::right << std::endl;
+            continue;
+        }
+
+        for(int cold=1; cold>=0; cold--) {
+            for(int num_threads : thread_counts) {
+                Timer arrow_timer;
+                Timer sw_timer;
+                std::vector<std::shared_ptr<arrow::ChunkedArray>> arrow_columns(num_row_groups);
+                std::vector<std::shared_ptr<arrow::Array>> sw_columns(num_row_groups);
+                bool ok = true;
+
+                // One untimed run of each reader first, the warm cache runs start from there
+                for(int i=-1; (i<iterations) && ok; i++) {
+                    if(cold) {
+                        ok &= evict_file(file_path);
+                        flush_caches();
+                    }
+                    arrow_timer.start();
+                    ok &= read_arrow(file_path, num_row_groups, num_threads, &arrow_columns);
+                    arrow_timer.stop();
+
+                    if(cold) {
+                        ok &= evict_file(file_path);
+                        flush_caches();
+                    }
+                    sw_timer.start();
+                    ok &= read_sw(file_path, num_row_groups, num_threads, &sw_columns);
+                    sw_timer.stop();
+
+                    if(i >= 0) {
+                        arrow_timer.record();
+                        sw_timer.record();
+                    }
+                }
+
+                if(!ok) {
+                    std::cout << std::left << std::setw(18) << config.name << "read failed" << std::right << std::endl;
+                    failures++;
+                    continue;
+                }
+
+                bool equal = outputs_equal(arrow_columns, sw_columns);
+                if(!equal) {
+                    failures++;
+                }
+
+                Results::config results_config = {{"encoding", config.name},
+                                                  {"cache", cold ? "cold" : "warm"},
+                                                  {"threads", std::to_string(num_threads)},
+                                                  {"values", std::to_string(num_values)},
+                                                  {"row_groups", std::to_string(num_row_groups)}};
+                Results::global().add("compare", results_config, "arrow_seconds", arrow_timer.samples());
+                Results::global().add("compare", results_config, "ptoa_seconds", sw_timer.samples());
+
+                double arrow_median = arrow_timer.median();
+                double sw_median = sw_timer.median();
+
+                std::cout << std::left << std::setw(18) << config.name << std::setw(6) << (cold ? "cold" : "warm") << std::right
+                          << std::setw(5) << num_threads
+                          << std::fixed << std::setprecision(3)
+                          << std::setw(12) << arrow_median*1e3
+                          << std::setw(12) << sw_median*1e3
+                          << std::setprecision(2)
+                          << std::setw(9) << arrow_median/sw_median << "x"
+                          << std::setw(7) << (equal ? "yes" : "NO")
+                          << std::defaultfloat << std::endl;
+            }
+        }
+    }
+
+    Results::global().write();
+
+    return failures == 0 ? 0 : 1;
+}
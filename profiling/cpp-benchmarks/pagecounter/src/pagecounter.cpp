@@ -10,57 +10,327 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+/*
+ * Walks every page and DELTA_BINARY_PACKED block of a hardware compatible Parquet file and reports the statistics that decide
+ * how fast it decodes: values per page, miniblock bit widths, min_delta and (for DELTA_LENGTH) string lengths. From the bit widths
+ * it predicts the decode time of the CPU path, by timing the unpack and accumulate loop for every bit width on this machine, and
+ * of the BitUnpacker in the prim*_delta_decw_64/128 hardware variants, using the deltas per cycle of unpacking_count in Delta.vhd.
+ * The hardware prediction covers the page headers and the unpacking, which is the bottleneck for all but the smallest bit widths
+ * and pages, see HardwareModel.h.
+ */
+
 #include <iostream>
 #include <iomanip>
+#include <map>
+#include <random>
 
 #include <parquet/arrow/reader.h>
 
 #include <SWParquetReader.h>
+#include <HardwareModel.h>
+#include <LemireBitUnpacking.h>
 #include <timer.h>
+#include <bandwidth.h>
 
 #define PRIM_WIDTH 64
+#define MINIBLOCK_SIZE (BLOCK_SIZE/MINIBLOCKS_IN_BLOCK)
+
+// Miniblocks decoded per bit width when timing the CPU path
+#define CALIBRATION_MINIBLOCKS 4096
+
+struct file_stats {
+    int64_t num_pages = 0;
+    int64_t num_values = 0;
+    int64_t data_bytes = 0;
+    int64_t header_cycles = 0;
+    std::map<int32_t, int64_t> values_per_page;
+    std::vector<int64_t> bitwidth_counts = std::vector<int64_t>(65, 0);
+    int64_t num_blocks = 0;
+    int64_t min_min_delta = 0;
+    int64_t max_min_delta = 0;
+    int64_t negative_min_deltas = 0;
+    int64_t zero_min_deltas = 0;
+    std::vector<int64_t> min_delta_bits = std::vector<int64_t>(65, 0);
+    // Power of two buckets, bucket b holds lengths [2^(b-1), 2^b), bucket 0 the empty strings
+    std::vector<int64_t> length_buckets = std::vector<int64_t>(33, 0);
+    int64_t min_length = 0;
+    int64_t max_length = 0;
+    int64_t total_length = 0;
+};
 
-//Use standard Arrow library functions to read Arrow array from Parquet file
-//Only works for Parquet version 1 style files.
-std::shared_ptr<arrow::Array> readArray(std::string hw_input_file_path) {
-  std::shared_ptr<arrow::io::ReadableFile> infile;
-  PARQUET_THROW_NOT_OK(arrow::io::ReadableFile::Open(hw_input_file_path, arrow::default_memory_pool(), &infile));
-  
-  std::unique_ptr<parquet::arrow::FileReader> reader;
-  PARQUET_THROW_NOT_OK(parquet::arrow::OpenFile(infile, arrow::default_memory_pool(), &reader));
-
-  std::shared_ptr<arrow::ChunkedArray> carray;
-  PARQUET_THROW_NOT_OK(reader->ReadColumn(0, &carray));
-  std::shared_ptr<arrow::Array> array = carray->chunk(0);
-  return array;
+volatile uint64_t result_sink;
+
+int bit_length(uint64_t value) {
+    int bits = 0;
+    while(value != 0) {
+        bits++;
+        value >>= 1;
+    }
+    return bits;
+}
+
+// Nanoseconds the CPU path spends on unpacking and accumulating a single miniblock of the given bit width
+double cpu_miniblock_ns(int prim_width, int width) {
+    std::mt19937_64 gen(42);
+    // Extra word at the end because int64fastunpack reads whole 64 bit words at odd bit widths
+    std::vector<uint64_t> packed(CALIBRATION_MINIBLOCKS*width/2 + 1);
+    for(uint64_t& word : packed) {
+        word = gen();
+    }
+    const uint8_t* in = (const uint8_t*) packed.data();
+
+    uint32_t deltas32[MINIBLOCK_SIZE];
+    uint64_t deltas64[MINIBLOCK_SIZE];
+    std::vector<int64_t> out(CALIBRATION_MINIBLOCKS*MINIBLOCK_SIZE + 1, 0);
+    Timer t;
+
+    for(int it=0; it<5; it++) {
+        t.start();
+        for(int k=0; k<CALIBRATION_MINIBLOCKS; k++) {
+            int64_t* o = &out[k*MINIBLOCK_SIZE + 1];
+            if(prim_width == 32) {
+                fastunpack((const uint*) (in + k*4*width), deltas32, width);
+                for(int j=0; j<MINIBLOCK_SIZE; j++) {
+                    o[j] = (int32_t) (deltas32[j] + 3 + o[j-1]);
+                }
+            } else {
+                int64fastunpack((const uint64_t*) (in + k*4*width), deltas64, width);
+                for(int j=0; j<MINIBLOCK_SIZE; j++) {
+                    o[j] = deltas64[j] + 3 + o[j-1];
+                }
+            }
+        }
+        t.stop();
+        t.record();
+    }
+    result_sink = out.back();
+
+    return t.min()*1e9/CALIBRATION_MINIBLOCKS;
+}
+
+void print_bar(int64_t count, int64_t total) {
+    double fraction = total > 0 ? (double) count/total : 0;
+    std::cout << std::setw(12) << count << std::fixed << std::setprecision(2) << std::setw(8) << 100*fraction << "% "
+              << std::string((int) (fraction*50 + 0.5), '#') << std::defaultfloat << std::endl;
+}
+
+bool collect_stats(ptoa::SWParquetReader& reader, int32_t prim_width, ptoa::encoding enc, file_stats* stats) {
+    std::vector<ptoa::delta_block_info> blocks;
+    std::vector<int32_t> lengths;
+    bool first_block = true;
+    bool first_length = true;
+
+    // The pages are inspected where the reader holds the file, inspect_delta_page accepts pages anywhere in memory
+    const uint8_t* file_data = reader.get_file_data();
+
+    for(const ptoa::page_directory_entry& page : reader.get_page_directory()) {
+        const uint8_t* page_ptr = file_data + page.offset;
+        if((uint64_t) (page.offset + page.metadata_size + page.compressed_size) > reader.get_file_size()) {
+            std::cerr << "[ERROR] Page at file offset " << page.offset << " runs past the end of the file" << std::endl;
+            return false;
+        }
+
+        stats->num_pages++;
+        stats->num_values += page.num_values;
+        stats->data_bytes += page.compressed_size;
+        stats->values_per_page[page.num_values]++;
+        stats->header_cycles += ptoa::hw_page_header_cycles(page.metadata_size);
+
+        if(enc == ptoa::encoding::PLAIN) {
+            continue;
+        }
+
+        int32_t page_num_values;
+        const uint8_t* end_ptr;
+        if(reader.inspect_delta_page(enc == ptoa::encoding::DELTA_LENGTH ? 32 : prim_width, page_ptr, &blocks, &page_num_values, &end_ptr) != ptoa::status::OK) {
+            return false;
+        }
+
+        for(const ptoa::delta_block_info& block : blocks) {
+            if(first_block || block.min_delta < stats->min_min_delta) {
+                stats->min_min_delta = block.min_delta;
+            }
+            if(first_block || block.min_delta > stats->max_min_delta) {
+                stats->max_min_delta = block.min_delta;
+            }
+            first_block = false;
+
+            stats->num_blocks++;
+            stats->negative_min_deltas += block.min_delta < 0;
+            stats->zero_min_deltas += block.min_delta == 0;
+            stats->min_delta_bits[bit_length(block.min_delta < 0 ? -(uint64_t) block.min_delta : block.min_delta)]++;
+
+            for(int i=0; i<block.num_miniblocks; i++) {
+                stats->bitwidth_counts[std::min((int) block.bitwidths[i], 64)]++;
+            }
+        }
+
+        if(enc == ptoa::encoding::DELTA_LENGTH) {
+            lengths.resize(page.num_values);
+            if(reader.decode_page(32, page_ptr, page.num_values, (uint8_t*) lengths.data(), enc) != ptoa::status::OK) {
+                return false;
+            }
+            for(int32_t length : lengths) {
+                if(first_length || length < stats->min_length) {
+                    stats->min_length = length;
+                }
+                first_length = false;
+                stats->max_length = std::max(stats->max_length, (int64_t) length);
+                stats->total_length += length;
+                stats->length_buckets[bit_length((uint32_t) length)]++;
+            }
+        }
+    }
+
+    return true;
 }
 
 int main(int argc, char **argv) {
-    int num_values;
     char* hw_input_file_path;
-    char* reference_parquet_file_path;
-    int iterations;
-    bool verify_output;
     ptoa::encoding enc;
+    int32_t prim_width = PRIM_WIDTH;
+    int elements_per_cycle = 0;
+    double clock_mhz = HW_CLOCK_MHZ;
 
-    Timer t;
-
-    if (argc == 3) {
+    if (argc >= 3) {
       hw_input_file_path = argv[1];
-      if(!strncmp(argv[2], "delta", 5)) {
+      if(!strncmp(argv[2], "delta_length", 12)) {
+        enc = ptoa::encoding::DELTA_LENGTH;
+      } else if(!strncmp(argv[2], "delta", 5)) {
         enc = ptoa::encoding::DELTA;
       } else if (!strncmp(argv[2], "plain", 5)) {
         enc = ptoa::encoding::PLAIN;
       } else {
-        std::cerr << "Invalid argument. Option \"encoding\" should be \"delta\" or \"plain\"" << std::endl;
+        std::cerr << "Invalid argument. Option \"encoding\" should be \"delta\", \"plain\" or \"delta_length\"" << std::endl;
         return 1;
       }
+      if(argc >= 4) {
+        prim_width = std::atoi(argv[3]);
+        if((prim_width != 32) && (prim_width != 64)) {
+          std::cerr << "Invalid argument. Option \"width\" should be 32 or 64" << std::endl;
+          return 1;
+        }
+      }
+      if(argc >= 5) {
+        elements_per_cycle = std::atoi(argv[4]);
+      }
+      if(argc >= 6) {
+        clock_mhz = std::atof(argv[5]);
+      }
     } else {
-      std::cerr << "Usage: prim parquet_hw_input_file_path encoding" << std::endl;
+      std::cerr << "Usage: pagecounter parquet_hw_input_file_path encoding(delta, plain or delta_length) [width(32 or 64)] [elements_per_cycle] [clock_mhz]" << std::endl;
+      std::cerr << "elements_per_cycle defaults to that of the prim32 and prim64 examples (16 and 8), clock_mhz to " << HW_CLOCK_MHZ << std::endl;
       return 1;
     }
 
+    if(elements_per_cycle <= 0) {
+        elements_per_cycle = prim_width == 32 ? 16 : 8;
+    }
+    if(enc == ptoa::encoding::DELTA_LENGTH) {
+        prim_width = 32;
+    }
+
     ptoa::SWParquetReader reader(hw_input_file_path);
     //reader.inspect_metadata(4);
     reader.count_pages(4);
+
+    if(reader.build_page_directory(4) != ptoa::status::OK) {
+        return 1;
+    }
+
+    file_stats stats;
+    if(!collect_stats(reader, prim_width, enc, &stats)) {
+        return 1;
+    }
+
+    std::cout << std::endl << "Values per page (" << stats.num_values << " values in " << stats.num_pages << " pages):" << std::endl;
+    for(const auto& entry : stats.values_per_page) {
+        std::cout << "    " << std::setw(10) << entry.first;
+        print_bar(entry.second, stats.num_pages);
+    }
+    std::cout << "Page headers take " << stats.header_cycles << " hardware cycles, "
+              << (stats.num_pages > 0 ? (double) stats.header_cycles/stats.num_pages : 0.0) << " per page" << std::endl;
+
+    if(enc == ptoa::encoding::PLAIN) {
+        int64_t cycles = ptoa::hw_plain_cycles(stats.num_values, elements_per_cycle) + stats.header_cycles;
+        bandwidth roofline = measure_bandwidth(1, 64*1024*1024, 3);
+        double cpu_seconds = 2.0*stats.data_bytes/roofline.copy;
+        double hw_seconds = cycles/(clock_mhz*1e6);
+
+        std::cout << std::endl << "Predicted decode time:" << std::endl;
+        std::cout << "    cpu (copy at " << roofline.copy/1e9 << " GB/s)  : " << cpu_seconds*1e3 << " ms" << std::endl;
+        std::cout << "    hardware (" << elements_per_cycle << " values/cycle): " << cycles << " cycles, " << hw_seconds*1e3 << " ms" << std::endl;
+        return 0;
+    }
+
+    int64_t num_miniblocks = 0;
+    for(int64_t count : stats.bitwidth_counts) {
+        num_miniblocks += count;
+    }
+
+    std::cout << std::endl << "Miniblock bit widths (" << num_miniblocks << " miniblocks):" << std::endl;
+    for(int width=0; width<=prim_width; width++) {
+        if(stats.bitwidth_counts[width] > 0) {
+            std::cout << "    " << std::setw(10) << width;
+            print_bar(stats.bitwidth_counts[width], num_miniblocks);
+        }
+    }
+
+    std::cout << std::endl << "min_delta of " << stats.num_blocks << " blocks: " << stats.min_min_delta << " to " << stats.max_min_delta
+              << ", " << stats.negative_min_deltas << " negative, " << stats.zero_min_deltas << " zero" << std::endl;
+    std::cout << "Bits of |min_delta|:" << std::endl;
+    for(int bits=0; bits<=64; bits++) {
+        if(stats.min_delta_bits[bits] > 0) {
+            std::cout << "    " << std::setw(10) << bits;
+            print_bar(stats.min_delta_bits[bits], stats.num_blocks);
+        }
+    }
+
+    if(enc == ptoa::encoding::DELTA_LENGTH) {
+        std::cout << std::endl << "String lengths: " << stats.min_length << " to " << stats.max_length << ", average "
+                  << (stats.num_values > 0 ? (double) stats.total_length/stats.num_values : 0.0) << std::endl;
+        for(size_t bucket=0; bucket<stats.length_buckets.size(); bucket++) {
+            if(stats.length_buckets[bucket] > 0) {
+                int64_t low = bucket == 0 ? 0 : 1LL << (bucket - 1);
+                int64_t high = bucket == 0 ? 0 : (1LL << bucket) - 1;
+                std::cout << "    " << std::setw(10) << (std::to_string(low) + "-" + std::to_string(high));
+                print_bar(stats.length_buckets[bucket], stats.num_values);
+            }
+        }
+    }
+
+    double cpu_seconds = 0;
+    for(int width=0; width<=prim_width; width++) {
+        if(stats.bitwidth_counts[width] > 0) {
+            cpu_seconds += stats.bitwidth_counts[width]*cpu_miniblock_ns(prim_width, width)*1e-9;
+        }
+    }
+
+    std::cout << std::endl << "Predicted decode time of the " << (enc == ptoa::encoding::DELTA_LENGTH ? "string lengths" : "values") << ":" << std::endl;
+    std::cout << "    cpu (unpack and accumulate)  : " << cpu_seconds*1e3 << " ms" << std::endl;
+
+    if(enc == ptoa::encoding::DELTA) {
+        std::string fastest = "cpu";
+        double fastest_seconds = cpu_seconds;
+
+        for(int dec_data_width : {64, 128}) {
+            int64_t cycles = ptoa::hw_delta_cycles(stats.bitwidth_counts, elements_per_cycle, dec_data_width) + stats.header_cycles;
+            double hw_seconds = cycles/(clock_mhz*1e6);
+            std::string name = "prim" + std::to_string(prim_width) + "_delta_decw_" + std::to_string(dec_data_width);
+
+            std::cout << "    " << std::left << std::setw(29) << name << std::right << ": " << hw_seconds*1e3 << " ms, "
+                      << cycles << " cycles, " << (cycles > 0 ? (double) stats.num_values/cycles : 0.0) << " values/cycle" << std::endl;
+
+            if(hw_seconds < fastest_seconds) {
+                fastest = name;
+                fastest_seconds = hw_seconds;
+            }
+        }
+
+        std::cout << "Fastest predicted path: " << fastest << std::endl;
+    } else {
+        std::cout << "    No hardware model for DELTA_LENGTH, its decoder also depends on the characters per cycle" << std::endl;
+    }
+
+    return 0;
 }
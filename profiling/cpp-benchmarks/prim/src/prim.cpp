@@ -12,22 +12,65 @@
 
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <map>
 
+#include <arrow/util/config.h>
 #include <parquet/arrow/reader.h>
 
+#ifdef PTOA_IO_URING
+// Before SWParquetReader.h, AsyncParquetReader.h undoes the BLOCK_SIZE of linux/fs.h
+#include <AsyncParquetReader.h>
+#endif
 #include <SWParquetReader.h>
 #include <timer.h>
+#include <bandwidth.h>
+#include <results.h>
+#include <trace.h>
+#include <cache.h>
 
-#define PRIM_WIDTH 32
+// One line of the sweep file
+struct bench_config {
+    std::string hw_input_file_path;
+    std::string reference_parquet_file_path;
+    int32_t prim_width;
+    ptoa::encoding enc;
+    int64_t num_values;
+};
+
+// Range of pages decoded by one thread
+struct thread_slice {
+    int64_t file_offset;
+    int64_t value_offset;
+    int64_t num_values;
+};
+
+template<typename T> struct prim_traits;
+
+template<> struct prim_traits<int32_t> {
+    using array_type = arrow::Int32Array;
+    static const int32_t prim_width = 32;
+};
+
+template<> struct prim_traits<int64_t> {
+    using array_type = arrow::Int64Array;
+    static const int32_t prim_width = 64;
+};
 
 //Use standard Arrow library functions to read Arrow array from Parquet file
 //Only works for Parquet version 1 style files.
 std::shared_ptr<arrow::Array> readArray(std::string hw_input_file_path) {
   std::shared_ptr<arrow::io::ReadableFile> infile;
-  PARQUET_THROW_NOT_OK(arrow::io::ReadableFile::Open(hw_input_file_path, arrow::default_memory_pool(), &infile));
-  
+  PARQUET_ASSIGN_OR_THROW(infile, arrow::io::ReadableFile::Open(hw_input_file_path, arrow::default_memory_pool()));
+
   std::unique_ptr<parquet::arrow::FileReader> reader;
+#if ARROW_VERSION_MAJOR >= 19
+  PARQUET_ASSIGN_OR_THROW(reader, parquet::arrow::OpenFile(infile, arrow::default_memory_pool()));
+#else
   PARQUET_THROW_NOT_OK(parquet::arrow::OpenFile(infile, arrow::default_memory_pool(), &reader));
+#endif
 
   std::shared_ptr<arrow::ChunkedArray> carray;
   PARQUET_THROW_NOT_OK(reader->ReadColumn(0, &carray));
@@ -35,110 +78,482 @@ std::shared_ptr<arrow::Array> readArray(std::string hw_input_file_path) {
   return array;
 }
 
+bool parse_sweep_file(const char* sweep_file_path, std::vector<bench_config>* configs) {
+    std::ifstream sweep_file(sweep_file_path);
+    std::string line;
 
-int main(int argc, char **argv) {
-    int num_values;
-    char* hw_input_file_path;
-    char* reference_parquet_file_path;
-    int iterations;
-    bool verify_output;
-    ptoa::encoding enc;
+    if(!sweep_file.is_open()) {
+        std::cerr << "Could not open sweep file " << sweep_file_path << std::endl;
+        return false;
+    }
 
-    Timer t;
+    while(std::getline(sweep_file, line)) {
+        if(line.empty() || (line[0] == '#')) {
+            continue;
+        }
 
-    if (argc > 6) {
-      hw_input_file_path = argv[1];
-      reference_parquet_file_path = argv[2];
-      num_values = (uint32_t) std::strtoul(argv[3], nullptr, 10);
-      iterations = (uint32_t) std::strtoul(argv[4], nullptr, 10);
-      if(argv[5][0] == 'y') {
-        verify_output = true;
-      } else if (argv[5][0] == 'n') {
-        verify_output = false;
-      } else {
-        std::cerr << "Invalid argument. Option \"verify\" should be \"y\" or \"n\"" << std::endl;
-        return 1;
-      }
-      if(!strncmp(argv[6], "delta", 5)) {
-        enc = ptoa::encoding::DELTA;
-      } else if (!strncmp(argv[6], "plain", 5)) {
-        enc = ptoa::encoding::PLAIN;
-      } else {
-        std::cerr << "Invalid argument. Option \"encoding\" should be \"delta\" or \"plain\"" << std::endl;
-        return 1;
-      }
-    } else {
-      std::cerr << "Usage: prim parquet_hw_input_file_path reference_parquet_file_path num_values iterations verify(y or n) encoding" << std::endl;
-      return 1;
+        std::istringstream fields(line);
+        std::string encoding_name;
+        bench_config config;
+
+        if(!(fields >> config.hw_input_file_path >> config.prim_width >> encoding_name >> config.num_values)) {
+            std::cerr << "Invalid line in sweep file: " << line << std::endl;
+            return false;
+        }
+        fields >> config.reference_parquet_file_path;
+
+        if((config.prim_width != 32) && (config.prim_width != 64)) {
+            std::cerr << "Invalid width in sweep file. Width should be 32 or 64" << std::endl;
+            return false;
+        }
+        if(encoding_name == "delta") {
+            config.enc = ptoa::encoding::DELTA;
+        } else if (encoding_name == "plain") {
+            config.enc = ptoa::encoding::PLAIN;
+        } else {
+            std::cerr << "Invalid encoding in sweep file. Encoding should be \"delta\" or \"plain\"" << std::endl;
+            return false;
+        }
+
+        configs->push_back(config);
     }
 
-    ptoa::SWParquetReader reader(hw_input_file_path);
-    //reader.inspect_metadata(4);
-    reader.count_pages(4);
+    return true;
+}
 
-    std::shared_ptr<arrow::PrimitiveArray> array;
-    std::shared_ptr<arrow::Buffer> arr_buffer;
+// Split the pages holding the first num_values values over num_threads contiguous ranges with roughly the same amount of values.
+// Also returns the amount of bytes in the Parquet file (headers included) that are read for num_values values.
+void split_pages(const std::vector<ptoa::page_directory_entry>& page_directory, int64_t num_values, int num_threads, std::vector<thread_slice>* slices, int64_t* input_bytes) {
+    int64_t values_per_thread = (num_values + num_threads - 1)/num_threads;
+    int64_t value_counter = 0;
+    thread_slice slice = {0, 0, 0};
 
-    for(int i=0; i<iterations; i++){
-        t.start();
-        // Reading the Parquet file. The interesting bit.
-        if(reader.read_prim(PRIM_WIDTH, num_values, 4, &array, enc) != ptoa::status::OK){
-            return 1;
+    *input_bytes = 0;
+
+    for(const ptoa::page_directory_entry& page : page_directory) {
+        if(value_counter >= num_values) {
+            break;
+        }
+
+        if(slice.num_values == 0) {
+            slice.file_offset = page.offset;
+            slice.value_offset = value_counter;
+        }
+
+        int64_t page_values = std::min((int64_t) page.num_values, num_values - value_counter);
+        slice.num_values += page_values;
+        value_counter += page_values;
+        *input_bytes += page.metadata_size + page.compressed_size;
+
+        if(slice.num_values >= values_per_thread) {
+            slices->push_back(slice);
+            slice.num_values = 0;
         }
-        t.stop();
-        t.record();
     }
 
-    std::cout << "Read " << num_values << " values" << std::endl;
-    std::cout << "Average time in seconds (not pre-allocated): " << t.average() << std::endl;
+    if(slice.num_values > 0) {
+        slices->push_back(slice);
+    }
+}
 
-    t.clear_history();
+template<typename T>
+bool run_config(const bench_config& config, int num_threads, const bandwidth& roofline, int iterations, int warmup, bool flush, bool counters) {
+    const int32_t prim_width = prim_traits<T>::prim_width;
 
-    // Only relevant for the benchmark with pre-allocated (and memset) buffer
-    arrow::AllocateBuffer(num_values*(PRIM_WIDTH/8), &arr_buffer);
-    std::memset((void*)(arr_buffer->mutable_data()), 0, num_values*(PRIM_WIDTH/8));
+    ptoa::SWParquetReader reader(config.hw_input_file_path);
+    if(reader.build_page_directory(4) != ptoa::status::OK) {
+        return false;
+    }
 
-    for(int i=0; i<iterations; i++){
+    const std::vector<ptoa::page_directory_entry>& page_directory = reader.get_page_directory();
+    std::vector<thread_slice> slices;
+    int64_t input_bytes;
+    int64_t output_bytes = config.num_values*sizeof(T);
+
+    split_pages(page_directory, config.num_values, num_threads, &slices, &input_bytes);
+
+    int64_t values_in_file = 0;
+    for(const thread_slice& slice : slices) {
+        values_in_file += slice.num_values;
+    }
+    if(values_in_file < config.num_values) {
+        std::cerr << config.hw_input_file_path << " only contains " << values_in_file << " values" << std::endl;
+        return false;
+    }
+
+    std::shared_ptr<arrow::Buffer> arr_buffer;
+    if(ptoa::allocate_buffer(output_bytes, &arr_buffer) != ptoa::status::OK) {
+        return false;
+    }
+    std::memset((void*)(arr_buffer->mutable_data()), 0, output_bytes);
+
+    std::vector<std::shared_ptr<arrow::Buffer>> slice_buffers;
+    for(const thread_slice& slice : slices) {
+        slice_buffers.push_back(arrow::SliceMutableBuffer(arr_buffer, slice.value_offset*sizeof(T), slice.num_values*sizeof(T)));
+    }
+
+    std::vector<ptoa::status> results(slices.size());
+    auto read_slice = [&](size_t i) {
+        std::shared_ptr<arrow::PrimitiveArray> slice_array;
+        results[i] = reader.read_prim(prim_width, slices[i].num_values, slices[i].file_offset, &slice_array, slice_buffers[i], config.enc);
+    };
+
+    Timer t;
+    if(counters) {
+        t.enable_counters();
+    }
+
+    for(int i=0; i<warmup+iterations; i++){
+        if(flush) {
+            flush_caches();
+        }
+
+        // Thread creation is part of the measured time, like it would be for a reader that is called once per column chunk
         t.start();
-        // Reading the Parquet file. The interesting bit.
-        if(reader.read_prim(PRIM_WIDTH, num_values, 4, &array, arr_buffer, enc) != ptoa::status::OK){
-            return 1;
+        std::vector<std::thread> threads;
+        for(size_t s=1; s<slices.size(); s++) {
+            threads.emplace_back(read_slice, s);
+        }
+        read_slice(0);
+        for(std::thread& thread : threads) {
+            thread.join();
         }
         t.stop();
-        t.record();
+
+        for(ptoa::status result : results) {
+            if(result != ptoa::status::OK) {
+                return false;
+            }
+        }
+
+        if(i >= warmup) {
+            t.record();
+        }
     }
 
-    std::cout << "Read " << num_values << " values" << std::endl;
-    std::cout << "Average time in seconds (pre-allocated): " << t.average() << std::endl;
+    double median = t.median();
+
+    std::cout << std::left << std::setw(40) << config.hw_input_file_path << std::right
+              << std::setw(6) << prim_width
+              << std::setw(7) << (config.enc == ptoa::encoding::DELTA ? "delta" : "plain")
+              << std::setw(12) << config.num_values
+              << std::setw(10) << input_bytes/(int64_t) page_directory.size()
+              << std::setw(5) << slices.size()
+              << std::fixed << std::setprecision(3)
+              << std::setw(10) << t.min()*1e3
+              << std::setw(10) << median*1e3
+              << std::setw(10) << t.percentile(99)*1e3
+              << std::setw(9) << input_bytes/median/1e9
+              << std::setw(9) << output_bytes/median/1e9
+              << std::setprecision(1)
+              << std::setw(7) << 100.0*input_bytes/median/roofline.read
+              << std::setw(7) << 100.0*(input_bytes + output_bytes)/median/roofline.copy
+              << std::defaultfloat << std::endl;
+
+    t.print_counters(config.num_values, input_bytes);
+
+    Results::global().add("prim", {{"file", config.hw_input_file_path},
+                                   {"width", std::to_string(prim_width)},
+                                   {"encoding", config.enc == ptoa::encoding::DELTA ? "delta" : "plain"},
+                                   {"values", std::to_string(config.num_values)},
+                                   {"threads", std::to_string(num_threads)},
+                                   {"flush", flush ? "y" : "n"}}, "seconds", t.samples());
+
+    if(!config.reference_parquet_file_path.empty()) {
+        using array_type = typename prim_traits<T>::array_type;
+
+        auto result_array = std::make_shared<array_type>(config.num_values, arr_buffer);
+        auto correct_array = std::dynamic_pointer_cast<array_type>(readArray(config.reference_parquet_file_path));
 
-    if(verify_output) {
-        #if PRIM_WIDTH == 64
-            auto result_array = std::static_pointer_cast<arrow::Int64Array>(array);
-            auto correct_array = std::dynamic_pointer_cast<arrow::Int64Array>(readArray(std::string(reference_parquet_file_path)));
-        #elif PRIM_WIDTH == 32
-            auto result_array = std::static_pointer_cast<arrow::Int32Array>(array);
-            auto correct_array = std::dynamic_pointer_cast<arrow::Int32Array>(readArray(std::string(reference_parquet_file_path)));
-        #endif
-    
         // Verify result
-        int error_count = 0;
-    
-        for(int i=0; i<num_values; i++) {
+        int64_t error_count = 0;
+
+        for(int64_t i=0; i<config.num_values; i++) {
             if(result_array->Value(i) != correct_array->Value(i)) {
               error_count++;
               if(error_count<20) {
-                std::cout<<i<<std::endl;
+                std::cout<<i<<": "<< result_array->Value(i) <<" "<< correct_array->Value(i)<<std::endl;
               }
             }
         }
-    
-        if(error_count == 0) {
-          std::cout << "Test passed!" << std::endl;
-        } else {
+
+        if(error_count != 0) {
           std::cout << "Test failed. Found " << error_count << " errors in the output Arrow array" << std::endl;
+          return false;
         }
     }
-    
-    
 
+    return true;
+}
+
+#ifdef PTOA_IO_URING
+// Reads with an empty page cache, single threaded. Every iteration includes getting the file from disk: reading it into
+// memory first, mapping it, or streaming it through AsyncParquetReader.
+template<typename T>
+bool run_cold_config(const bench_config& config, int iterations, int warmup) {
+    const int32_t prim_width = prim_traits<T>::prim_width;
+    const char* mode_names[] = {"memory", "mmap", "io_uring"};
+    const int num_modes = 3;
+
+    std::vector<thread_slice> slices;
+    int64_t input_bytes;
+    int64_t output_bytes = config.num_values*sizeof(T);
+    int64_t file_offset;
+    {
+        ptoa::SWParquetReader reader(config.hw_input_file_path, true);
+        if(reader.build_page_directory(4) != ptoa::status::OK) {
+            return false;
+        }
+        split_pages(reader.get_page_directory(), config.num_values, 1, &slices, &input_bytes);
+    }
+    if(slices.empty() || (slices[0].num_values < config.num_values)) {
+        std::cerr << config.hw_input_file_path << " does not contain " << config.num_values << " values" << std::endl;
+        return false;
+    }
+    file_offset = slices[0].file_offset;
+
+    std::vector<std::shared_ptr<arrow::Buffer>> arr_buffers(num_modes);
+    std::vector<double> medians(num_modes);
+
+    for(int mode=0; mode<num_modes; mode++) {
+        if(ptoa::allocate_buffer(output_bytes, &arr_buffers[mode]) != ptoa::status::OK) {
+            return false;
+        }
+        std::memset((void*)(arr_buffers[mode]->mutable_data()), 0, output_bytes);
+
+        Timer t;
+        for(int i=0; i<warmup+iterations; i++){
+            if(!evict_file(config.hw_input_file_path)) {
+                return false;
+            }
+
+            std::shared_ptr<arrow::PrimitiveArray> prim_array;
+            ptoa::status result;
+
+            // Opening the file is part of the measured time, it is where the in-memory reader reads all of it
+            t.start();
+            if(mode == 2) {
+                ptoa::AsyncParquetReader reader(config.hw_input_file_path);
+                result = reader.read_prim(prim_width, config.num_values, file_offset, &prim_array, arr_buffers[mode], config.enc);
+            } else {
+                ptoa::SWParquetReader reader(config.hw_input_file_path, mode == 1);
+                result = reader.read_prim(prim_width, config.num_values, file_offset, &prim_array, arr_buffers[mode], config.enc);
+            }
+            t.stop();
+
+            if(result != ptoa::status::OK) {
+                std::cerr << "Cold read with " << mode_names[mode] << " failed" << std::endl;
+                return false;
+            }
+
+            if(i >= warmup) {
+                t.record();
+            }
+        }
+
+        medians[mode] = t.median();
+
+        std::cout << std::left << std::setw(40) << config.hw_input_file_path << std::right
+                  << std::setw(6) << prim_width
+                  << std::setw(7) << (config.enc == ptoa::encoding::DELTA ? "delta" : "plain")
+                  << std::setw(12) << config.num_values
+                  << std::setw(10) << mode_names[mode]
+                  << std::fixed << std::setprecision(3)
+                  << std::setw(10) << t.min()*1e3
+                  << std::setw(10) << medians[mode]*1e3
+                  << std::setw(9) << input_bytes/medians[mode]/1e9
+                  << std::setw(9) << output_bytes/medians[mode]/1e9
+                  << std::setprecision(2)
+                  << std::setw(9) << medians[0]/medians[mode]
+                  << std::defaultfloat << std::endl;
+
+        Results::global().add("prim_cold", {{"file", config.hw_input_file_path},
+                                            {"width", std::to_string(prim_width)},
+                                            {"encoding", config.enc == ptoa::encoding::DELTA ? "delta" : "plain"},
+                                            {"values", std::to_string(config.num_values)},
+                                            {"mode", mode_names[mode]}}, "seconds", t.samples());
+    }
+
+    // All modes decode the same pages, so they have to agree
+    for(int mode=1; mode<num_modes; mode++) {
+        if(std::memcmp(arr_buffers[0]->data(), arr_buffers[mode]->data(), output_bytes) != 0) {
+            std::cout << "Test failed. The " << mode_names[mode] << " output differs from the " << mode_names[0] << " output" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+#endif
+
+int main(int argc, char **argv) {
+    char* sweep_file_path;
+    int iterations;
+    int warmup;
+    std::vector<int> thread_counts;
+    bool flush = true;
+    bool counters = false;
+    bool cold = false;
+
+    if (argc > 4) {
+      sweep_file_path = argv[1];
+      iterations = (int) std::strtoul(argv[2], nullptr, 10);
+      warmup = (int) std::strtoul(argv[3], nullptr, 10);
+
+      std::istringstream thread_list(argv[4]);
+      std::string thread_count;
+      while(std::getline(thread_list, thread_count, ',')) {
+        thread_counts.push_back(std::max(1, std::atoi(thread_count.c_str())));
+      }
+
+      if(argc > 5) {
+        if(argv[5][0] == 'y') {
+          flush = true;
+        } else if (argv[5][0] == 'n') {
+          flush = false;
+        } else {
+          std::cerr << "Invalid argument. Option \"flush\" should be \"y\" or \"n\"" << std::endl;
+          return 1;
+        }
+      }
+
+      if(argc > 6) {
+        if(argv[6][0] == 'y') {
+          counters = true;
+        } else if (argv[6][0] == 'n') {
+          counters = false;
+        } else {
+          std::cerr << "Invalid argument. Option \"counters\" should be \"y\" or \"n\"" << std::endl;
+          return 1;
+        }
+      }
+
+      if(argc > 7) {
+        if(argv[7][0] == 'y') {
+          cold = true;
+        } else if (argv[7][0] == 'n') {
+          cold = false;
+        } else {
+          std::cerr << "Invalid argument. Option \"cold\" should be \"y\" or \"n\"" << std::endl;
+          return 1;
+        }
+      }
+
+#ifndef PTOA_IO_URING
+      if(cold) {
+        std::cerr << "Invalid argument. The cold read mode needs a build with PTOA_IO_URING" << std::endl;
+        return 1;
+      }
+#endif
+
+      if((iterations < 1) || thread_counts.empty()) {
+        std::cerr << "Invalid argument. At least one iteration and one thread count are needed" << std::endl;
+        return 1;
+      }
+    } else {
+      std::cerr << "Usage: prim sweep_file iterations warmup_iterations thread_counts(comma separated) [flush(y or n)] [counters(y or n)] [cold(y or n)]" << std::endl;
+      std::cerr << "Every line of sweep_file is one configuration: parquet_hw_input_file_path width(32 or 64) encoding(delta or plain) num_values [reference_parquet_file_path]" << std::endl;
+      std::cerr << "Sweep page sizes by listing files written with different page sizes." << std::endl;
+      std::cerr << "cold reads every file from disk, single threaded, in memory, memory mapped and with AsyncParquetReader (needs PTOA_IO_URING). It ignores thread_counts, flush and counters." << std::endl;
+      return 1;
+    }
+
+    // Set PTOA_TRACE to a file path to write a Chrome trace of all configurations
+    Trace::global().enable_from_env();
+    // Set PTOA_RESULTS to a .json or .csv path to append the timings of all configurations for compare_results.py
+    Results::global().enable_from_env();
+
+    std::vector<bench_config> configs;
+    if(!parse_sweep_file(sweep_file_path, &configs)) {
+        return 1;
+    }
+
+    int failures = 0;
+
+#ifdef PTOA_IO_URING
+    if(cold) {
+        std::cout << std::left << std::setw(40) << "file" << std::right
+                  << std::setw(6) << "width"
+                  << std::setw(7) << "enc"
+                  << std::setw(12) << "values"
+                  << std::setw(10) << "mode"
+                  << std::setw(10) << "min(ms)"
+                  << std::setw(10) << "med(ms)"
+                  << std::setw(9) << "in GB/s"
+                  << std::setw(9) << "out GB/s"
+                  << std::setw(9) << "vs mem" << std::endl;
+
+        for(const bench_config& config : configs) {
+            bool passed;
+            if(config.prim_width == 32) {
+                passed = run_cold_config<int32_t>(config, iterations, warmup);
+            } else {
+                passed = run_cold_config<int64_t>(config, iterations, warmup);
+            }
+
+            if(!passed) {
+                std::cerr << "Configuration failed: " << config.hw_input_file_path << " read cold" << std::endl;
+                failures++;
+            }
+        }
+
+        Trace::global().write();
+        Results::global().write();
+
+        return failures == 0 ? 0 : 1;
+    }
+#endif
+
+    // The roofline: a decode run can't read its input faster than the read bandwidth, nor read its input and write its output
+    // faster than the copy bandwidth at the same thread count
+    std::map<int, bandwidth> rooflines;
+    std::cout << std::left << std::setw(5) << "thr" << std::right
+              << std::setw(12) << "read GB/s"
+              << std::setw(12) << "copy GB/s" << std::endl;
+    for(int num_threads : thread_counts) {
+        if(rooflines.count(num_threads) == 0) {
+            rooflines[num_threads] = measure_bandwidth(num_threads);
+            std::cout << std::left << std::setw(5) << num_threads << std::right
+                      << std::fixed << std::setprecision(3)
+                      << std::setw(12) << rooflines[num_threads].read/1e9
+                      << std::setw(12) << rooflines[num_threads].copy/1e9
+                      << std::defaultfloat << std::endl;
+        }
+    }
+    std::cout << std::endl;
+
+    std::cout << std::left << std::setw(40) << "file" << std::right
+              << std::setw(6) << "width"
+              << std::setw(7) << "enc"
+              << std::setw(12) << "values"
+              << std::setw(10) << "page(B)"
+              << std::setw(5) << "thr"
+              << std::setw(10) << "min(ms)"
+              << std::setw(10) << "med(ms)"
+              << std::setw(10) << "p99(ms)"
+              << std::setw(9) << "in GB/s"
+              << std::setw(9) << "out GB/s"
+              << std::setw(7) << "%read"
+              << std::setw(7) << "%copy" << std::endl;
+
+    for(const bench_config& config : configs) {
+        for(int num_threads : thread_counts) {
+            bool passed;
+            if(config.prim_width == 32) {
+                passed = run_config<int32_t>(config, num_threads, rooflines[num_threads], iterations, warmup, flush, counters);
+            } else {
+                passed = run_config<int64_t>(config, num_threads, rooflines[num_threads], iterations, warmup, flush, counters);
+            }
+
+            if(!passed) {
+                std::cerr << "Configuration failed: " << config.hw_input_file_path << " with " << num_threads << " threads" << std::endl;
+                failures++;
+            }
+        }
+    }
+
+    Trace::global().write();
+    Results::global().write();
+
+    return failures == 0 ? 0 : 1;
 }
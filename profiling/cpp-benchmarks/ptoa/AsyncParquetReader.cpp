@@ -0,0 +1,360 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "AsyncParquetReader.h"
+#include "trace.h"
+#include "ptoa.h"
+
+namespace ptoa {
+
+// Open the Parquet file and set up the io_uring instance and segment buffers. Nothing is read yet.
+AsyncParquetReader::AsyncParquetReader(std::string file_path, int32_t queue_depth, int32_t segment_size) {
+    this->queue_depth = queue_depth;
+    // Segments have to be a multiple of the O_DIRECT alignment
+    this->segment_size = ((segment_size + DIRECT_IO_ALIGNMENT - 1) / DIRECT_IO_ALIGNMENT) * DIRECT_IO_ALIGNMENT;
+
+    initialized = false;
+    ring_ready = false;
+    buffers_registered = false;
+    file_size = 0;
+
+    fd = open(file_path.c_str(), O_RDONLY | O_DIRECT);
+    if(fd < 0) {
+        // Not every file system supports O_DIRECT (tmpfs for example)
+        std::cerr << "[WARNING] Could not open " << file_path << " with O_DIRECT, falling back to buffered reads" << std::endl;
+        fd = open(file_path.c_str(), O_RDONLY);
+    }
+    if(fd < 0) {
+        std::cerr << "[ERROR] Could not open " << file_path << ": " << strerror(errno) << std::endl;
+        return;
+    }
+
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0) {
+        std::cerr << "[ERROR] Could not determine size of " << file_path << std::endl;
+        return;
+    }
+    file_size = file_stat.st_size;
+
+    int ret = io_uring_queue_init(queue_depth, &ring, 0);
+    if(ret < 0) {
+        std::cerr << "[ERROR] Could not set up io_uring: " << strerror(-ret) << std::endl;
+        return;
+    }
+    ring_ready = true;
+
+    std::vector<struct iovec> iovecs(queue_depth);
+    for(int i=0; i<queue_depth; i++) {
+        uint8_t* buffer;
+        if(posix_memalign((void**) &buffer, DIRECT_IO_ALIGNMENT, this->segment_size) != 0) {
+            std::cerr << "[ERROR] Could not allocate segment buffers" << std::endl;
+            return;
+        }
+        segment_buffers.push_back(buffer);
+        iovecs[i].iov_base = buffer;
+        iovecs[i].iov_len = this->segment_size;
+    }
+
+    // Registered buffers save the kernel from mapping them on every read, but they count against RLIMIT_MEMLOCK
+    if(io_uring_register_buffers(&ring, iovecs.data(), queue_depth) == 0) {
+        buffers_registered = true;
+    } else {
+        std::cerr << "[WARNING] Could not register segment buffers, falling back to unregistered reads" << std::endl;
+    }
+
+    segment_results.resize(queue_depth);
+    segment_done.resize(queue_depth, false);
+
+    initialized = true;
+}
+
+AsyncParquetReader::~AsyncParquetReader() {
+    if(ring_ready) {
+        if(buffers_registered) {
+            io_uring_unregister_buffers(&ring);
+        }
+        io_uring_queue_exit(&ring);
+    }
+
+    for(uint8_t* buffer : segment_buffers) {
+        free(buffer);
+    }
+
+    if(fd >= 0) {
+        close(fd);
+    }
+}
+
+status AsyncParquetReader::read_prim(int32_t prim_width, int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, encoding enc) {
+    std::shared_ptr<arrow::Buffer> arr_buffer;
+    if(allocate_buffer(num_values*prim_width/8, &arr_buffer) != status::OK) {
+        return status::FAIL;
+    }
+
+    return read_prim(prim_width, num_values, file_offset, prim_array, arr_buffer, enc);
+}
+
+// Read a number (set by num_values) of either 32 or 64 bit integers (set by prim_width) into prim_array, starting with the page at file_offset.
+// Segments are read in order but may complete out of order. They are processed strictly in order: pages that lie completely inside
+// a segment are decoded in place, pages that cross a segment boundary are first gathered in the carry buffer.
+status AsyncParquetReader::read_prim(int32_t prim_width, int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer, encoding enc) {
+    if(!initialized) {
+        std::cerr << "[ERROR] AsyncParquetReader was not initialized correctly" << std::endl;
+        return status::FAIL;
+    }
+
+    this->prim_width = prim_width;
+    this->enc = enc;
+    values_left = num_values;
+    out_ptr = arr_buffer->mutable_data();
+    carry.clear();
+
+    read_start = file_offset - (file_offset % DIRECT_IO_ALIGNMENT);
+    segments_submitted = 0;
+    in_flight = 0;
+
+    // Fill the queue
+    while((in_flight < queue_depth) && ((uint64_t)(read_start + segments_submitted*segment_size) < file_size)) {
+        if(submit_segment(segments_submitted) != status::OK) {
+            drain();
+            return status::FAIL;
+        }
+    }
+    io_uring_submit(&ring);
+
+    for(int64_t segment_index = 0; values_left > 0; segment_index++) {
+        if(segment_index >= segments_submitted) {
+            std::cerr << "[ERROR] Reached end of file with " << values_left << " values left to read" << std::endl;
+            drain();
+            return status::FAIL;
+        }
+
+        int32_t bytes_read;
+        if(wait_for_segment(segment_index, &bytes_read) != status::OK) {
+            drain();
+            return status::FAIL;
+        }
+
+        const uint8_t* segment_ptr = segment_buffers[segment_index % queue_depth];
+        int32_t position = (segment_index == 0) ? (int32_t)(file_offset - read_start) : 0;
+
+        // Finish the page that started in an earlier segment
+        int32_t bytes_used;
+        if(consume_carry(segment_ptr + position, bytes_read - position, &bytes_used) != status::OK) {
+            drain();
+            return status::FAIL;
+        }
+        position += bytes_used;
+
+        // Decode all pages that are completely inside this segment in place
+        while((values_left > 0) && carry.empty() && (position < bytes_read)) {
+            int32_t page_size;
+            int32_t page_num_values;
+
+            if(bytes_read - position < PAGE_HEADER_MAX_SIZE) {
+                carry.assign(segment_ptr + position, segment_ptr + bytes_read);
+                break;
+            }
+
+            if(page_decoder.read_page_size(segment_ptr + position, &page_size, &page_num_values) != status::OK) {
+                std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
+                std::cerr << read_start + segment_index*segment_size + position << std::endl;
+                drain();
+                return status::FAIL;
+            }
+
+            if(page_size > bytes_read - position) {
+                carry.assign(segment_ptr + position, segment_ptr + bytes_read);
+                break;
+            }
+
+            if(consume_page(segment_ptr + position, page_num_values) != status::OK) {
+                drain();
+                return status::FAIL;
+            }
+            position += page_size;
+        }
+
+        // Recycle the segment buffer for the next read
+        if((values_left > 0) && ((uint64_t)(read_start + segments_submitted*segment_size) < file_size)) {
+            if(submit_segment(segments_submitted) != status::OK) {
+                drain();
+                return status::FAIL;
+            }
+            io_uring_submit(&ring);
+        }
+    }
+
+    drain();
+
+    if(prim_width == 64){
+        *prim_array = std::make_shared<arrow::PrimitiveArray>(arrow::int64(), num_values, arr_buffer);
+    } else if (prim_width == 32) {
+        *prim_array = std::make_shared<arrow::PrimitiveArray>(arrow::int32(), num_values, arr_buffer);
+    } else {
+        std::cerr << "[ERROR] Unsupported prim width " << prim_width << std::endl;
+        return status::FAIL;
+    }
+
+    return status::OK;
+}
+
+// Queue the read of a segment into the buffer it maps to. The caller is responsible for calling io_uring_submit.
+status AsyncParquetReader::submit_segment(int64_t segment_index) {
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    if(sqe == nullptr) {
+        std::cerr << "[ERROR] io_uring submission queue full" << std::endl;
+        return status::FAIL;
+    }
+
+    int32_t slot = segment_index % queue_depth;
+    int64_t offset = read_start + segment_index*segment_size;
+
+    if(buffers_registered) {
+        io_uring_prep_read_fixed(sqe, fd, segment_buffers[slot], segment_size, offset, slot);
+    } else {
+        io_uring_prep_read(sqe, fd, segment_buffers[slot], segment_size, offset);
+    }
+    io_uring_sqe_set_data(sqe, (void*)(uintptr_t) segment_index);
+
+    segments_submitted++;
+    in_flight++;
+
+    return status::OK;
+}
+
+// Block until the read of segment_index has completed. Completions of other segments are recorded along the way.
+status AsyncParquetReader::wait_for_segment(int64_t segment_index, int32_t* bytes_read) {
+    int32_t slot = segment_index % queue_depth;
+    TraceSpan wait_span("wait for segment", "io");
+
+    while(!segment_done[slot]) {
+        struct io_uring_cqe* cqe;
+        int ret = io_uring_wait_cqe(&ring, &cqe);
+        if(ret < 0) {
+            std::cerr << "[ERROR] Waiting for io_uring completion failed: " << strerror(-ret) << std::endl;
+            return status::FAIL;
+        }
+
+        int64_t completed_index = (int64_t)(uintptr_t) io_uring_cqe_get_data(cqe);
+        segment_results[completed_index % queue_depth] = cqe->res;
+        segment_done[completed_index % queue_depth] = true;
+        in_flight--;
+        io_uring_cqe_seen(&ring, cqe);
+    }
+
+    segment_done[slot] = false;
+
+    if(segment_results[slot] < 0) {
+        std::cerr << "[ERROR] Read of segment " << segment_index << " failed: " << strerror(-segment_results[slot]) << std::endl;
+        return status::FAIL;
+    }
+
+    // Only the read at the end of the file is allowed to be short
+    int64_t segment_offset = read_start + segment_index*segment_size;
+    if((segment_results[slot] < segment_size) && ((uint64_t)(segment_offset + segment_results[slot]) < file_size)) {
+        std::cerr << "[ERROR] Short read of segment " << segment_index << std::endl;
+        return status::FAIL;
+    }
+
+    *bytes_read = segment_results[slot];
+
+    return status::OK;
+}
+
+// Wait for all outstanding reads so their buffers can be reused by the next read_prim call.
+status AsyncParquetReader::drain() {
+    while(in_flight > 0) {
+        struct io_uring_cqe* cqe;
+        if(io_uring_wait_cqe(&ring, &cqe) < 0) {
+            return status::FAIL;
+        }
+        io_uring_cqe_seen(&ring, cqe);
+        in_flight--;
+    }
+
+    std::fill(segment_done.begin(), segment_done.end(), false);
+
+    return status::OK;
+}
+
+// Move bytes from the start of a new segment into the carry buffer until the page(s) in it are complete, and decode them.
+// bytes_used is set to the amount of bytes taken from data.
+status AsyncParquetReader::consume_carry(const uint8_t* data, int32_t size, int32_t* bytes_used) {
+    int32_t page_size;
+    int32_t page_num_values;
+    int32_t take;
+
+    *bytes_used = 0;
+
+    while(!carry.empty() && (values_left > 0)) {
+        // Make sure the complete page header is in the carry buffer
+        if(carry.size() < PAGE_HEADER_MAX_SIZE) {
+            take = std::min((int32_t)(PAGE_HEADER_MAX_SIZE - carry.size()), size - *bytes_used);
+            carry.insert(carry.end(), data + *bytes_used, data + *bytes_used + take);
+            *bytes_used += take;
+
+            if(carry.size() < PAGE_HEADER_MAX_SIZE) {
+                return status::OK;
+            }
+        }
+
+        if(page_decoder.read_page_size(carry.data(), &page_size, &page_num_values) != status::OK) {
+            std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
+            return status::FAIL;
+        }
+
+        if((int32_t) carry.size() < page_size) {
+            take = std::min(page_size - (int32_t) carry.size(), size - *bytes_used);
+            carry.insert(carry.end(), data + *bytes_used, data + *bytes_used + take);
+            *bytes_used += take;
+
+            if((int32_t) carry.size() < page_size) {
+                return status::OK;
+            }
+        }
+
+        if(consume_page(carry.data(), page_num_values) != status::OK) {
+            return status::FAIL;
+        }
+        carry.erase(carry.begin(), carry.begin() + page_size);
+    }
+
+    return status::OK;
+}
+
+// Decode a complete page into the output buffer
+status AsyncParquetReader::consume_page(const uint8_t* page_ptr, int32_t page_num_values) {
+    TraceSpan page_span("page", "decode");
+    int32_t values_to_read = (int32_t) std::min((int64_t) page_num_values, values_left);
+
+    if(page_decoder.decode_page(prim_width, page_ptr, values_to_read, out_ptr, enc) != status::OK) {
+        return status::FAIL;
+    }
+
+    out_ptr += (int64_t) values_to_read*prim_width/8;
+    values_left -= values_to_read;
+
+    return status::OK;
+}
+
+}
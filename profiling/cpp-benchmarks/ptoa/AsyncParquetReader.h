@@ -0,0 +1,81 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <liburing.h>
+// linux/fs.h (included through liburing.h) has its own BLOCK_SIZE, we want the one for DELTA_BINARY_PACKED blocks
+#undef BLOCK_SIZE
+
+#include <arrow/api.h>
+
+#include "SWParquetReader.h"
+#include "ptoa.h"
+
+// Reads issued with O_DIRECT have to be aligned to the logical block size of the device
+#define DIRECT_IO_ALIGNMENT 4096
+
+// Every page header this reader can parse fits in this many bytes
+#define PAGE_HEADER_MAX_SIZE 64
+
+namespace ptoa{
+
+/**
+ * Reader for Parquet files that do not fit in host memory. Column chunks are streamed from disk in fixed size segments
+ * using io_uring, with queue_depth segment reads in flight at any time. Pages are decoded as soon as all their bytes have
+ * arrived, after which the segment buffer is reused for the next read.
+ */
+class AsyncParquetReader {
+  public:
+    AsyncParquetReader(std::string file_path, int32_t queue_depth = 8, int32_t segment_size = 1 << 20);
+    ~AsyncParquetReader();
+    status read_prim(int32_t prim_width, int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, encoding enc);
+    status read_prim(int32_t prim_width, int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer, encoding enc);
+
+  private:
+    status submit_segment(int64_t segment_index);
+    status wait_for_segment(int64_t segment_index, int32_t* bytes_read);
+    status drain();
+    status consume_carry(const uint8_t* data, int32_t size, int32_t* bytes_used);
+    status consume_page(const uint8_t* page_ptr, int32_t page_num_values);
+
+    SWParquetReader page_decoder;
+
+    int fd;
+    size_t file_size;
+    bool initialized;
+    bool ring_ready;
+    bool buffers_registered;
+
+    struct io_uring ring;
+    int32_t queue_depth;
+    int32_t segment_size;
+    std::vector<uint8_t*> segment_buffers;
+    std::vector<int32_t> segment_results;
+    std::vector<bool> segment_done;
+
+    // Per read state
+    int64_t read_start;
+    int64_t segments_submitted;
+    int32_t in_flight;
+    std::vector<uint8_t> carry;
+    int32_t prim_width;
+    encoding enc;
+    int64_t values_left;
+    uint8_t* out_ptr;
+};
+
+}
@@ -0,0 +1,139 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+
+#include "ColumnIndex.h"
+#include "ptoa.h"
+
+namespace ptoa {
+
+static const char* encoding_names[] = {"plain", "delta", "delta_length"};
+
+// Names can't be escaped in the index: a tab or line break would split the line, and a leading '#' would make it a comment
+static bool valid_index_field(const std::string& field) {
+    return !field.empty() && field[0] != '#' && field.find_first_of("\t\r\n") == std::string::npos;
+}
+
+status write_column_index(const std::string& index_path, const std::vector<column_index_entry>& entries) {
+    std::ofstream index(index_path);
+    if(!index) {
+        std::cerr << "[ERROR] Could not open " << index_path << " for writing" << std::endl;
+        return status::FAIL;
+    }
+
+    for(const column_index_entry& entry : entries) {
+        if(!valid_index_field(entry.column_name) || !valid_index_field(entry.file_name)) {
+            std::cerr << "[ERROR] Column \"" << entry.column_name << "\" in file \"" << entry.file_name
+                      << "\" can't be written to the index, names can't be empty, contain tabs or line breaks, or start with '#'" << std::endl;
+            return status::FAIL;
+        }
+    }
+
+    index << "# column\tfile\tprim_width\tencoding\tfile_offset\tpages_size\tnum_values\tnum_chars\tvalues_per_page" << std::endl;
+    for(const column_index_entry& entry : entries) {
+        index << entry.column_name << '\t' << entry.file_name << '\t' << entry.prim_width << '\t' << encoding_names[entry.enc] << '\t'
+              << entry.file_offset << '\t' << entry.pages_size << '\t' << entry.num_values << '\t' << entry.num_chars << '\t'
+              << entry.values_per_page << std::endl;
+    }
+
+    if(!index) {
+        std::cerr << "[ERROR] Could not write " << index_path << std::endl;
+        return status::FAIL;
+    }
+
+    return status::OK;
+}
+
+status read_column_index(const std::string& index_path, std::vector<column_index_entry>* entries) {
+    std::ifstream index(index_path);
+    if(!index) {
+        std::cerr << "[ERROR] Could not open " << index_path << std::endl;
+        return status::FAIL;
+    }
+
+    entries->clear();
+    std::string line;
+    int line_number = 0;
+    while(std::getline(index, line)) {
+        line_number++;
+        if(line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        // Column names may contain spaces, so only tabs separate the fields
+        std::vector<std::string> fields;
+        std::istringstream line_stream(line);
+        std::string field;
+        while(std::getline(line_stream, field, '\t')) {
+            fields.push_back(field);
+        }
+
+        column_index_entry entry;
+        bool valid = fields.size() == 9;
+        if(valid) {
+            entry.column_name = fields[0];
+            entry.file_name = fields[1];
+            entry.prim_width = std::atoi(fields[2].c_str());
+            if(fields[3] == "plain") {
+                entry.enc = encoding::PLAIN;
+            } else if(fields[3] == "delta") {
+                entry.enc = encoding::DELTA;
+            } else if(fields[3] == "delta_length") {
+                entry.enc = encoding::DELTA_LENGTH;
+            } else {
+                valid = false;
+            }
+            entry.file_offset = std::strtoll(fields[4].c_str(), nullptr, 10);
+            entry.pages_size = std::strtoll(fields[5].c_str(), nullptr, 10);
+            entry.num_values = std::strtoll(fields[6].c_str(), nullptr, 10);
+            entry.num_chars = std::strtoll(fields[7].c_str(), nullptr, 10);
+            entry.values_per_page = std::atoi(fields[8].c_str());
+        }
+
+        if(!valid) {
+            std::cerr << "[ERROR] Line " << line_number << " of " << index_path << " is not a valid column index entry" << std::endl;
+            return status::FAIL;
+        }
+        entries->push_back(entry);
+    }
+
+    return status::OK;
+}
+
+status find_column_index_entry(const std::string& index_path, const std::string& column_name, column_index_entry* entry) {
+    std::vector<column_index_entry> entries;
+    if(read_column_index(index_path, &entries) != status::OK) {
+        return status::FAIL;
+    }
+
+    for(const column_index_entry& candidate : entries) {
+        if(candidate.column_name == column_name) {
+            *entry = candidate;
+
+            // File names in the index are relative to its directory
+            size_t separator = index_path.find_last_of('/');
+            if(separator != std::string::npos && entry->file_name[0] != '/') {
+                entry->file_name = index_path.substr(0, separator + 1) + entry->file_name;
+            }
+            return status::OK;
+        }
+    }
+
+    std::cerr << "[ERROR] Column " << column_name << " is not in " << index_path << std::endl;
+    return status::FAIL;
+}
+
+}
@@ -0,0 +1,49 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "ptoa.h"
+
+namespace ptoa{
+
+/*
+ * One line of the sidecar index written next to hardware compatible Parquet files: everything the host drivers need to read
+ * a column without parsing the footer. The index is a tab separated text file with one column per line, lines starting with
+ * '#' are comments. Column and file names can't start with '#' or contain tabs or line breaks, write_column_index rejects them.
+ */
+struct column_index_entry {
+    std::string column_name;
+    // Relative to the directory of the index
+    std::string file_name;
+    // 32 or 64 for integers, 0 for strings
+    int32_t prim_width;
+    encoding enc;
+    // Offset of the first page and size of all pages, the device buffer the hardware reads from
+    int64_t file_offset;
+    int64_t pages_size;
+    int64_t num_values;
+    // Total length of all strings, 0 for integers
+    int64_t num_chars;
+    int32_t values_per_page;
+};
+
+status write_column_index(const std::string& index_path, const std::vector<column_index_entry>& entries);
+status read_column_index(const std::string& index_path, std::vector<column_index_entry>* entries);
+// Entry of column_name, with its file_name resolved against the directory of the index
+status find_column_index_entry(const std::string& index_path, const std::string& column_name, column_index_entry* entry);
+
+}
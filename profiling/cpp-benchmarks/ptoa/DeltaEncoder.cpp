@@ -0,0 +1,142 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#include "DeltaEncoder.h"
+#include "LemireBitUnpacking.h"
+#include "ptoa.h"
+
+namespace ptoa {
+
+static void pack_group(const uint32_t* deltas, uint8_t* out, int32_t bitwidth) {
+    fastpack(deltas, (uint*) out, bitwidth);
+}
+
+static void pack_group(const uint64_t* deltas, uint8_t* out, int32_t bitwidth) {
+    int64fastpack(deltas, (uint64_t*) out, bitwidth);
+}
+
+DeltaEncoder::DeltaEncoder(delta_options options) : options(options) {}
+
+status DeltaEncoder::check_options(int32_t prim_width) const {
+    if(options.block_size <= 0 || options.block_size % BLOCK_SIZE_MULTIPLE != 0) {
+        std::cerr << "[ERROR] The delta block size should be a multiple of " << BLOCK_SIZE_MULTIPLE << ", not " << options.block_size << std::endl;
+        return status::FAIL;
+    }
+    if(options.miniblocks_in_block <= 0 || options.block_size % options.miniblocks_in_block != 0 ||
+       (options.block_size / options.miniblocks_in_block) % PACK_GROUP_SIZE != 0) {
+        std::cerr << "[ERROR] " << options.miniblocks_in_block << " miniblocks in a block of " << options.block_size
+                  << " values don't hold a multiple of " << PACK_GROUP_SIZE << " values each" << std::endl;
+        return status::FAIL;
+    }
+    if(options.max_bitwidth < 0 || options.max_bitwidth > prim_width) {
+        std::cerr << "[ERROR] The maximum bit width should be between 0 and " << prim_width << ", not " << options.max_bitwidth << std::endl;
+        return status::FAIL;
+    }
+    if(options.block_size != BLOCK_SIZE || options.miniblocks_in_block != MINIBLOCKS_IN_BLOCK) {
+        std::cerr << "[WARNING] SWParquetReader only decodes blocks of " << BLOCK_SIZE << " values in " << MINIBLOCKS_IN_BLOCK
+                  << " miniblocks, these pages are for hardware built with a block size of " << options.block_size << " and "
+                  << options.miniblocks_in_block << " miniblocks" << std::endl;
+    }
+
+    return status::OK;
+}
+
+status DeltaEncoder::encode(const int32_t* values, int32_t num_values, std::vector<uint8_t>* out) const {
+    return encode_page(values, num_values, out);
+}
+
+status DeltaEncoder::encode(const int64_t* values, int32_t num_values, std::vector<uint8_t>* out) const {
+    return encode_page(values, num_values, out);
+}
+
+// A header with the first value, followed by blocks of deltas. Deltas are computed with wrapping arithmetic, like the decoders.
+// The last miniblock with values is padded with zeros and miniblocks without any values are not stored, their bit width is
+// written as 0. Every step is a separate loop over the whole block without dependencies between iterations, so the compiler
+// vectorizes all of them but the packing.
+template<typename T>
+status DeltaEncoder::encode_page(const T* values, int32_t num_values, std::vector<uint8_t>* out) const {
+    typedef typename std::make_unsigned<T>::type U;
+
+    const int32_t block_size = options.block_size;
+    const int32_t miniblock_size = block_size / options.miniblocks_in_block;
+    const int32_t max_bitwidth = options.max_bitwidth > 0 ? options.max_bitwidth : (int32_t) (8*sizeof(T));
+
+    write_varint(out, block_size);
+    write_varint(out, options.miniblocks_in_block);
+    write_varint(out, num_values);
+    write_varint(out, zigzag(num_values > 0 ? values[0] : 0));
+
+    std::vector<U> block_deltas(block_size);
+    std::vector<uint8_t> bitwidths(options.miniblocks_in_block);
+    U* deltas = block_deltas.data();
+
+    for(int32_t block_start = 1; block_start < num_values; block_start += block_size) {
+        const int32_t block_count = std::min(block_size, num_values - block_start);
+        const T* block_values = values + block_start;
+
+        for(int32_t i=0; i<block_count; i++) {
+            deltas[i] = (U) block_values[i] - (U) block_values[i-1];
+        }
+
+        T min_delta = std::numeric_limits<T>::max();
+        for(int32_t i=0; i<block_count; i++) {
+            T delta = (T) deltas[i];
+            min_delta = delta < min_delta ? delta : min_delta;
+        }
+
+        for(int32_t i=0; i<block_count; i++) {
+            deltas[i] -= (U) min_delta;
+        }
+        std::fill(deltas + block_count, deltas + block_size, 0);
+
+        const int32_t num_miniblocks = (block_count + miniblock_size - 1) / miniblock_size;
+        int64_t block_bytes = 0;
+        std::fill(bitwidths.begin(), bitwidths.end(), 0);
+        for(int32_t m=0; m<num_miniblocks; m++) {
+            const U* miniblock = deltas + m*miniblock_size;
+            U bits = 0;
+            for(int32_t i=0; i<miniblock_size; i++) {
+                bits |= miniblock[i];
+            }
+            bitwidths[m] = bits == 0 ? 0 : 64 - __builtin_clzll((uint64_t) bits);
+
+            if(bitwidths[m] > max_bitwidth) {
+                std::cerr << "[ERROR] The miniblock starting at value " << block_start + m*miniblock_size << " of this page needs "
+                          << (int) bitwidths[m] << " bits, more than the maximum of " << max_bitwidth << std::endl;
+                return status::FAIL;
+            }
+            block_bytes += bitwidths[m]*miniblock_size/8;
+        }
+
+        write_varint(out, zigzag(min_delta));
+        out->insert(out->end(), bitwidths.begin(), bitwidths.end());
+
+        size_t position = out->size();
+        out->resize(position + block_bytes);
+        uint8_t* packed = out->data() + position;
+        for(int32_t m=0; m<num_miniblocks; m++) {
+            for(int32_t group=0; group<miniblock_size; group+=PACK_GROUP_SIZE) {
+                pack_group(deltas + m*miniblock_size + group, packed, bitwidths[m]);
+                packed += bitwidths[m]*PACK_GROUP_SIZE/8;
+            }
+        }
+    }
+
+    return status::OK;
+}
+
+}
@@ -0,0 +1,73 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "ptoa.h"
+#include "SWParquetReader.h"
+
+// Values packed by a single fastpack or int64fastpack call. Miniblocks hold a multiple of this.
+#define PACK_GROUP_SIZE 32
+// The Parquet specification requires blocks of a multiple of 128 values
+#define BLOCK_SIZE_MULTIPLE 128
+
+namespace ptoa{
+
+inline void write_varint(std::vector<uint8_t>* out, uint64_t value) {
+    while(value >= 0x80) {
+        out->push_back((uint8_t) (value | 0x80));
+        value >>= 7;
+    }
+    out->push_back((uint8_t) value);
+}
+
+inline uint64_t zigzag(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+// Geometry and bit width limit of the DELTA_BINARY_PACKED blocks written by DeltaEncoder
+struct delta_options {
+    // SWParquetReader only decodes blocks of BLOCK_SIZE values in MINIBLOCKS_IN_BLOCK miniblocks. Other geometries are meant for
+    // hardware built with matching BLOCK_SIZE and MINIBLOCKS_IN_BLOCK generics: smaller miniblocks keep a single large delta from
+    // slowing down the BitUnpacker for more values than necessary.
+    int32_t block_size = BLOCK_SIZE;
+    int32_t miniblocks_in_block = MINIBLOCKS_IN_BLOCK;
+    // Widest miniblock the target BitUnpacker is built for, 0 for the width of the values. Encoding a page that needs wider
+    // miniblocks fails instead of producing a file the hardware can't decode.
+    int32_t max_bitwidth = 0;
+};
+
+/**
+ * DELTA_BINARY_PACKED encoder for single pages. For every block it computes the deltas, the block min_delta and the bit width of
+ * every miniblock in separate passes over the block, which the compiler vectorizes, and packs the miniblocks with fastpack or
+ * int64fastpack. Encoding is stateless, so one encoder can be shared by threads encoding different pages. The options are only
+ * validated by check_options, call it before encoding.
+ */
+class DeltaEncoder {
+  public:
+    DeltaEncoder(delta_options options = delta_options());
+    status check_options(int32_t prim_width) const;
+    status encode(const int32_t* values, int32_t num_values, std::vector<uint8_t>* out) const;
+    status encode(const int64_t* values, int32_t num_values, std::vector<uint8_t>* out) const;
+    const delta_options& get_options() const {return options;}
+
+  private:
+    template<typename T>
+    status encode_page(const T* values, int32_t num_values, std::vector<uint8_t>* out) const;
+
+    delta_options options;
+};
+
+}
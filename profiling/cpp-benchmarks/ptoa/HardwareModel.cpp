@@ -0,0 +1,104 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "HardwareModel.h"
+
+namespace ptoa {
+
+static int bit_length(uint64_t value) {
+    int bits = 0;
+    while(value != 0) {
+        bits++;
+        value >>= 1;
+    }
+    return bits;
+}
+
+int hw_unpacking_count(int width, int elements_per_cycle, int dec_data_width) {
+    if(width == 0) {
+        return elements_per_cycle;
+    }
+    int fit = 1 << (bit_length(dec_data_width/width) - 1);
+    return std::min(elements_per_cycle, std::min(fit, HW_MAX_UNPACK_COUNT));
+}
+
+int64_t hw_delta_cycles(const std::vector<int64_t>& bitwidth_counts, int elements_per_cycle, int dec_data_width) {
+    const int miniblock_size = BLOCK_SIZE/MINIBLOCKS_IN_BLOCK;
+    int64_t cycles = 0;
+    for(size_t width=0; width<bitwidth_counts.size(); width++) {
+        int count = hw_unpacking_count(width, elements_per_cycle, dec_data_width);
+        cycles += bitwidth_counts[width]*((miniblock_size + count - 1)/count);
+    }
+    return cycles;
+}
+
+int64_t hw_plain_cycles(int64_t num_values, int elements_per_cycle) {
+    return (num_values + elements_per_cycle - 1)/elements_per_cycle;
+}
+
+// The header is interpreted one byte per clock cycle after a single memory round trip, see V1MetadataInterpreter.vhd
+int64_t hw_page_header_cycles(int32_t metadata_size) {
+    return HW_PAGE_REQUEST_CYCLES + metadata_size;
+}
+
+// Segments are cut like FpgaReader::split_segments does, a segment ends with the first page that brings it to segment_size bytes
+int64_t hw_pipeline_fill_cycles(const std::vector<page_directory_entry>& pages, int64_t num_values, int32_t prim_width, int64_t segment_size) {
+    if(segment_size <= 0) {
+        segment_size = std::numeric_limits<int64_t>::max();
+    }
+
+    int64_t values = 0;
+    int64_t segment_bytes = 0;
+    int64_t segment_values = 0;
+    int64_t first_segment_bytes = -1;
+
+    for(const page_directory_entry& page : pages) {
+        if(values >= num_values) {
+            break;
+        }
+
+        int64_t page_values = std::min((int64_t) page.num_values, num_values - values);
+        values += page_values;
+        segment_bytes += page.metadata_size + page.compressed_size;
+        segment_values += page_values;
+
+        if((segment_bytes >= segment_size) && (values < num_values)) {
+            if(first_segment_bytes < 0) {
+                first_segment_bytes = segment_bytes;
+            }
+            segment_bytes = 0;
+            segment_values = 0;
+        }
+    }
+
+    // A column that fits in one segment is both the first and the last segment
+    if(first_segment_bytes < 0) {
+        first_segment_bytes = segment_bytes;
+    }
+
+    const double link_bytes_per_cycle = HW_LINK_GBPS*1e3/HW_CLOCK_MHZ;
+    return (int64_t) std::ceil((first_segment_bytes + segment_values*prim_width/8)/link_bytes_per_cycle);
+}
+
+int64_t hw_read_cycles(const std::vector<page_directory_entry>& pages, int64_t num_values, int32_t prim_width, int64_t segment_size, int64_t decode_cycles) {
+    int64_t cycles = decode_cycles;
+    for(const page_directory_entry& page : pages) {
+        cycles += hw_page_header_cycles(page.metadata_size);
+    }
+    return cycles + hw_pipeline_fill_cycles(pages, num_values, prim_width, segment_size);
+}
+
+}
@@ -0,0 +1,57 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "SWParquetReader.h"
+
+// Clock of the AWS F1 builds (clock recipe A1)
+#define HW_CLOCK_MHZ 250
+// Largest amount of deltas the BitUnpacker shifts out per cycle, the cap in round_down_pow2 in Delta.vhd
+#define HW_MAX_UNPACK_COUNT 32
+// Cycles between the read request for a page header and its data arriving in the MetadataInterpreter. An estimate for the
+// DDR behind the F1 shell, the interpreter issues the request only after the previous page has been handed off.
+#define HW_PAGE_REQUEST_CYCLES 100
+// Bandwidth of the copies between host and device memory in GB/s. An estimate for the PCIe link of the F1 shell.
+#define HW_LINK_GBPS 8
+
+namespace ptoa{
+
+/*
+ * Cycle counts of the decoding hardware in hardware/vhdl, for predicting its throughput on a file without running it.
+ * Only the stages that bound the throughput are modeled: the page header interpreter, which reads every header with a
+ * separate memory request and interprets it one byte per cycle, and the value decoders.
+ */
+
+// Deltas per cycle of the BitUnpacker for one miniblock, see unpacking_count in Delta.vhd
+int hw_unpacking_count(int width, int elements_per_cycle, int dec_data_width);
+
+// Cycles to unpack miniblocks, bitwidth_counts[w] holds the number of miniblocks of bit width w
+int64_t hw_delta_cycles(const std::vector<int64_t>& bitwidth_counts, int elements_per_cycle, int dec_data_width);
+
+int64_t hw_plain_cycles(int64_t num_values, int elements_per_cycle);
+
+// Cycles the MetadataInterpreter spends on the header of a single page
+int64_t hw_page_header_cycles(int32_t metadata_size);
+
+// Cycles in which a read pipelined in segments of segment_size bytes can't overlap the copies with decoding: the copy of the
+// first segment to the device and the copy of the values of the last segment back. Segments consist of whole pages, so pages
+// larger than a segment make these longer. A segment_size of 0 copies the whole column at once, like FpgaReader does.
+int64_t hw_pipeline_fill_cycles(const std::vector<page_directory_entry>& pages, int64_t num_values, int32_t prim_width, int64_t segment_size);
+
+// Cycles of a whole read of the first num_values values in pages, given the cycles of the value decoders
+int64_t hw_read_cycles(const std::vector<page_directory_entry>& pages, int64_t num_values, int32_t prim_width, int64_t segment_size, int64_t decode_cycles);
+
+}
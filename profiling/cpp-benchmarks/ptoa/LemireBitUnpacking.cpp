@@ -3104,6 +3104,41 @@ void fastunpack(const vector<uint> & data, vector<uint> & out, const uint bit) {
 		}
 }
 
+// Pack 32 values of bit bits each into bit words, in the same layout fastunpack expects.
+// Instantiated per bit width, so the loop is fully unrolled with constant shifts and word positions, like the generated
+// unpacking functions. Bits above bit are masked off.
+template<uint bit>
+void __fastpack(const uint *  __restrict__ in, uint *  __restrict__  out) {
+    const uint mask = (bit == 32) ? 0xFFFFFFFF : (1U << bit) - 1;
+    uint64_t word = 0;
+    uint word_bits = 0;
+
+#pragma GCC unroll 32
+    for(int i=0; i<32; i++) {
+        word |= (uint64_t) (in[i] & mask) << word_bits;
+        word_bits += bit;
+        if(word_bits >= 32) {
+            *(out++) = (uint) word;
+            word >>= 32;
+            word_bits -= 32;
+        }
+    }
+}
+
+#define FASTPACK_CASE(bit) case bit: __fastpack<bit>(in, out); break;
+
+void fastpack(const uint *  __restrict__ in, uint *  __restrict__  out, const uint bit) {
+    switch(bit) {
+        FASTPACK_CASE(1) FASTPACK_CASE(2) FASTPACK_CASE(3) FASTPACK_CASE(4) FASTPACK_CASE(5) FASTPACK_CASE(6) FASTPACK_CASE(7) FASTPACK_CASE(8)
+        FASTPACK_CASE(9) FASTPACK_CASE(10) FASTPACK_CASE(11) FASTPACK_CASE(12) FASTPACK_CASE(13) FASTPACK_CASE(14) FASTPACK_CASE(15) FASTPACK_CASE(16)
+        FASTPACK_CASE(17) FASTPACK_CASE(18) FASTPACK_CASE(19) FASTPACK_CASE(20) FASTPACK_CASE(21) FASTPACK_CASE(22) FASTPACK_CASE(23) FASTPACK_CASE(24)
+        FASTPACK_CASE(25) FASTPACK_CASE(26) FASTPACK_CASE(27) FASTPACK_CASE(28) FASTPACK_CASE(29) FASTPACK_CASE(30) FASTPACK_CASE(31) FASTPACK_CASE(32)
+        default:
+            // Zero width miniblocks take up no space
+            break;
+    }
+}
+
 //Bit unpacking functions for int64
 
 void __int64fastunpack4(const uint64_t *  __restrict__ in, uint64_t *  __restrict__  out) {
@@ -9211,3 +9246,51 @@ void int64fastunpack(const uint64_t *  __restrict__ in, uint64_t *  __restrict__
     }
 }
 
+// Pack 32 values of bit bits each into the layout int64fastunpack expects. Writes exactly 4*bit bytes: at odd bit widths the
+// last word is only half written, so packed miniblocks can follow each other without padding.
+template<uint bit>
+void __int64fastpack(const uint64_t *  __restrict__ in, uint64_t *  __restrict__  out) {
+    const uint64_t mask = (bit == 64) ? 0xFFFFFFFFFFFFFFFF : (1ULL << bit) - 1;
+    uint64_t word = 0;
+    uint word_bits = 0;
+
+#pragma GCC unroll 32
+    for(int i=0; i<32; i++) {
+        uint64_t value = in[i] & mask;
+        word |= value << word_bits;
+        if(word_bits + bit >= 64) {
+            *(out++) = word;
+            // The bits of value that did not fit in the word, shifting by 64 is undefined
+            word = (word_bits == 0) ? 0 : value >> (64 - word_bits);
+            word_bits = word_bits + bit - 64;
+        } else {
+            word_bits += bit;
+        }
+    }
+
+    if(word_bits > 0) {
+        uint32_t half_word = (uint32_t) word;
+        memcpy(out, &half_word, sizeof(half_word));
+    }
+}
+
+#define INT64FASTPACK_CASE(bit) case bit: __int64fastpack<bit>(in, out); break;
+
+void int64fastpack(const uint64_t *  __restrict__ in, uint64_t *  __restrict__  out, const uint bit) {
+    switch(bit) {
+        INT64FASTPACK_CASE(1) INT64FASTPACK_CASE(2) INT64FASTPACK_CASE(3) INT64FASTPACK_CASE(4) INT64FASTPACK_CASE(5) INT64FASTPACK_CASE(6)
+        INT64FASTPACK_CASE(7) INT64FASTPACK_CASE(8) INT64FASTPACK_CASE(9) INT64FASTPACK_CASE(10) INT64FASTPACK_CASE(11) INT64FASTPACK_CASE(12)
+        INT64FASTPACK_CASE(13) INT64FASTPACK_CASE(14) INT64FASTPACK_CASE(15) INT64FASTPACK_CASE(16) INT64FASTPACK_CASE(17) INT64FASTPACK_CASE(18)
+        INT64FASTPACK_CASE(19) INT64FASTPACK_CASE(20) INT64FASTPACK_CASE(21) INT64FASTPACK_CASE(22) INT64FASTPACK_CASE(23) INT64FASTPACK_CASE(24)
+        INT64FASTPACK_CASE(25) INT64FASTPACK_CASE(26) INT64FASTPACK_CASE(27) INT64FASTPACK_CASE(28) INT64FASTPACK_CASE(29) INT64FASTPACK_CASE(30)
+        INT64FASTPACK_CASE(31) INT64FASTPACK_CASE(32) INT64FASTPACK_CASE(33) INT64FASTPACK_CASE(34) INT64FASTPACK_CASE(35) INT64FASTPACK_CASE(36)
+        INT64FASTPACK_CASE(37) INT64FASTPACK_CASE(38) INT64FASTPACK_CASE(39) INT64FASTPACK_CASE(40) INT64FASTPACK_CASE(41) INT64FASTPACK_CASE(42)
+        INT64FASTPACK_CASE(43) INT64FASTPACK_CASE(44) INT64FASTPACK_CASE(45) INT64FASTPACK_CASE(46) INT64FASTPACK_CASE(47) INT64FASTPACK_CASE(48)
+        INT64FASTPACK_CASE(49) INT64FASTPACK_CASE(50) INT64FASTPACK_CASE(51) INT64FASTPACK_CASE(52) INT64FASTPACK_CASE(53) INT64FASTPACK_CASE(54)
+        INT64FASTPACK_CASE(55) INT64FASTPACK_CASE(56) INT64FASTPACK_CASE(57) INT64FASTPACK_CASE(58) INT64FASTPACK_CASE(59) INT64FASTPACK_CASE(60)
+        INT64FASTPACK_CASE(61) INT64FASTPACK_CASE(62) INT64FASTPACK_CASE(63) INT64FASTPACK_CASE(64)
+        default:
+            // Zero width miniblocks take up no space
+            break;
+    }
+}
@@ -2,4 +2,5 @@
 
 void fastunpack(const uint *  __restrict__ in, uint *  __restrict__  out, const uint bit);
 void int64fastunpack(const uint64_t *  __restrict__ in, uint64_t *  __restrict__  out, const uint bit);
-void fastpack(const uint *  __restrict__ in, uint *  __restrict__  out, const uint bit);
\ No newline at end of file
+void fastpack(const uint *  __restrict__ in, uint *  __restrict__  out, const uint bit);
+void int64fastpack(const uint64_t *  __restrict__ in, uint64_t *  __restrict__  out, const uint bit);
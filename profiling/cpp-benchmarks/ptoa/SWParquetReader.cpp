@@ -18,27 +18,115 @@
 #include <map>
 #include <bitset>
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "SWParquetReader.h"
+#include "StageProfiler.h"
+#include "trace.h"
 #include "ptoa.h"
 
 namespace ptoa {
 
-// Load Parquet file into memory
-SWParquetReader::SWParquetReader(std::string file_path) {
-    std::ifstream parquet_file(file_path, std::ios::binary);
-    
-    parquet_file.seekg(0, parquet_file.end);
-    file_size = parquet_file.tellg();
-    parquet_file.seekg(0, parquet_file.beg);
+// Buffer that owns the memory the Parquet file was loaded or mapped into
+class FileBuffer : public arrow::Buffer {
+  public:
+    FileBuffer(uint8_t* data, int64_t size, bool mapped) : arrow::Buffer(data, size), mapped(mapped) {}
+    ~FileBuffer() {
+        if(mapped) {
+            munmap((void*) data(), size());
+        } else {
+            free((void*) data());
+        }
+    }
+
+  private:
+    bool mapped;
+};
+
+// Allocates size bytes with the default Arrow memory pool
+status allocate_buffer(int64_t size, std::shared_ptr<arrow::Buffer>* buffer) {
+    arrow::Result<std::unique_ptr<arrow::Buffer>> result = arrow::AllocateBuffer(size);
+    if(!result.ok()) {
+        std::cerr << "[ERROR] Could not allocate a buffer of " << size << " bytes" << std::endl;
+        return status::FAIL;
+    }
+    *buffer = std::move(result).ValueOrDie();
+    return status::OK;
+}
+
+// Reader without a file in memory. Only decode_page and read_page_size can be used, on pages that are stored elsewhere.
+SWParquetReader::SWParquetReader() {
+    parquet_data = nullptr;
+    file_size = 0;
+    memory_mapped = false;
+    page_directory_ready = false;
+}
+
+// Load Parquet file into memory, or map it into memory if memory_map is set
+SWParquetReader::SWParquetReader(std::string file_path, bool memory_map) {
+    parquet_data = nullptr;
+    file_size = 0;
+    memory_mapped = false;
+    page_directory_ready = false;
+
+    TraceSpan load_span("load file", "io");
+
+    if(memory_map) {
+        int fd = open(file_path.c_str(), O_RDONLY);
+        struct stat file_stat;
+
+        if((fd < 0) || (fstat(fd, &file_stat) != 0)) {
+            std::cerr << "[ERROR] Could not open " << file_path << std::endl;
+            if(fd >= 0) {
+                close(fd);
+            }
+            return;
+        }
+        file_size = file_stat.st_size;
+
+        void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if(mapping == MAP_FAILED) {
+            std::cerr << "[ERROR] Could not map " << file_path << " into memory" << std::endl;
+            file_size = 0;
+            return;
+        }
+        parquet_data = (uint8_t*) mapping;
+        memory_mapped = true;
+    } else {
+        std::ifstream parquet_file(file_path, std::ios::binary);
+
+        parquet_file.seekg(0, parquet_file.end);
+        file_size = parquet_file.tellg();
+        parquet_file.seekg(0, parquet_file.beg);
 
-    parquet_data = (uint8_t*) malloc(file_size);
-    parquet_file.read((char*) parquet_data, file_size);
+        parquet_data = (uint8_t*) malloc(file_size);
+        parquet_file.read((char*) parquet_data, file_size);
 
-    parquet_file.close();
+        parquet_file.close();
+    }
+
+    file_buffer = std::make_shared<FileBuffer>(parquet_data, file_size, memory_map);
+}
 
+// Read from data that is already in memory, like the pages in the device memory of the emulation platform in software/cpp/emu.
+// File offsets are relative to the start of data.
+SWParquetReader::SWParquetReader(std::shared_ptr<arrow::Buffer> data) {
+    parquet_data = (uint8_t*) data->data();
+    file_size = data->size();
+    memory_mapped = false;
+    page_directory_ready = false;
+    file_buffer = data;
 }
 
-status SWParquetReader::read_prim(int32_t prim_width, int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, encoding enc) {
+status SWParquetReader::read_prim(int32_t prim_width, int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, encoding enc) {
+    PTOA_STAGE_REPORT("read_prim");
+    TraceSpan read_span("read_prim", "decode");
+
     if(enc == encoding::PLAIN){
         return read_prim_plain(prim_width, num_values, file_offset, prim_array);
     } else if((enc == encoding::DELTA) && (prim_width == 32)){
@@ -51,7 +139,10 @@ status SWParquetReader::read_prim(int32_t prim_width, int64_t num_values, int32_
     }
 }
 
-status SWParquetReader::read_prim(int32_t prim_width, int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer, encoding enc) {
+status SWParquetReader::read_prim(int32_t prim_width, int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer, encoding enc) {
+    PTOA_STAGE_REPORT("read_prim");
+    TraceSpan read_span("read_prim", "decode");
+
     if(enc == encoding::PLAIN){
         return read_prim_plain(prim_width, num_values, file_offset, prim_array, arr_buffer);
     } else if((enc == encoding::DELTA) && (prim_width == 32)){
@@ -64,7 +155,62 @@ status SWParquetReader::read_prim(int32_t prim_width, int64_t num_values, int32_
     }
 }
 
-status SWParquetReader::read_string(int64_t num_strings, int64_t num_chars, int32_t file_offset, std::shared_ptr<arrow::StringArray>* string_array, encoding enc) {
+status SWParquetReader::read_string(int64_t num_strings, int64_t num_chars, int64_t file_offset, std::shared_ptr<arrow::StringArray>* string_array, encoding enc) {
+    PTOA_STAGE_REPORT("read_string");
+    TraceSpan read_span("read_string", "decode");
+
+    if(enc == encoding::DELTA_LENGTH){
+        return read_string_delta_length(num_strings, num_chars, file_offset, string_array);
+    } else{
+        std::cout<<"Unsupported encoding selected" << std::endl;
+        return status::FAIL;
+    }
+}
+status SWParquetReader::read_string(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::StringArray>* string_array, std::shared_ptr<arrow::Buffer> off_buffer, std::shared_ptr<arrow::Buffer> val_buffer, encoding enc) {
+    PTOA_STAGE_REPORT("read_string");
+    TraceSpan read_span("read_string", "decode");
+
+    if(enc == encoding::DELTA_LENGTH){
+        return read_string_delta_length(num_strings, file_offset, string_array, off_buffer, val_buffer);
+    } else{
+        std::cout<<"Unsupported encoding selected" << std::endl;
+        return status::FAIL;
+    }
+}
+
+// Read strings without copying their characters. Strings of up to STRING_VIEW_INLINE_SIZE characters are stored in the views buffer,
+// longer strings point into data_buffers, which are slices of the file in memory (one per page).
+status SWParquetReader::read_string_view(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::Buffer>* views, std::vector<std::shared_ptr<arrow::Buffer>>* data_buffers, encoding enc) {
+    PTOA_STAGE_REPORT("read_string_view");
+    TraceSpan read_span("read_string_view", "decode");
+
+    if(enc == encoding::DELTA_LENGTH){
+        return read_string_delta_length_view(num_strings, file_offset, views, data_buffers);
+    } else{
+        std::cout<<"Unsupported encoding selected" << std::endl;
+        return status::FAIL;
+    }
+}
+
+#if ARROW_VERSION_MAJOR >= 15
+status SWParquetReader::read_string_view(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::StringViewArray>* string_array, encoding enc) {
+    std::shared_ptr<arrow::Buffer> views;
+    std::vector<std::shared_ptr<arrow::Buffer>> data_buffers;
+
+    if(read_string_view(num_strings, file_offset, &views, &data_buffers, enc) != status::OK) {
+        return status::FAIL;
+    }
+
+    *string_array = std::make_shared<arrow::StringViewArray>(arrow::utf8_view(), num_strings, views, data_buffers);
+
+    return status::OK;
+}
+#endif
+
+status SWParquetReader::read_string(int64_t num_strings, int64_t num_chars, int64_t file_offset, std::shared_ptr<arrow::LargeStringArray>* string_array, encoding enc) {
+    PTOA_STAGE_REPORT("read_string");
+    TraceSpan read_span("read_string", "decode");
+
     if(enc == encoding::DELTA_LENGTH){
         return read_string_delta_length(num_strings, num_chars, file_offset, string_array);
     } else{
@@ -72,7 +218,11 @@ status SWParquetReader::read_string(int64_t num_strings, int64_t num_chars, int3
         return status::FAIL;
     }
 }
-status SWParquetReader::read_string(int64_t num_strings, int32_t file_offset, std::shared_ptr<arrow::StringArray>* string_array, std::shared_ptr<arrow::Buffer> off_buffer, std::shared_ptr<arrow::Buffer> val_buffer, encoding enc) {
+
+status SWParquetReader::read_string(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::LargeStringArray>* string_array, std::shared_ptr<arrow::Buffer> off_buffer, std::shared_ptr<arrow::Buffer> val_buffer, encoding enc) {
+    PTOA_STAGE_REPORT("read_string");
+    TraceSpan read_span("read_string", "decode");
+
     if(enc == encoding::DELTA_LENGTH){
         return read_string_delta_length(num_strings, file_offset, string_array, off_buffer, val_buffer);
     } else{
@@ -81,13 +231,69 @@ status SWParquetReader::read_string(int64_t num_strings, int32_t file_offset, st
     }
 }
 
+// Total size (header and data) of and number of values in the page pointed to by page_ptr.
+status SWParquetReader::read_page_size(const uint8_t* page_ptr, int32_t* page_size, int32_t* page_num_values) {
+    // Metadata reading variables
+    int32_t uncompressed_size;
+    int32_t compressed_size;
+    int32_t def_level_length;
+    int32_t rep_level_length;
+    int32_t metadata_size;
+
+    if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
+        return status::FAIL;
+    }
+
+    *page_size = metadata_size + compressed_size;
+
+    return status::OK;
+}
+
+// Decode the first values_to_read values of a single page pointed to by page_ptr into out. For DELTA_LENGTH pages only the
+// string lengths are decoded, as int32_t. The page can be located anywhere in memory, it doesn't have to be part of the file
+// loaded by this reader.
+status SWParquetReader::decode_page(int32_t prim_width, const uint8_t* page_ptr, int32_t values_to_read, uint8_t* out, encoding enc) {
+    // Metadata reading variables
+    int32_t uncompressed_size;
+    int32_t compressed_size;
+    int32_t page_num_values;
+    int32_t def_level_length;
+    int32_t rep_level_length;
+    int32_t metadata_size;
+
+    if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
+        std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
+        return status::FAIL;
+    }
+
+    page_ptr += metadata_size;
+    values_to_read = std::min(values_to_read, page_num_values);
+
+    if(enc == encoding::PLAIN){
+        std::memcpy((void*) out, (const void*) page_ptr, std::min((int64_t) compressed_size, (int64_t) values_to_read*prim_width/8));
+        return status::OK;
+    } else if((enc == encoding::DELTA) && (prim_width == 32)){
+        return decode_page_delta32(page_ptr, values_to_read, (int32_t*) out);
+    } else if((enc == encoding::DELTA) && (prim_width == 64)){
+        return decode_page_delta64(page_ptr, values_to_read, (int64_t*) out);
+    } else if(enc == encoding::DELTA_LENGTH){
+        const uint8_t* chars_ptr;
+        return decode_page_delta_length_lengths(page_ptr, page_num_values, values_to_read, (int32_t*) out, &chars_ptr);
+    } else{
+        std::cout<<"Unsupported encoding selected" << std::endl;
+        return status::FAIL;
+    }
+}
+
 
 // Read a number (set by num_values) of either 32 or 64 bit integers (set by prim_width) into prim_array.
 // File_offset is the byte offset in the Parquet file where the first in a contiguous list of Parquet pages is located.
-status SWParquetReader::read_prim_plain(int32_t prim_width, int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array) {
+status SWParquetReader::read_prim_plain(int32_t prim_width, int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array) {
     uint8_t* page_ptr = parquet_data;
     std::shared_ptr<arrow::Buffer> arr_buffer;
-    arrow::AllocateBuffer(num_values*prim_width/8, &arr_buffer);
+    if(allocate_buffer(num_values*prim_width/8, &arr_buffer) != status::OK) {
+        return status::FAIL;
+    }
     uint8_t* arr_buf_ptr = arr_buffer->mutable_data();
 
     int64_t total_value_counter = 0;
@@ -102,17 +308,32 @@ status SWParquetReader::read_prim_plain(int32_t prim_width, int64_t num_values,
 
     page_ptr += file_offset;
 
+    page_lookahead lookahead;
+    init_lookahead(&lookahead, page_ptr);
+
     // Copy values from Parquet pages until max amount of values is reached
     while(total_value_counter < num_values){
-        if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
-            std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
-            std::cerr << page_ptr-parquet_data << std::endl;
-            return status::FAIL;
+        TraceSpan page_span("page", "decode");
+        prefetch_pages(&lookahead);
+
+        {
+            PTOA_STAGE(STAGE_METADATA);
+            if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
+                std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
+                std::cerr << page_ptr-parquet_data << std::endl;
+                return status::FAIL;
+            }
         }
+        PTOA_STAGE_COUNT(COUNT_PAGES, 1);
 
         page_ptr += metadata_size;
     
-        std::memcpy((void*) arr_buf_ptr, (const void*) page_ptr, std::min((int64_t) compressed_size, (num_values-total_value_counter)*prim_width/8));
+        {
+            PTOA_STAGE(STAGE_COPY);
+            int64_t bytes_to_copy = std::min((int64_t) compressed_size, (num_values-total_value_counter)*prim_width/8);
+            std::memcpy((void*) arr_buf_ptr, (const void*) page_ptr, bytes_to_copy);
+            PTOA_STAGE_COUNT(COUNT_BYTES_COPIED, bytes_to_copy);
+        }
     
         page_ptr += compressed_size;
         arr_buf_ptr += compressed_size;
@@ -134,7 +355,7 @@ status SWParquetReader::read_prim_plain(int32_t prim_width, int64_t num_values,
 }
 
 // Same as read_prim but with a pre-allocated buffer
-status SWParquetReader::read_prim_plain(int32_t prim_width, int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer) {
+status SWParquetReader::read_prim_plain(int32_t prim_width, int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer) {
     uint8_t* page_ptr = parquet_data;
     uint8_t* arr_buf_ptr = arr_buffer->mutable_data();
 
@@ -150,17 +371,32 @@ status SWParquetReader::read_prim_plain(int32_t prim_width, int64_t num_values,
 
     page_ptr += file_offset;
 
+    page_lookahead lookahead;
+    init_lookahead(&lookahead, page_ptr);
+
     // Copy values from Parquet pages until max amount of values is reached
     while(total_value_counter < num_values){
-        if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
-            std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
-            std::cerr << page_ptr-parquet_data << std::endl;
-            return status::FAIL;
+        TraceSpan page_span("page", "decode");
+        prefetch_pages(&lookahead);
+
+        {
+            PTOA_STAGE(STAGE_METADATA);
+            if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
+                std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
+                std::cerr << page_ptr-parquet_data << std::endl;
+                return status::FAIL;
+            }
         }
+        PTOA_STAGE_COUNT(COUNT_PAGES, 1);
 
         page_ptr += metadata_size;
     
-        std::memcpy((void*) arr_buf_ptr, (const void*) page_ptr, std::min((int64_t) compressed_size, (num_values-total_value_counter)*prim_width/8));
+        {
+            PTOA_STAGE(STAGE_COPY);
+            int64_t bytes_to_copy = std::min((int64_t) compressed_size, (num_values-total_value_counter)*prim_width/8);
+            std::memcpy((void*) arr_buf_ptr, (const void*) page_ptr, bytes_to_copy);
+            PTOA_STAGE_COUNT(COUNT_BYTES_COPIED, bytes_to_copy);
+        }
     
         page_ptr += compressed_size;
         arr_buf_ptr += compressed_size;
@@ -182,7 +418,7 @@ status SWParquetReader::read_prim_plain(int32_t prim_width, int64_t num_values,
 }
 
 // Count pages and provide information about their sizes starting with the page at file_offset
-status SWParquetReader::count_pages(int32_t file_offset) {
+status SWParquetReader::count_pages(int64_t file_offset) {
     uint8_t* page_ptr = parquet_data;
 
     // Metadata reading variables
@@ -196,7 +432,7 @@ status SWParquetReader::count_pages(int32_t file_offset) {
     page_ptr += file_offset;
 
     int32_t page_ctr = 0;
-    int32_t column_chunk_size = 0;
+    int64_t column_chunk_size = 0;
     std::map<int32_t, int32_t> size_map;
     std::map<int32_t, int32_t> value_map;
 
@@ -231,10 +467,10 @@ status SWParquetReader::count_pages(int32_t file_offset) {
     }
 
     //std::cout << "Page sizes: " << std::endl;
-    int total_page_size = 0;
+    int64_t total_page_size = 0;
     for(auto it = size_map.begin(); it != size_map.end(); it++){
         //std::cout << "    Size " << it->first << ": " << it->second <<std::endl;
-        total_page_size += ((it->first)*(it->second));
+        total_page_size += ((int64_t)(it->first)*(it->second));
     } 
     std::cout << "Amount of pages in file   : " << page_ctr << std::endl;
     std::cout << "Average page size in file : " << total_page_size/page_ctr << std::endl;
@@ -250,6 +486,170 @@ status SWParquetReader::count_pages(int32_t file_offset) {
 
 }
 
+// Walk all pages starting with the page at file_offset and store their locations and sizes.
+// read_* functions use the directory to prefetch upcoming pages without having to parse their headers first.
+// The directory is built once and is read-only afterwards, so reads on other threads can use it while or after it is built.
+// Calling this again with the same file_offset only waits for the first build, any other file_offset is rejected.
+status SWParquetReader::build_page_directory(int64_t file_offset) {
+    std::call_once(page_directory_once, [this, file_offset]() {
+        uint8_t* page_ptr = parquet_data + file_offset;
+
+        // Metadata reading variables
+        int32_t uncompressed_size;
+        int32_t compressed_size;
+        int32_t page_num_values;
+        int32_t def_level_length;
+        int32_t rep_level_length;
+        int32_t metadata_size;
+
+        page_directory_offset = file_offset;
+
+        // Read Parquet pages until either the end of the file is reached or a non PageHeader Thrift structure.
+        while((uint64_t)(page_ptr-parquet_data) < file_size){
+            if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
+                break;
+            }
+
+            page_directory_entry entry;
+            entry.offset = page_ptr-parquet_data;
+            entry.metadata_size = metadata_size;
+            entry.compressed_size = compressed_size;
+            entry.num_values = page_num_values;
+            page_directory.push_back(entry);
+
+            page_ptr += metadata_size + compressed_size;
+        }
+
+        // Publishes the finished directory to init_lookahead on other threads
+        page_directory_ready.store(!page_directory.empty(), std::memory_order_release);
+    });
+
+    if(file_offset != page_directory_offset) {
+        std::cerr << "[ERROR] Page directory was already built for file offset " << page_directory_offset << std::endl;
+        return status::FAIL;
+    }
+
+    if(page_directory.empty()) {
+        std::cerr << "[ERROR] No Parquet pages found at file offset " << file_offset << std::endl;
+        return status::FAIL;
+    }
+
+    return status::OK;
+}
+
+// Prepare the lookahead prefetcher for a walk through the pages starting at page_ptr.
+// If a page directory containing page_ptr has been built it is used instead of scanning the page headers.
+void SWParquetReader::init_lookahead(page_lookahead* lookahead, const uint8_t* page_ptr) {
+    lookahead->scan_ptr = page_ptr;
+    lookahead->pages_ahead = 0;
+    lookahead->exhausted = false;
+    lookahead->use_directory = false;
+    lookahead->primed = false;
+    lookahead->directory_index = 0;
+    lookahead->advised_end = page_ptr;
+
+    // A directory that is still being built on another thread is not used
+    if(!page_directory_ready.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    int64_t offset = page_ptr-parquet_data;
+    auto it = std::lower_bound(page_directory.begin(), page_directory.end(), offset,
+                               [](const page_directory_entry& entry, int64_t value) {return entry.offset < value;});
+
+    if((it != page_directory.end()) && (it->offset == offset)) {
+        lookahead->use_directory = true;
+        lookahead->directory_index = it-page_directory.begin();
+    }
+}
+
+// Called once at the start of every page in a read loop. Makes sure the headers and the first cache lines of the
+// payloads of the next PREFETCH_DISTANCE pages are on their way to the cache before we need them.
+void SWParquetReader::prefetch_pages(page_lookahead* lookahead) {
+    if(PREFETCH_DISTANCE == 0) {
+        return;
+    }
+
+    // With a page directory the location of every upcoming page is known, so we only have to issue the prefetch
+    // for the page that just entered the lookahead window.
+    if(lookahead->use_directory) {
+        size_t first_index = lookahead->primed ? lookahead->directory_index + PREFETCH_DISTANCE : lookahead->directory_index + 1;
+        size_t last_index = std::min(lookahead->directory_index + PREFETCH_DISTANCE, page_directory.size() - 1);
+
+        for(size_t i = first_index; i <= last_index; i++) {
+            prefetch_page(lookahead, parquet_data + page_directory[i].offset, page_directory[i].metadata_size, page_directory[i].compressed_size);
+        }
+
+        lookahead->directory_index++;
+        lookahead->primed = true;
+        return;
+    }
+
+    // Without a directory we run a header scan ahead of the decoder. pages_ahead counts the pages from the current
+    // page onwards that the scan has already passed. A header is only parsed after it has been prefetched, in steady state
+    // one call before, so the scan doesn't wait on the chain of header loads. While the window fills up a second header is
+    // parsed per call, so the first call doesn't parse the whole window at once.
+    if(lookahead->pages_ahead > 0) {
+        lookahead->pages_ahead--;
+    }
+
+    // Metadata reading variables
+    int32_t uncompressed_size;
+    int32_t compressed_size;
+    int32_t page_num_values;
+    int32_t def_level_length;
+    int32_t rep_level_length;
+    int32_t metadata_size;
+
+    int headers_to_parse = lookahead->pages_ahead < PREFETCH_DISTANCE ? 2 : 1;
+    while(!lookahead->exhausted && (lookahead->pages_ahead <= PREFETCH_DISTANCE) && (headers_to_parse-- > 0)) {
+        if(((uint64_t)(lookahead->scan_ptr-parquet_data) >= file_size) ||
+           (read_metadata(lookahead->scan_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK)) {
+            lookahead->exhausted = true;
+            break;
+        }
+
+        prefetch_page(lookahead, lookahead->scan_ptr, metadata_size, compressed_size);
+
+        lookahead->scan_ptr += metadata_size + compressed_size;
+        lookahead->pages_ahead++;
+
+        // Start loading the next header, the one the next iteration or call parses
+        if((uint64_t)(lookahead->scan_ptr-parquet_data) < file_size) {
+            __builtin_prefetch(lookahead->scan_ptr, 0, 3);
+            __builtin_prefetch(lookahead->scan_ptr + CACHE_LINE_SIZE, 0, 3);
+        }
+    }
+}
+
+// Prefetch the header and the first PREFETCH_PAYLOAD_LINES cache lines of the payload of the page at page_ptr.
+void SWParquetReader::prefetch_page(page_lookahead* lookahead, const uint8_t* page_ptr, int32_t metadata_size, int32_t compressed_size) {
+    const uint8_t* end_ptr = std::min(page_ptr + metadata_size + compressed_size, (const uint8_t*) parquet_data + file_size);
+    if(memory_mapped) {
+        advise_pages(lookahead, end_ptr);
+    }
+    const uint8_t* prefetch_end_ptr = std::min(page_ptr + metadata_size + PREFETCH_PAYLOAD_LINES*CACHE_LINE_SIZE, end_ptr);
+
+    for(const uint8_t* line_ptr = page_ptr; line_ptr < prefetch_end_ptr; line_ptr += CACHE_LINE_SIZE) {
+        __builtin_prefetch(line_ptr, 0, 3);
+    }
+}
+
+// __builtin_prefetch is dropped for the pages of a mapped file that are not resident, so the kernel is asked to read them in
+// ahead of the decoder, PREFETCH_ADVISE_SIZE bytes at a time to keep the number of system calls down.
+void SWParquetReader::advise_pages(page_lookahead* lookahead, const uint8_t* end_ptr) {
+    if(end_ptr <= lookahead->advised_end) {
+        return;
+    }
+
+    static const uintptr_t page_mask = ~((uintptr_t) sysconf(_SC_PAGESIZE) - 1);
+    const uint8_t* start_ptr = (const uint8_t*) ((uintptr_t) lookahead->advised_end & page_mask);
+    const uint8_t* advise_end = std::min(std::max(end_ptr, lookahead->advised_end + PREFETCH_ADVISE_SIZE), (const uint8_t*) parquet_data + file_size);
+
+    madvise((void*) start_ptr, advise_end - start_ptr, MADV_WILLNEED);
+    lookahead->advised_end = advise_end;
+}
+
 // Decodes variable length integer pointed to by input and stores it in decoded_int. Returns length of variable length integer in bytes.
 int SWParquetReader::decode_varint32(const uint8_t* input, int32_t* decoded_int, bool zigzag) {
     int32_t result = 0;
@@ -293,7 +693,7 @@ int SWParquetReader::decode_varint64(const uint8_t* input, int64_t* decoded_int,
     return i+1;
 }
 
-status SWParquetReader::inspect_metadata(int32_t file_offset) {
+status SWParquetReader::inspect_metadata(int64_t file_offset) {
     // Metadata reading variables
     int32_t uncompressed_size;
     int32_t compressed_size;
@@ -14,9 +14,14 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
+#include <mutex>
+#include <atomic>
 
 #include <arrow/api.h>
 #include <arrow/io/api.h>
+#include <arrow/util/config.h>
+#include <parquet/metadata.h>
 #include <parquet/properties.h>
 #include <parquet/types.h>
 
@@ -25,23 +30,110 @@
 #define BLOCK_SIZE 128
 #define MINIBLOCKS_IN_BLOCK 4
 
+// Software prefetching of upcoming pages. Set PREFETCH_DISTANCE to 0 to disable.
+#ifndef PREFETCH_DISTANCE
+#define PREFETCH_DISTANCE 4
+#endif
+#define PREFETCH_PAYLOAD_LINES 4
+#define CACHE_LINE_SIZE 64
+// Bytes of a memory mapped file that are advised to be read in at once, ahead of the prefetched pages
+#ifndef PREFETCH_ADVISE_SIZE
+#define PREFETCH_ADVISE_SIZE (1 << 20)
+#endif
+
+// Arrow Utf8View layout: a 4 byte length followed by either the string itself (if it fits in 12 bytes) or
+// a 4 byte prefix, the index of the data buffer holding the string and the offset of the string in that buffer
+#define STRING_VIEW_SIZE 16
+#define STRING_VIEW_INLINE_SIZE 12
+
+// Relative cost of decoding one compressed byte per encoding, used to balance column chunks over threads in read_record_batch
+#define DECODE_COST_PLAIN 1
+#define DECODE_COST_DELTA 8
+#define DECODE_COST_DELTA_LENGTH 3
+
 namespace ptoa{
 
+// Location and size of a single page in a column chunk, as found by build_page_directory
+struct page_directory_entry {
+    int64_t offset;
+    int32_t metadata_size;
+    int32_t compressed_size;
+    int32_t num_values;
+};
+
+// Min_delta and bit widths of a single DELTA_BINARY_PACKED block, as found by inspect_delta_page
+struct delta_block_info {
+    int64_t min_delta;
+    uint8_t bitwidths[MINIBLOCKS_IN_BLOCK];
+    // Miniblocks without any values at the end of a page are not stored
+    int32_t num_miniblocks;
+};
+
+// Allocates a buffer from the default memory pool, with the Result API that the host runtime in software/cpp/ptoa also builds with
+status allocate_buffer(int64_t size, std::shared_ptr<arrow::Buffer>* buffer);
+
 /**
  * Class that implements as fast as possible Parquet reading functionality equivalent to that of the hardware.
  */
 class SWParquetReader {
   public:
-    SWParquetReader(std::string file_path);
-    ~SWParquetReader(){free(parquet_data);}
-    status read_prim(int32_t prim_width, int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, encoding enc);
-    status read_prim(int32_t prim_width, int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer, encoding enc);
-    status read_string(int64_t num_strings, int64_t num_chars, int32_t file_offset, std::shared_ptr<arrow::StringArray>* string_array, encoding enc);
-    status read_string(int64_t num_strings, int32_t file_offset, std::shared_ptr<arrow::StringArray>* string_array, std::shared_ptr<arrow::Buffer> off_buffer , std::shared_ptr<arrow::Buffer> val_buffer, encoding enc);
-    status inspect_metadata(int32_t file_offset);
-    status count_pages(int32_t file_offset);
+    SWParquetReader();
+    SWParquetReader(std::string file_path, bool memory_map = false);
+    SWParquetReader(std::shared_ptr<arrow::Buffer> data);
+    status read_prim(int32_t prim_width, int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, encoding enc);
+    status read_prim(int32_t prim_width, int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer, encoding enc);
+    status read_string(int64_t num_strings, int64_t num_chars, int64_t file_offset, std::shared_ptr<arrow::StringArray>* string_array, encoding enc);
+    status read_string(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::StringArray>* string_array, std::shared_ptr<arrow::Buffer> off_buffer , std::shared_ptr<arrow::Buffer> val_buffer, encoding enc);
+    status read_string(int64_t num_strings, int64_t num_chars, int64_t file_offset, std::shared_ptr<arrow::LargeStringArray>* string_array, encoding enc);
+    status read_string(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::LargeStringArray>* string_array, std::shared_ptr<arrow::Buffer> off_buffer , std::shared_ptr<arrow::Buffer> val_buffer, encoding enc);
+    status read_string_view(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::Buffer>* views, std::vector<std::shared_ptr<arrow::Buffer>>* data_buffers, encoding enc);
+#if ARROW_VERSION_MAJOR >= 15
+    status read_string_view(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::StringViewArray>* string_array, encoding enc);
+#endif
+    status read_record_batch(int row_group, const std::vector<int>& column_indices, std::shared_ptr<arrow::RecordBatch>* record_batch, int num_threads);
+    status inspect_metadata(int64_t file_offset);
+    status count_pages(int64_t file_offset);
+    status read_page_size(const uint8_t* page_ptr, int32_t* page_size, int32_t* page_num_values);
+    status decode_page(int32_t prim_width, const uint8_t* page_ptr, int32_t values_to_read, uint8_t* out, encoding enc);
+    status inspect_delta_page(int32_t prim_width, const uint8_t* page_ptr, std::vector<delta_block_info>* blocks, int32_t* page_num_values, const uint8_t** end_ptr);
+    status build_page_directory(int64_t file_offset);
+    // Only valid after build_page_directory returned status::OK
+    const std::vector<page_directory_entry>& get_page_directory() const {return page_directory;}
+    const uint8_t* get_file_data() const {return parquet_data;}
+    size_t get_file_size() const {return file_size;}
 
   private:
+    // A column chunk to be decoded by read_record_batch
+    struct column_task {
+        int64_t file_offset;
+        int64_t num_values;
+        int64_t compressed_size;
+        int64_t uncompressed_size;
+        int32_t prim_width;
+        bool is_string;
+        encoding enc;
+        int64_t cost;
+    };
+
+    status read_column_task(const column_task& task, std::shared_ptr<arrow::Array>* array);
+
+    // State of the lookahead prefetcher while walking through the pages of a column chunk
+    struct page_lookahead {
+        const uint8_t* scan_ptr;
+        int32_t pages_ahead;
+        bool exhausted;
+        bool use_directory;
+        bool primed;
+        size_t directory_index;
+        // End of the part of a memory mapped file that has been advised to be read in
+        const uint8_t* advised_end;
+    };
+
+    void init_lookahead(page_lookahead* lookahead, const uint8_t* page_ptr);
+    void prefetch_pages(page_lookahead* lookahead);
+    void prefetch_page(page_lookahead* lookahead, const uint8_t* page_ptr, int32_t metadata_size, int32_t compressed_size);
+    void advise_pages(page_lookahead* lookahead, const uint8_t* end_ptr);
+
   	status read_metadata(const uint8_t* metadata, int32_t* uncompressed_size, int32_t* compressed_size, int32_t* num_values, int32_t* def_level_length, int32_t* rep_level_length, int32_t* metadata_size);
   	status read_metadata_v2(const uint8_t* metadata, int32_t* uncompressed_size, int32_t* compressed_size, int32_t* num_values, int32_t* def_level_length, int32_t* rep_level_length, int32_t* metadata_size);
     status read_delta_header32(const uint8_t* header, int32_t* first_value, int32_t* header_size);
@@ -50,14 +142,23 @@ class SWParquetReader {
     status read_block_header64(const uint8_t* header, int64_t* min_delta, uint8_t* bitwidths, int32_t* header_size);
 
     
-    status read_prim_plain(int32_t prim_width, int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array);
-    status read_prim_plain(int32_t prim_width, int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer);
-    status read_prim_delta32(int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array);
-    status read_prim_delta32(int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer);
-    status read_prim_delta64(int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array);
-    status read_prim_delta64(int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer);
-    status read_string_delta_length(int64_t num_strings, int64_t num_chars, int32_t file_offset, std::shared_ptr<arrow::StringArray>* string_array);
-    status read_string_delta_length(int64_t num_strings, int32_t file_offset, std::shared_ptr<arrow::StringArray>* string_array, std::shared_ptr<arrow::Buffer> off_buffer, std::shared_ptr<arrow::Buffer> val_buffer);
+    status read_prim_plain(int32_t prim_width, int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array);
+    status read_prim_plain(int32_t prim_width, int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer);
+    status read_prim_delta32(int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array);
+    status read_prim_delta32(int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer);
+    status read_prim_delta64(int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array);
+    status read_prim_delta64(int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer);
+    status read_string_delta_length(int64_t num_strings, int64_t num_chars, int64_t file_offset, std::shared_ptr<arrow::StringArray>* string_array);
+    status read_string_delta_length(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::StringArray>* string_array, std::shared_ptr<arrow::Buffer> off_buffer, std::shared_ptr<arrow::Buffer> val_buffer);
+    status read_string_delta_length(int64_t num_strings, int64_t num_chars, int64_t file_offset, std::shared_ptr<arrow::LargeStringArray>* string_array);
+    status read_string_delta_length(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::LargeStringArray>* string_array, std::shared_ptr<arrow::Buffer> off_buffer, std::shared_ptr<arrow::Buffer> val_buffer);
+    status read_string_delta_length_view(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::Buffer>* views, std::vector<std::shared_ptr<arrow::Buffer>>* data_buffers);
+    template<typename offset_type>
+    status decode_string_delta_length(int64_t num_strings, int64_t file_offset, offset_type* off_buf_ptr, uint8_t* val_buf_ptr);
+
+    status decode_page_delta32(const uint8_t* block_ptr, int32_t page_values_to_read, int32_t* out);
+    status decode_page_delta64(const uint8_t* block_ptr, int32_t page_values_to_read, int64_t* out);
+    status decode_page_delta_length_lengths(const uint8_t* block_ptr, int32_t page_num_values, int32_t page_values_to_read, int32_t* lengths, const uint8_t** chars_ptr);
 
 
     int decode_varint32(const uint8_t* input, int32_t* result, bool zigzag);
@@ -65,6 +166,17 @@ class SWParquetReader {
 
   	uint8_t* parquet_data;
   	size_t file_size;
+    bool memory_mapped;
+    // Owns parquet_data. Slices of it are handed out by read_string_view, so the file stays in memory as long as they are in use.
+    std::shared_ptr<arrow::Buffer> file_buffer;
+    // Filled once by build_page_directory, read-only afterwards
+    std::vector<page_directory_entry> page_directory;
+    int64_t page_directory_offset;
+    std::once_flag page_directory_once;
+    std::atomic<bool> page_directory_ready;
+    // Footer of the file, parsed by the first read_record_batch. Stays nullptr if the footer could not be parsed.
+    std::shared_ptr<parquet::FileMetaData> file_metadata;
+    std::once_flag file_metadata_once;
 };
 
 }
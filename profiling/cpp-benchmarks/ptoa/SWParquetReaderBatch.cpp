@@ -0,0 +1,229 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <atomic>
+#include <thread>
+#include <mutex>
+
+#include <parquet/exception.h>
+#include <parquet/file_reader.h>
+#include <parquet/metadata.h>
+#include <parquet/schema.h>
+
+#include "SWParquetReader.h"
+#include "trace.h"
+#include "ptoa.h"
+
+namespace ptoa {
+
+// Read the column chunks of row group row_group listed in column_indices into one RecordBatch, decoding up to num_threads chunks concurrently.
+// The locations of the column chunks are taken from the file footer, which is parsed once by the first call. Only uncompressed, required
+// INT32 and INT64 columns in PLAIN or DELTA_BINARY_PACKED and BYTE_ARRAY columns in DELTA_LENGTH_BYTE_ARRAY are supported.
+// Chunks that don't meet this are rejected before anything is decoded.
+status SWParquetReader::read_record_batch(int row_group, const std::vector<int>& column_indices, std::shared_ptr<arrow::RecordBatch>* record_batch, int num_threads) {
+    if(file_buffer == nullptr) {
+        std::cerr << "[ERROR] No Parquet file loaded" << std::endl;
+        return status::FAIL;
+    }
+
+    // Several threads may call read_record_batch on the same reader, only the first one parses the footer
+    std::call_once(file_metadata_once, [this]() {
+        try {
+            auto file_reader = parquet::ParquetFileReader::Open(std::make_shared<arrow::io::BufferReader>(file_buffer));
+            file_metadata = file_reader->metadata();
+        } catch(const parquet::ParquetException& e) {
+            std::cerr << "[ERROR] Could not read Parquet footer: " << e.what() << std::endl;
+        }
+    });
+    if(file_metadata == nullptr) {
+        return status::FAIL;
+    }
+    const std::shared_ptr<parquet::FileMetaData>& metadata = file_metadata;
+
+    if((row_group < 0) || (row_group >= metadata->num_row_groups())) {
+        std::cerr << "[ERROR] Row group " << row_group << " does not exist" << std::endl;
+        return status::FAIL;
+    }
+    auto row_group_metadata = metadata->RowGroup(row_group);
+
+    std::vector<column_task> tasks;
+    std::vector<std::shared_ptr<arrow::Field>> fields;
+
+    for(int column : column_indices) {
+        if((column < 0) || (column >= row_group_metadata->num_columns())) {
+            std::cerr << "[ERROR] Column " << column << " does not exist" << std::endl;
+            return status::FAIL;
+        }
+
+        auto column_metadata = row_group_metadata->ColumnChunk(column);
+        const parquet::ColumnDescriptor* descriptor = metadata->schema()->Column(column);
+
+        if((descriptor->max_definition_level() > 0) || (descriptor->max_repetition_level() > 0)) {
+            std::cerr << "[ERROR] Column " << column << " is not a required column" << std::endl;
+            return status::FAIL;
+        }
+        if(column_metadata->has_dictionary_page()) {
+            std::cerr << "[ERROR] Column " << column << " is dictionary encoded" << std::endl;
+            return status::FAIL;
+        }
+        if(column_metadata->compression() != parquet::Compression::UNCOMPRESSED) {
+            std::cerr << "[ERROR] Column " << column << " is compressed" << std::endl;
+            return status::FAIL;
+        }
+
+        column_task task;
+        task.file_offset = column_metadata->data_page_offset();
+        task.num_values = column_metadata->num_values();
+        task.compressed_size = column_metadata->total_compressed_size();
+        task.uncompressed_size = column_metadata->total_uncompressed_size();
+        task.prim_width = 0;
+        task.is_string = false;
+
+        // RLE and BIT_PACKED only encode levels, any other encoding in the list is that of data pages. All data pages of a chunk
+        // have to share one encoding, the decoders don't switch between pages.
+        bool has_data_encoding = false;
+        for(parquet::Encoding::type column_encoding : column_metadata->encodings()) {
+            encoding data_encoding;
+            switch(column_encoding) {
+                case parquet::Encoding::RLE:
+                case parquet::Encoding::BIT_PACKED:
+                    continue;
+                case parquet::Encoding::PLAIN:
+                    data_encoding = encoding::PLAIN;
+                    break;
+                case parquet::Encoding::DELTA_BINARY_PACKED:
+                    data_encoding = encoding::DELTA;
+                    break;
+                case parquet::Encoding::DELTA_LENGTH_BYTE_ARRAY:
+                    data_encoding = encoding::DELTA_LENGTH;
+                    break;
+                default:
+                    std::cerr << "[ERROR] Column " << column << " has data pages in an unsupported encoding" << std::endl;
+                    return status::FAIL;
+            }
+
+            if(has_data_encoding && (data_encoding != task.enc)) {
+                std::cerr << "[ERROR] Column " << column << " has data pages in more than one encoding" << std::endl;
+                return status::FAIL;
+            }
+            task.enc = data_encoding;
+            has_data_encoding = true;
+        }
+        if(!has_data_encoding) {
+            std::cerr << "[ERROR] Column " << column << " does not list the encoding of its data pages" << std::endl;
+            return status::FAIL;
+        }
+
+        std::shared_ptr<arrow::DataType> type;
+        switch(column_metadata->type()) {
+            case parquet::Type::INT32:
+                task.prim_width = 32;
+                type = arrow::int32();
+                break;
+            case parquet::Type::INT64:
+                task.prim_width = 64;
+                type = arrow::int64();
+                break;
+            case parquet::Type::BYTE_ARRAY:
+                task.is_string = true;
+                type = arrow::utf8();
+                break;
+            default:
+                std::cerr << "[ERROR] Column " << column << " has an unsupported physical type" << std::endl;
+                return status::FAIL;
+        }
+
+        if(task.is_string && (task.enc != encoding::DELTA_LENGTH)) {
+            std::cerr << "[ERROR] Column " << column << " is a BYTE_ARRAY column that is not DELTA_LENGTH_BYTE_ARRAY encoded" << std::endl;
+            return status::FAIL;
+        }
+        if(!task.is_string && (task.enc == encoding::DELTA_LENGTH)) {
+            std::cerr << "[ERROR] Column " << column << " is an integer column that is DELTA_LENGTH_BYTE_ARRAY encoded" << std::endl;
+            return status::FAIL;
+        }
+
+        if(task.enc == encoding::DELTA) {
+            task.cost = task.compressed_size*DECODE_COST_DELTA;
+        } else if(task.enc == encoding::DELTA_LENGTH) {
+            task.cost = task.compressed_size*DECODE_COST_DELTA_LENGTH;
+        } else {
+            task.cost = task.compressed_size*DECODE_COST_PLAIN;
+        }
+
+        tasks.push_back(task);
+        fields.push_back(arrow::field(descriptor->name(), type, false));
+    }
+
+    std::vector<std::shared_ptr<arrow::Array>> columns(tasks.size());
+    std::vector<status> results(tasks.size(), status::OK);
+
+    // Longest processing time first: the most expensive chunks are handed out first and every thread takes the next chunk as soon
+    // as it is done, so a few large columns don't end up on the same thread.
+    std::vector<size_t> order(tasks.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&tasks](size_t a, size_t b) {return tasks[a].cost > tasks[b].cost;});
+
+    std::atomic<size_t> next_task(0);
+    auto worker = [&]() {
+        size_t i;
+        while((i = next_task++) < order.size()) {
+            results[order[i]] = read_column_task(tasks[order[i]], &columns[order[i]]);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    int num_workers = std::max(1, std::min(num_threads, (int) tasks.size()));
+    for(int i=1; i<num_workers; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for(size_t i=0; i<results.size(); i++) {
+        if(results[i] != status::OK) {
+            std::cerr << "[ERROR] Failed to read column " << column_indices[i] << std::endl;
+            return status::FAIL;
+        }
+    }
+
+    *record_batch = arrow::RecordBatch::Make(arrow::schema(fields), row_group_metadata->num_rows(), columns);
+
+    return status::OK;
+}
+
+status SWParquetReader::read_column_task(const column_task& task, std::shared_ptr<arrow::Array>* array) {
+    TraceSpan column_span("column chunk", "decode");
+
+    if(task.is_string) {
+        // The uncompressed size of the chunk includes the characters of all its pages, so it is an upper bound for the value buffer
+        std::shared_ptr<arrow::StringArray> string_array;
+        if(read_string(task.num_values, task.uncompressed_size, task.file_offset, &string_array, task.enc) != status::OK) {
+            return status::FAIL;
+        }
+        *array = string_array;
+    } else {
+        std::shared_ptr<arrow::PrimitiveArray> prim_array;
+        if(read_prim(task.prim_width, task.num_values, task.file_offset, &prim_array, task.enc) != status::OK) {
+            return status::FAIL;
+        }
+        *array = prim_array;
+    }
+
+    return status::OK;
+}
+
+}
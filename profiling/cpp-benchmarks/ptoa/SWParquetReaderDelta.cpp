@@ -17,54 +17,248 @@
 #include <algorithm>
 #include <map>
 #include <cassert>
+#include <limits>
 
 #include "SWParquetReader.h"
+#include "StageProfiler.h"
+#include "trace.h"
 #include "LemireBitUnpacking.h"
 #include "ptoa.h"
 
 namespace ptoa {
 
 
-status SWParquetReader::read_prim_delta32(int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array){
+status SWParquetReader::read_prim_delta32(int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array){
     const int32_t prim_width = 32;
 
     std::shared_ptr<arrow::Buffer> arr_buffer;
-    arrow::AllocateBuffer(num_values*prim_width/8, &arr_buffer);
-
-    read_prim_delta32(num_values, file_offset, prim_array, arr_buffer);
+    if(allocate_buffer(num_values*prim_width/8, &arr_buffer) != status::OK) {
+        return status::FAIL;
+    }
 
-    return status::OK;
+    return read_prim_delta32(num_values, file_offset, prim_array, arr_buffer);
 }
 
-status SWParquetReader::read_prim_delta64(int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array){
+status SWParquetReader::read_prim_delta64(int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array){
     const int32_t prim_width = 64;
 
     std::shared_ptr<arrow::Buffer> arr_buffer;
-    arrow::AllocateBuffer(num_values*prim_width/8, &arr_buffer);
+    if(allocate_buffer(num_values*prim_width/8, &arr_buffer) != status::OK) {
+        return status::FAIL;
+    }
 
-    read_prim_delta64(num_values, file_offset, prim_array, arr_buffer);
+    return read_prim_delta64(num_values, file_offset, prim_array, arr_buffer);
+}
 
-    return status::OK;
+status SWParquetReader::read_string_delta_length(int64_t num_strings, int64_t num_chars, int64_t file_offset, std::shared_ptr<arrow::StringArray>* string_array){
+    std::shared_ptr<arrow::Buffer> off_buffer;
+    if(allocate_buffer((num_strings+1)*sizeof(int32_t), &off_buffer) != status::OK) {
+        return status::FAIL;
+    }
+
+    std::shared_ptr<arrow::Buffer> val_buffer;
+    if(allocate_buffer(num_chars, &val_buffer) != status::OK) {
+        return status::FAIL;
+    }
+
+    return read_string_delta_length(num_strings, file_offset, string_array, off_buffer, val_buffer);
 }
 
-status SWParquetReader::read_string_delta_length(int64_t num_strings, int64_t num_chars, int32_t file_offset, std::shared_ptr<arrow::StringArray>* string_array){
+status SWParquetReader::read_string_delta_length(int64_t num_strings, int64_t num_chars, int64_t file_offset, std::shared_ptr<arrow::LargeStringArray>* string_array){
     std::shared_ptr<arrow::Buffer> off_buffer;
-    arrow::AllocateBuffer((num_strings+1)*sizeof(int32_t), &off_buffer);
+    if(allocate_buffer((num_strings+1)*sizeof(int64_t), &off_buffer) != status::OK) {
+        return status::FAIL;
+    }
 
     std::shared_ptr<arrow::Buffer> val_buffer;
-    arrow::AllocateBuffer(num_chars, &val_buffer);
+    if(allocate_buffer(num_chars, &val_buffer) != status::OK) {
+        return status::FAIL;
+    }
+
+    return read_string_delta_length(num_strings, file_offset, string_array, off_buffer, val_buffer);
+}
+
+status SWParquetReader::read_string_delta_length(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::StringArray>* string_array, std::shared_ptr<arrow::Buffer> off_buffer, std::shared_ptr<arrow::Buffer> val_buffer){
+    if(decode_string_delta_length(num_strings, file_offset, (int32_t*)off_buffer->mutable_data(), val_buffer->mutable_data()) != status::OK) {
+        return status::FAIL;
+    }
+
+    *string_array = std::make_shared<arrow::StringArray>(num_strings, off_buffer, val_buffer);
+
+    return status::OK;
+}
+
+status SWParquetReader::read_string_delta_length(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::LargeStringArray>* string_array, std::shared_ptr<arrow::Buffer> off_buffer, std::shared_ptr<arrow::Buffer> val_buffer){
+    if(decode_string_delta_length(num_strings, file_offset, (int64_t*)off_buffer->mutable_data(), val_buffer->mutable_data()) != status::OK) {
+        return status::FAIL;
+    }
+
+    *string_array = std::make_shared<arrow::LargeStringArray>(num_strings, off_buffer, val_buffer);
+
+    return status::OK;
+}
+
+status SWParquetReader::read_string_delta_length_view(int64_t num_strings, int64_t file_offset, std::shared_ptr<arrow::Buffer>* views, std::vector<std::shared_ptr<arrow::Buffer>>* data_buffers){
+    uint8_t* page_ptr = parquet_data;
+
+    if(file_buffer == nullptr) {
+        std::cerr << "[ERROR] No Parquet file loaded" << std::endl;
+        return status::FAIL;
+    }
+
+    if(allocate_buffer(num_strings*STRING_VIEW_SIZE, views) != status::OK) {
+        return status::FAIL;
+    }
+    uint8_t* view_ptr = (*views)->mutable_data();
+    data_buffers->clear();
+
+    int64_t total_value_counter = 0;
+
+    // Metadata reading variables
+    int32_t uncompressed_size;
+    int32_t compressed_size;
+    int32_t page_num_values;
+    int32_t def_level_length;
+    int32_t rep_level_length;
+    int32_t metadata_size;
+
+    int32_t page_values_to_read;
+    std::vector<int32_t> lengths;
+    const uint8_t* chars_ptr;
+
+    page_ptr += file_offset;
+
+    page_lookahead lookahead;
+    init_lookahead(&lookahead, page_ptr);
+
+    // Decode values from Parquet pages until max amount of values is reached
+    while(total_value_counter < num_strings){
+        TraceSpan page_span("page", "decode");
+        prefetch_pages(&lookahead);
+
+        // Read page metadata
+        {
+            PTOA_STAGE(STAGE_METADATA);
+            if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
+                std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
+                std::cerr << page_ptr-parquet_data << std::endl;
+                return status::FAIL;
+            }
+        }
+        PTOA_STAGE_COUNT(COUNT_PAGES, 1);
+        page_ptr += metadata_size;
+        page_values_to_read = (int32_t) std::min((int64_t) page_num_values, num_strings-total_value_counter);
+
+        lengths.resize(page_values_to_read);
+        decode_page_delta_length_lengths(page_ptr, page_num_values, page_values_to_read, lengths.data(), &chars_ptr);
+
+        // The characters of this page only get a data buffer if at least one string is too long to be inlined
+        int32_t buffer_index = -1;
+        int32_t char_offset = 0;
+
+        for(int32_t i=0; i<page_values_to_read; i++){
+            int32_t string_length = lengths[i];
+            const uint8_t* string_ptr = chars_ptr + char_offset;
+
+            std::memcpy(view_ptr, &string_length, sizeof(int32_t));
+
+            if(string_length <= STRING_VIEW_INLINE_SIZE) {
+                std::memset(view_ptr + 4, 0, STRING_VIEW_INLINE_SIZE);
+                std::memcpy(view_ptr + 4, string_ptr, string_length);
+            } else {
+                if(buffer_index < 0) {
+                    buffer_index = data_buffers->size();
+                    data_buffers->push_back(arrow::SliceBuffer(file_buffer, chars_ptr-parquet_data, (page_ptr + compressed_size) - chars_ptr));
+                }
+                std::memcpy(view_ptr + 4, string_ptr, 4);
+                std::memcpy(view_ptr + 8, &buffer_index, sizeof(int32_t));
+                std::memcpy(view_ptr + 12, &char_offset, sizeof(int32_t));
+            }
+
+            view_ptr += STRING_VIEW_SIZE;
+            char_offset += string_length;
+        }
 
-    read_string_delta_length(num_strings, file_offset, string_array, off_buffer, val_buffer);
+        //Prepare for next page
+        page_ptr += compressed_size;
+        total_value_counter += page_num_values;
+    }
 
     return status::OK;
 }
 
-status SWParquetReader::read_string_delta_length(int64_t num_strings, int32_t file_offset, std::shared_ptr<arrow::StringArray>* string_array, std::shared_ptr<arrow::Buffer> off_buffer, std::shared_ptr<arrow::Buffer> val_buffer){
+// Decode the first page_values_to_read string lengths of the DELTA_LENGTH_BYTE_ARRAY data pointed to by block_ptr (the first byte
+// after the page header) into lengths. The lengths of the other strings in the page are skipped, chars_ptr is set to the first character.
+status SWParquetReader::decode_page_delta_length_lengths(const uint8_t* block_ptr, int32_t page_num_values, int32_t page_values_to_read, int32_t* lengths, const uint8_t** chars_ptr){
+    int32_t page_value_counter = 0;
+
+    // Delta/block header reading variables
+    int32_t string_length;
+    int32_t min_delta;
+    uint8_t bitwidths[MINIBLOCKS_IN_BLOCK];
+    int32_t header_size;
+    uint32_t unpacked_deltas[BLOCK_SIZE/MINIBLOCKS_IN_BLOCK];
+
+    // Read delta header
+    {
+        PTOA_STAGE(STAGE_BLOCK_HEADER);
+        read_delta_header32(block_ptr, &string_length, &header_size);
+    }
+    block_ptr += header_size;
+
+    // The lengths of the whole page are walked to find the characters, but only the first page_values_to_read are written
+    if(page_values_to_read > 0){
+        lengths[page_value_counter] = string_length;
+    }
+    page_value_counter++;
+
+    while(page_value_counter < page_num_values){
+        // Read block header
+        {
+            PTOA_STAGE(STAGE_BLOCK_HEADER);
+            read_block_header32(block_ptr, &min_delta, bitwidths, &header_size);
+        }
+        PTOA_STAGE_COUNT(COUNT_BLOCKS, 1);
+        block_ptr += header_size;
+
+        for(int i=0; i<MINIBLOCKS_IN_BLOCK; i++){
+            // Miniblocks without any values are not stored
+            if(page_value_counter >= page_num_values){
+                break;
+            }
+
+            if(page_value_counter < page_values_to_read){
+                {
+                    PTOA_STAGE(STAGE_UNPACK);
+                    fastunpack((const uint*) block_ptr, unpacked_deltas, bitwidths[i]);
+                }
+                PTOA_STAGE_COUNT(COUNT_MINIBLOCKS, 1);
+
+                PTOA_STAGE(STAGE_ACCUMULATE);
+                for(int j=0; (j<(BLOCK_SIZE/MINIBLOCKS_IN_BLOCK)) && (page_value_counter+j < page_values_to_read); j++){
+                    string_length = string_length + unpacked_deltas[j] + min_delta;
+                    lengths[page_value_counter+j] = string_length;
+                }
+            }
+
+            block_ptr += bitwidths[i]*((BLOCK_SIZE/MINIBLOCKS_IN_BLOCK)/8);
+            page_value_counter += BLOCK_SIZE/MINIBLOCKS_IN_BLOCK;
+        }
+    }
+
+    *chars_ptr = block_ptr;
+
+    return status::OK;
+}
+
+// Decode num_strings DELTA_LENGTH_BYTE_ARRAY strings into Arrow offset and value buffers. offset_type is int32_t for StringArray and
+// int64_t for LargeStringArray. Offsets are tracked in 64 bits, so column chunks with more than 2 GiB of characters are detected
+// instead of silently overflowing the 32 bit offsets.
+template<typename offset_type>
+status SWParquetReader::decode_string_delta_length(int64_t num_strings, int64_t file_offset, offset_type* off_buf_ptr, uint8_t* val_buf_ptr){
     uint8_t* page_ptr = parquet_data;
-    int32_t* off_buf_ptr = (int32_t*)off_buffer->mutable_data();
-    int8_t* val_buf_ptr = (int8_t*)val_buffer->mutable_data();
 
-    int32_t total_value_counter = 0;
+    int64_t total_value_counter = 0;
     int32_t page_value_counter = 0;
 
     // Metadata reading variables
@@ -84,11 +278,11 @@ status SWParquetReader::read_string_delta_length(int64_t num_strings, int32_t fi
     uint32_t* unpacked_deltas = (uint32_t*)std::malloc((BLOCK_SIZE/MINIBLOCKS_IN_BLOCK)*sizeof(uint32_t));
 
     //Keep track of amount of chars to read
-    uint32_t chars_to_read;
+    int64_t chars_to_read;
 
     //Offset tracker
-    uint32_t current_offset = 0;
-    uint32_t prev_page_final_offset = 0;
+    int64_t current_offset = 0;
+    int64_t prev_page_final_offset = 0;
 
     //Store most recently processed string length
     int32_t string_length;
@@ -99,22 +293,37 @@ status SWParquetReader::read_string_delta_length(int64_t num_strings, int32_t fi
 
     page_ptr += file_offset;
 
+    page_lookahead lookahead;
+    init_lookahead(&lookahead, page_ptr);
+
     // Decode values from Parquet pages until max amount of values is reached
     while(total_value_counter < num_strings){
+        TraceSpan page_span("page", "decode");
+        prefetch_pages(&lookahead);
+
         page_value_counter = 0;
 
         // Read page metadata
-        if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
-            std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
-            std::cerr << page_ptr-parquet_data << std::endl;
-            return status::FAIL;
+        {
+            PTOA_STAGE(STAGE_METADATA);
+            if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
+                std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
+                std::cerr << page_ptr-parquet_data << std::endl;
+                free(bitwidths);
+                free(unpacked_deltas);
+                return status::FAIL;
+            }
         }
+        PTOA_STAGE_COUNT(COUNT_PAGES, 1);
         page_ptr += metadata_size;
         block_ptr = page_ptr;
-        page_values_to_read = std::min(page_num_values, (int32_t)(num_strings-total_value_counter));
+        page_values_to_read = (int32_t) std::min((int64_t) page_num_values, num_strings-total_value_counter);
 
         // Read delta header
-        read_delta_header32(block_ptr, &string_length, &header_size);
+        {
+            PTOA_STAGE(STAGE_BLOCK_HEADER);
+            read_delta_header32(block_ptr, &string_length, &header_size);
+        }
         block_ptr += header_size;
 
         // Insert first offset of page into the arrow offset buffer
@@ -126,13 +335,22 @@ status SWParquetReader::read_string_delta_length(int64_t num_strings, int32_t fi
         // Keep on looping through the blocks in the page until exactly page_values_to_read have been processed.
         while(page_value_counter < page_values_to_read){
             // Read block header
-            read_block_header32(block_ptr, &min_delta, bitwidths, &header_size);
+            {
+                PTOA_STAGE(STAGE_BLOCK_HEADER);
+                read_block_header32(block_ptr, &min_delta, bitwidths, &header_size);
+            }
+            PTOA_STAGE_COUNT(COUNT_BLOCKS, 1);
             block_ptr += header_size;
         
             for(int i=0; i<MINIBLOCKS_IN_BLOCK; i++){
                 uint8_t current_bitwidth = bitwidths[i];
-                fastunpack((uint*) block_ptr, unpacked_deltas, current_bitwidth);
+                {
+                    PTOA_STAGE(STAGE_UNPACK);
+                    fastunpack((uint*) block_ptr, unpacked_deltas, current_bitwidth);
+                }
+                PTOA_STAGE_COUNT(COUNT_MINIBLOCKS, 1);
 
+                PTOA_STAGE(STAGE_ACCUMULATE);
                 for(int j=0; j<(BLOCK_SIZE/MINIBLOCKS_IN_BLOCK); j++){
                     string_length = string_length + unpacked_deltas[j] + min_delta;
                     current_offset = string_length + current_offset;
@@ -141,9 +359,6 @@ status SWParquetReader::read_string_delta_length(int64_t num_strings, int32_t fi
 
                     // Nested loops termination condition, all values have been read
                     if(page_value_counter >= page_values_to_read){
-                        // Set off_buf_ptr to where we start writing the next page
-                        off_buf_ptr += page_value_counter;
-
                         //Advance block pointer to next block
                         page_value_counter += (BLOCK_SIZE/MINIBLOCKS_IN_BLOCK) - j - 1;
                         block_ptr += current_bitwidth*((BLOCK_SIZE/MINIBLOCKS_IN_BLOCK)/8);
@@ -165,8 +380,12 @@ status SWParquetReader::read_string_delta_length(int64_t num_strings, int32_t fi
         }
 
         end_of_lengths:
+        // Set off_buf_ptr to where we start writing the next page
+        off_buf_ptr += page_values_to_read;
+
         // If the last block processed was not the last block in the page we need to keep reading bitwidths to find the first character
         while(page_value_counter<page_num_values){
+            PTOA_STAGE(STAGE_PAGE_SKIP);
             read_block_header32(block_ptr, &min_delta, bitwidths, &header_size);
             block_ptr += header_size;
 
@@ -179,9 +398,20 @@ status SWParquetReader::read_string_delta_length(int64_t num_strings, int32_t fi
             }
         }
 
+        if(current_offset > std::numeric_limits<offset_type>::max()) {
+            std::cerr << "[ERROR] String data does not fit in " << sizeof(offset_type)*8 << " bit offsets, read into a LargeStringArray instead" << std::endl;
+            free(bitwidths);
+            free(unpacked_deltas);
+            return status::FAIL;
+        }
+
         //Copy characters
         chars_to_read = current_offset-prev_page_final_offset;
-        std::memcpy((void*) val_buf_ptr, (const void*) block_ptr, chars_to_read);
+        {
+            PTOA_STAGE(STAGE_COPY);
+            std::memcpy((void*) val_buf_ptr, (const void*) block_ptr, chars_to_read);
+        }
+        PTOA_STAGE_COUNT(COUNT_BYTES_COPIED, chars_to_read);
         val_buf_ptr += chars_to_read;
         prev_page_final_offset = current_offset;
 
@@ -190,20 +420,17 @@ status SWParquetReader::read_string_delta_length(int64_t num_strings, int32_t fi
         total_value_counter += page_num_values;
     }
 
-    *string_array = std::make_shared<arrow::StringArray>(num_strings, off_buffer, val_buffer);
-
     free(bitwidths);
     free(unpacked_deltas);
 
     return status::OK;
 }
 
-status SWParquetReader::read_prim_delta32(int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer){
+status SWParquetReader::read_prim_delta32(int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer){
     uint8_t* page_ptr = parquet_data;
-    int32_t* arr_buf_ptr = (int32_t*)arr_buffer->mutable_data();
+    int32_t* arr_buf_ptr = (int32_t*)(arr_buffer->mutable_data());
 
-    int32_t total_value_counter = 0;
-    int32_t page_value_counter = 0;
+    int64_t total_value_counter = 0;
 
     // Metadata reading variables
     int32_t uncompressed_size;
@@ -213,85 +440,115 @@ status SWParquetReader::read_prim_delta32(int64_t num_values, int32_t file_offse
     int32_t rep_level_length;
     int32_t metadata_size;
 
-    // Delta/block header reading variables
     int32_t page_values_to_read;
-    uint8_t* block_ptr;
-    int32_t first_value;
-    int32_t min_delta;
-    uint8_t* bitwidths = (uint8_t*)std::malloc(MINIBLOCKS_IN_BLOCK*sizeof(uint8_t));
-    int32_t header_size;
-    uint32_t* unpacked_deltas = (uint32_t*)std::malloc((BLOCK_SIZE/MINIBLOCKS_IN_BLOCK)*sizeof(uint32_t));
 
     page_ptr += file_offset;
 
+    page_lookahead lookahead;
+    init_lookahead(&lookahead, page_ptr);
+
     // Decode values from Parquet pages until max amount of values is reached
     while(total_value_counter < num_values){
-        // Set arr_buf_ptr to where we start writing the current page
-        arr_buf_ptr += page_value_counter;
-
-        page_value_counter = 0;
+        TraceSpan page_span("page", "decode");
+        prefetch_pages(&lookahead);
 
         // Read page metadata
-        if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
-            std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
-            std::cerr << page_ptr-parquet_data << std::endl;
-            return status::FAIL;
+        {
+            PTOA_STAGE(STAGE_METADATA);
+            if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
+                std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
+                std::cerr << page_ptr-parquet_data << std::endl;
+                return status::FAIL;
+            }
         }
+        PTOA_STAGE_COUNT(COUNT_PAGES, 1);
         page_ptr += metadata_size;
-        block_ptr = page_ptr;
-        page_values_to_read = std::min(page_num_values, (int32_t)(num_values-total_value_counter));
+        page_values_to_read = (int32_t) std::min((int64_t) page_num_values, num_values-total_value_counter);
 
-        // Read delta header
+        decode_page_delta32(page_ptr, page_values_to_read, arr_buf_ptr);
+
+        // Set arr_buf_ptr to where we start writing the next page
+        arr_buf_ptr += page_values_to_read;
+
+        page_ptr += compressed_size;
+        total_value_counter += page_num_values;
+    }
+
+    *prim_array = std::make_shared<arrow::PrimitiveArray>(arrow::int32(), num_values, arr_buffer);
+
+    return status::OK;
+}
+
+// Decode the first page_values_to_read values of the DELTA_BINARY_PACKED data pointed to by block_ptr (the first byte after the page header) into out.
+status SWParquetReader::decode_page_delta32(const uint8_t* block_ptr, int32_t page_values_to_read, int32_t* out){
+    int32_t page_value_counter = 0;
+
+    // Delta/block header reading variables
+    int32_t first_value;
+    int32_t min_delta;
+    uint8_t bitwidths[MINIBLOCKS_IN_BLOCK];
+    int32_t header_size;
+    uint32_t unpacked_deltas[BLOCK_SIZE/MINIBLOCKS_IN_BLOCK];
+
+    // Nothing to write, not even the first value, which would land past the range of the caller
+    if(page_values_to_read <= 0){
+        return status::OK;
+    }
+
+    // Read delta header
+    {
+        PTOA_STAGE(STAGE_BLOCK_HEADER);
         read_delta_header32(block_ptr, &first_value, &header_size);
-        block_ptr += header_size;
+    }
+    block_ptr += header_size;
 
-        // Insert first value of page into the arrow buffer
-        arr_buf_ptr[page_value_counter] = first_value;
-        page_value_counter++;
+    // Insert first value of page into the arrow buffer
+    out[page_value_counter] = first_value;
+    page_value_counter++;
 
-        // Keep on looping through the blocks in the page until exactly page_values_to_read have been processed.
-        while(page_value_counter < page_values_to_read){
-            // Read block header
+    // Keep on looping through the blocks in the page until exactly page_values_to_read have been processed.
+    while(page_value_counter < page_values_to_read){
+        // Read block header
+        {
+            PTOA_STAGE(STAGE_BLOCK_HEADER);
             read_block_header32(block_ptr, &min_delta, bitwidths, &header_size);
-            block_ptr += header_size;
-        
-            for(int i=0; i<MINIBLOCKS_IN_BLOCK; i++){
-                uint8_t current_bitwidth = bitwidths[i];
-                fastunpack((uint*) block_ptr, unpacked_deltas, current_bitwidth);
+        }
+        PTOA_STAGE_COUNT(COUNT_BLOCKS, 1);
+        block_ptr += header_size;
+
+        for(int i=0; i<MINIBLOCKS_IN_BLOCK; i++){
+            uint8_t current_bitwidth = bitwidths[i];
+            {
+                PTOA_STAGE(STAGE_UNPACK);
+                fastunpack((const uint*) block_ptr, unpacked_deltas, current_bitwidth);
+            }
+            PTOA_STAGE_COUNT(COUNT_MINIBLOCKS, 1);
 
+            {
+                PTOA_STAGE(STAGE_ACCUMULATE);
                 for(int j=0; j<(BLOCK_SIZE/MINIBLOCKS_IN_BLOCK); j++){
-                    arr_buf_ptr[page_value_counter] = unpacked_deltas[j] + min_delta + arr_buf_ptr[page_value_counter-1];
+                    out[page_value_counter] = unpacked_deltas[j] + min_delta + out[page_value_counter-1];
                     page_value_counter++;
 
                     // Nested loops termination condition
                     if(page_value_counter >= page_values_to_read){
-                        // Not pretty, but very pragmatic
-                        goto end_of_page;
+                        return status::OK;
                     }
                 }
-
-                block_ptr += current_bitwidth*((BLOCK_SIZE/MINIBLOCKS_IN_BLOCK)/8);
             }
-        }
 
-        end_of_page:
-        page_ptr += compressed_size;
-        total_value_counter += page_num_values;
+            block_ptr += current_bitwidth*((BLOCK_SIZE/MINIBLOCKS_IN_BLOCK)/8);
+        }
     }
 
-    *prim_array = std::make_shared<arrow::PrimitiveArray>(arrow::int32(), num_values, arr_buffer);
-
-    free(bitwidths);
-    free(unpacked_deltas);
     return status::OK;
 }
 
-status SWParquetReader::read_prim_delta64(int64_t num_values, int32_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer){
+status SWParquetReader::read_prim_delta64(int64_t num_values, int64_t file_offset, std::shared_ptr<arrow::PrimitiveArray>* prim_array, std::shared_ptr<arrow::Buffer> arr_buffer){
     uint8_t* page_ptr = parquet_data;
     int64_t* arr_buf_ptr = (int64_t*)(arr_buffer->mutable_data());
 
-    int32_t total_value_counter = 0;
-    int32_t page_value_counter = 0;
+    int64_t total_value_counter = 0;
 
     // Metadata reading variables
     int32_t uncompressed_size;
@@ -301,94 +558,168 @@ status SWParquetReader::read_prim_delta64(int64_t num_values, int32_t file_offse
     int32_t rep_level_length;
     int32_t metadata_size;
 
-    // Delta/block header reading variables
     int32_t page_values_to_read;
-    uint8_t* block_ptr;
-    int64_t first_value;
-    int64_t min_delta;
-    uint8_t* bitwidths = (uint8_t*)std::malloc(MINIBLOCKS_IN_BLOCK*sizeof(uint8_t));
-    int32_t header_size;
-    uint64_t* unpacked_deltas = (uint64_t*)std::malloc((BLOCK_SIZE/MINIBLOCKS_IN_BLOCK)*sizeof(uint64_t));
 
     page_ptr += file_offset;
 
+    page_lookahead lookahead;
+    init_lookahead(&lookahead, page_ptr);
+
     // Decode values from Parquet pages until max amount of values is reached
     while(total_value_counter < num_values){
-
-        // Set arr_buf_ptr to where we start writing the current page
-        arr_buf_ptr += page_value_counter;
-
-        page_value_counter = 0;
+        TraceSpan page_span("page", "decode");
+        prefetch_pages(&lookahead);
 
         // Read page metadata
-        if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
-            std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
-            std::cerr << page_ptr-parquet_data << std::endl;
-            return status::FAIL;
+        {
+            PTOA_STAGE(STAGE_METADATA);
+            if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, &page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
+                std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
+                std::cerr << page_ptr-parquet_data << std::endl;
+                return status::FAIL;
+            }
         }
+        PTOA_STAGE_COUNT(COUNT_PAGES, 1);
         page_ptr += metadata_size;
-        block_ptr = page_ptr;
-        page_values_to_read = std::min(page_num_values, (int32_t)(num_values-total_value_counter));
+        page_values_to_read = (int32_t) std::min((int64_t) page_num_values, num_values-total_value_counter);
 
-        // Read delta header
-        read_delta_header64(block_ptr, &first_value, &header_size);
-        block_ptr += header_size;
+        decode_page_delta64(page_ptr, page_values_to_read, arr_buf_ptr);
 
-        //std::cout<<std::endl;
-        //std::cout<<"Values to read: "<<page_values_to_read<<std::endl;
-        //std::cout<<"Delta header size: "<<header_size<<std::endl;
-        //std::cout<<"First value: "<<first_value<<std::endl;
+        // Set arr_buf_ptr to where we start writing the next page
+        arr_buf_ptr += page_values_to_read;
 
-        // Insert first value of page into the arrow buffer
-        arr_buf_ptr[page_value_counter] = first_value;
-        page_value_counter++;
+        page_ptr += compressed_size;
+        total_value_counter += page_num_values;
+    }
 
-        // Keep on looping through the blocks in the page until exactly page_values_to_read have been processed.
-        while(page_value_counter < page_values_to_read){
-            // Read block header
+    *prim_array = std::make_shared<arrow::PrimitiveArray>(arrow::int64(), num_values, arr_buffer);
+
+    return status::OK;
+}
+
+// Decode the first page_values_to_read values of the DELTA_BINARY_PACKED data pointed to by block_ptr (the first byte after the page header) into out.
+status SWParquetReader::decode_page_delta64(const uint8_t* block_ptr, int32_t page_values_to_read, int64_t* out){
+    int32_t page_value_counter = 0;
+
+    // Delta/block header reading variables
+    int64_t first_value;
+    int64_t min_delta;
+    uint8_t bitwidths[MINIBLOCKS_IN_BLOCK];
+    int32_t header_size;
+    uint64_t unpacked_deltas[BLOCK_SIZE/MINIBLOCKS_IN_BLOCK];
+
+    // Nothing to write, not even the first value, which would land past the range of the caller
+    if(page_values_to_read <= 0){
+        return status::OK;
+    }
+
+    // Read delta header
+    {
+        PTOA_STAGE(STAGE_BLOCK_HEADER);
+        read_delta_header64(block_ptr, &first_value, &header_size);
+    }
+    block_ptr += header_size;
+
+    // Insert first value of page into the arrow buffer
+    out[page_value_counter] = first_value;
+    page_value_counter++;
+
+    // Keep on looping through the blocks in the page until exactly page_values_to_read have been processed.
+    while(page_value_counter < page_values_to_read){
+        // Read block header
+        {
+            PTOA_STAGE(STAGE_BLOCK_HEADER);
             read_block_header64(block_ptr, &min_delta, bitwidths, &header_size);
-            block_ptr += header_size;
+        }
+        PTOA_STAGE_COUNT(COUNT_BLOCKS, 1);
+        block_ptr += header_size;
 
-            //std::cout<<"Min delta: "<<min_delta<<", block header size: "<<header_size<<std::endl;
-            //for(int z=0; z<4;z++){
-            //    std::cout<<"Bit width "<<z<<": "<<(int)bitwidths[z]<<std::endl;
-            //}
-            //std::cout<<"First byte:  "<<(int)*block_ptr<<std::endl;
-        
-            for(int i=0; i<MINIBLOCKS_IN_BLOCK; i++){
-                uint8_t current_bitwidth = bitwidths[i];
-                int64fastunpack((uint64_t*) block_ptr, unpacked_deltas, current_bitwidth);
+        for(int i=0; i<MINIBLOCKS_IN_BLOCK; i++){
+            uint8_t current_bitwidth = bitwidths[i];
+            {
+                PTOA_STAGE(STAGE_UNPACK);
+                int64fastunpack((const uint64_t*) block_ptr, unpacked_deltas, current_bitwidth);
+            }
+            PTOA_STAGE_COUNT(COUNT_MINIBLOCKS, 1);
 
+            {
+                PTOA_STAGE(STAGE_ACCUMULATE);
                 for(int j=0; j<(BLOCK_SIZE/MINIBLOCKS_IN_BLOCK); j++){
-                    arr_buf_ptr[page_value_counter] = unpacked_deltas[j] + min_delta + arr_buf_ptr[page_value_counter-1];
-                    //std::cout<<unpacked_deltas[j] + min_delta + arr_buf_ptr[page_value_counter-1]<<std::endl;
+                    out[page_value_counter] = unpacked_deltas[j] + min_delta + out[page_value_counter-1];
                     page_value_counter++;
 
                     // Nested loops termination condition
                     if(page_value_counter >= page_values_to_read){
-                        // Not pretty, but very pragmatic
-                        goto end_of_page;
+                        return status::OK;
                     }
                 }
-
-                block_ptr += current_bitwidth*((BLOCK_SIZE/MINIBLOCKS_IN_BLOCK)/8);
             }
+
+            block_ptr += current_bitwidth*((BLOCK_SIZE/MINIBLOCKS_IN_BLOCK)/8);
         }
+    }
 
-        end_of_page:
-        page_ptr += compressed_size;
-        total_value_counter += page_num_values;
+    return status::OK;
+}
+
+// Walk the block headers of the DELTA_BINARY_PACKED data in the page pointed to by page_ptr without decoding any values. For DELTA_LENGTH
+// pages (prim_width 32) these are the string lengths and end_ptr is set to the first character, otherwise to the end of the page data.
+status SWParquetReader::inspect_delta_page(int32_t prim_width, const uint8_t* page_ptr, std::vector<delta_block_info>* blocks, int32_t* page_num_values, const uint8_t** end_ptr){
+    // Metadata reading variables
+    int32_t uncompressed_size;
+    int32_t compressed_size;
+    int32_t def_level_length;
+    int32_t rep_level_length;
+    int32_t metadata_size;
+
+    if(read_metadata(page_ptr, &uncompressed_size, &compressed_size, page_num_values, &def_level_length, &rep_level_length, &metadata_size) != status::OK) {
+        std::cerr << "[ERROR] Corrupted data in Parquet page headers" << std::endl;
+        return status::FAIL;
     }
 
+    const uint8_t* block_ptr = page_ptr + metadata_size;
+    int32_t header_size;
+    int32_t page_value_counter = 1;
 
-    //std::cout<<"Creating array with capacity "<<arr_buffer->capacity()<<" and size "<< arr_buffer->size()<<std::endl;
-    //for(int l=0; l<200; l++){
-    //    std::cout<<(arr_buf_ptr+page_value_counter-100)[l]<<std::endl;
-    //}
-    *prim_array = std::make_shared<arrow::PrimitiveArray>(arrow::int64(), num_values, arr_buffer);
+    if(prim_width == 32){
+        int32_t first_value;
+        read_delta_header32(block_ptr, &first_value, &header_size);
+    } else {
+        int64_t first_value;
+        read_delta_header64(block_ptr, &first_value, &header_size);
+    }
+    block_ptr += header_size;
 
-    free(bitwidths);
-    free(unpacked_deltas);
+    blocks->clear();
+
+    while(page_value_counter < *page_num_values){
+        delta_block_info block;
+
+        if(prim_width == 32){
+            int32_t min_delta;
+            read_block_header32(block_ptr, &min_delta, block.bitwidths, &header_size);
+            block.min_delta = min_delta;
+        } else {
+            read_block_header64(block_ptr, &block.min_delta, block.bitwidths, &header_size);
+        }
+        block_ptr += header_size;
+
+        block.num_miniblocks = 0;
+        for(int i=0; (i<MINIBLOCKS_IN_BLOCK) && (page_value_counter < *page_num_values); i++){
+            block_ptr += block.bitwidths[i]*((BLOCK_SIZE/MINIBLOCKS_IN_BLOCK)/8);
+            page_value_counter += BLOCK_SIZE/MINIBLOCKS_IN_BLOCK;
+            block.num_miniblocks++;
+        }
+
+        blocks->push_back(block);
+    }
+
+    if(block_ptr > page_ptr + metadata_size + compressed_size){
+        std::cerr << "[ERROR] DELTA_BINARY_PACKED data runs past the end of its page" << std::endl;
+        return status::FAIL;
+    }
+
+    *end_ptr = block_ptr;
 
     return status::OK;
 }
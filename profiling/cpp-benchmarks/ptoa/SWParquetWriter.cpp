@@ -0,0 +1,410 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <thread>
+
+#include "SWParquetWriter.h"
+#include "DeltaEncoder.h"
+#include "ptoa.h"
+
+// Parquet physical and converted types, as written in the schema and column metadata
+#define PARQUET_TYPE_INT32 1
+#define PARQUET_TYPE_INT64 2
+#define PARQUET_TYPE_BYTE_ARRAY 6
+#define PARQUET_CONVERTED_TYPE_UTF8 0
+#define PARQUET_REPETITION_REQUIRED 0
+
+namespace ptoa {
+
+// Field types of the Thrift compact protocol
+enum compact_type {
+    COMPACT_I32 = 5,
+    COMPACT_I64 = 6,
+    COMPACT_BINARY = 8,
+    COMPACT_LIST = 9,
+    COMPACT_STRUCT = 12
+};
+
+// Minimal Thrift compact protocol writer for the page headers and the footer. Field ids are delta encoded against the previous
+// field of the same struct, so every nested struct remembers the last field id of its parent.
+class compact_writer {
+  public:
+    compact_writer(std::vector<uint8_t>* out) : out(out), last_field(0) {}
+
+    void write_i32(int16_t id, int32_t value) {
+        write_field_header(id, COMPACT_I32);
+        write_varint(out, zigzag(value));
+    }
+
+    void write_i64(int16_t id, int64_t value) {
+        write_field_header(id, COMPACT_I64);
+        write_varint(out, zigzag(value));
+    }
+
+    void write_binary(int16_t id, const std::string& value) {
+        write_field_header(id, COMPACT_BINARY);
+        write_binary_value(value);
+    }
+
+    void write_binary_value(const std::string& value) {
+        write_varint(out, value.size());
+        out->insert(out->end(), value.begin(), value.end());
+    }
+
+    void write_i32_value(int32_t value) {
+        write_varint(out, zigzag(value));
+    }
+
+    void begin_list(int16_t id, compact_type element_type, int32_t size) {
+        write_field_header(id, COMPACT_LIST);
+        if(size < 15) {
+            out->push_back((uint8_t) ((size << 4) | element_type));
+        } else {
+            out->push_back((uint8_t) (0xf0 | element_type));
+            write_varint(out, size);
+        }
+    }
+
+    void begin_struct(int16_t id) {
+        write_field_header(id, COMPACT_STRUCT);
+        begin_struct_value();
+    }
+
+    // A struct that is an element of a list, which has no field header
+    void begin_struct_value() {
+        parent_fields.push_back(last_field);
+        last_field = 0;
+    }
+
+    void end_struct() {
+        out->push_back(0x00);
+        last_field = parent_fields.back();
+        parent_fields.pop_back();
+    }
+
+    // Stop field of the outermost struct
+    void end() {
+        out->push_back(0x00);
+    }
+
+  private:
+    void write_field_header(int16_t id, compact_type type) {
+        int16_t delta = id - last_field;
+        if(delta > 0 && delta <= 15) {
+            out->push_back((uint8_t) ((delta << 4) | type));
+        } else {
+            out->push_back((uint8_t) type);
+            write_varint(out, zigzag(id));
+        }
+        last_field = id;
+    }
+
+    std::vector<uint8_t>* out;
+    int16_t last_field;
+    std::vector<int16_t> parent_fields;
+};
+
+// v1 data page header without CRC and statistics, the only layout read_metadata accepts
+static void write_page_header(std::vector<uint8_t>* out, int32_t page_size, int32_t num_values, int32_t parquet_encoding) {
+    compact_writer writer(out);
+    writer.write_i32(1, 0); // DATA_PAGE
+    writer.write_i32(2, page_size);
+    writer.write_i32(3, page_size);
+    writer.begin_struct(5);
+    writer.write_i32(1, num_values);
+    writer.write_i32(2, parquet_encoding);
+    writer.write_i32(3, PARQUET_ENCODING_BIT_PACKED);
+    writer.write_i32(4, PARQUET_ENCODING_BIT_PACKED);
+    writer.end_struct();
+    writer.end();
+}
+
+// DELTA_LENGTH_BYTE_ARRAY encoding of a single page: the DELTA_BINARY_PACKED lengths followed by all characters
+static status encode_delta_length(const DeltaEncoder& encoder, const int32_t* offsets, const uint8_t* chars, int32_t num_strings, std::vector<uint8_t>* out) {
+    std::vector<int32_t> lengths(num_strings);
+    for(int32_t i=0; i<num_strings; i++) {
+        lengths[i] = offsets[i+1] - offsets[i];
+    }
+    if(encoder.encode(lengths.data(), num_strings, out) != status::OK) {
+        return status::FAIL;
+    }
+    out->insert(out->end(), chars + offsets[0], chars + offsets[num_strings]);
+
+    return status::OK;
+}
+
+SWParquetWriter::SWParquetWriter(std::string file_path, int num_threads) : file_path(file_path), num_threads(std::max(1, num_threads)),
+                                                                          file_offset(0), pages_size(0), file_size(0) {}
+
+void SWParquetWriter::set_delta_options(const delta_options& options) {
+    delta_encoder = DeltaEncoder(options);
+}
+
+status SWParquetWriter::write_prim(int32_t prim_width, const std::shared_ptr<arrow::PrimitiveArray>& prim_array, int32_t values_per_page, encoding enc, std::string column_name) {
+    if(prim_array->null_count() > 0) {
+        std::cerr << "[ERROR] SWParquetWriter only writes required columns, " << column_name << " has " << prim_array->null_count() << " nulls" << std::endl;
+        return status::FAIL;
+    }
+
+    return write_prim(prim_width, prim_array->values()->data() + prim_array->offset()*prim_width/8, prim_array->length(), values_per_page, enc, column_name);
+}
+
+status SWParquetWriter::write_prim(int32_t prim_width, const uint8_t* values, int64_t num_values, int32_t values_per_page, encoding enc, std::string column_name) {
+    if(prim_width != 32 && prim_width != 64) {
+        std::cerr << "[ERROR] SWParquetWriter only supports 32 and 64 bit integers, not " << prim_width << " bit" << std::endl;
+        return status::FAIL;
+    }
+    if(enc != encoding::PLAIN && enc != encoding::DELTA) {
+        std::cerr << "[ERROR] Primitive columns are written with PLAIN or DELTA encoding" << std::endl;
+        return status::FAIL;
+    }
+    if(enc == encoding::DELTA && delta_encoder.check_options(prim_width) != status::OK) {
+        return status::FAIL;
+    }
+
+    std::ofstream file;
+    if(open_file(file) != status::OK) {
+        return status::FAIL;
+    }
+
+    column_chunk chunk;
+    chunk.name = column_name;
+    chunk.physical_type = prim_width == 32 ? PARQUET_TYPE_INT32 : PARQUET_TYPE_INT64;
+    chunk.is_string = false;
+    chunk.parquet_encoding = enc == encoding::PLAIN ? PARQUET_ENCODING_PLAIN : PARQUET_ENCODING_DELTA_BINARY_PACKED;
+
+    const int32_t value_size = prim_width/8;
+    auto encode_page = [&](int64_t first_value, int32_t page_num_values, std::vector<uint8_t>* out) {
+        const uint8_t* page_values = values + first_value*value_size;
+        if(enc == encoding::PLAIN) {
+            out->insert(out->end(), page_values, page_values + page_num_values*value_size);
+            return status::OK;
+        } else if(prim_width == 32) {
+            return delta_encoder.encode((const int32_t*) page_values, page_num_values, out);
+        } else {
+            return delta_encoder.encode((const int64_t*) page_values, page_num_values, out);
+        }
+    };
+
+    if(write_pages(file, num_values, values_per_page, &chunk, encode_page) != status::OK) {
+        return status::FAIL;
+    }
+
+    return write_footer(file, chunk);
+}
+
+status SWParquetWriter::write_string(const std::shared_ptr<arrow::StringArray>& string_array, int32_t values_per_page, encoding enc, std::string column_name) {
+    if(string_array->null_count() > 0) {
+        std::cerr << "[ERROR] SWParquetWriter only writes required columns, " << column_name << " has " << string_array->null_count() << " nulls" << std::endl;
+        return status::FAIL;
+    }
+
+    return write_string(string_array->raw_value_offsets(), string_array->value_data()->data(), string_array->length(), values_per_page, enc, column_name);
+}
+
+status SWParquetWriter::write_string(const int32_t* offsets, const uint8_t* chars, int64_t num_strings, int32_t values_per_page, encoding enc, std::string column_name) {
+    // Neither SWParquetReader nor the hardware can read PLAIN strings
+    if(enc != encoding::DELTA_LENGTH) {
+        std::cerr << "[ERROR] String columns are written with DELTA_LENGTH encoding" << std::endl;
+        return status::FAIL;
+    }
+    if(delta_encoder.check_options(32) != status::OK) {
+        return status::FAIL;
+    }
+
+    std::ofstream file;
+    if(open_file(file) != status::OK) {
+        return status::FAIL;
+    }
+
+    column_chunk chunk;
+    chunk.name = column_name;
+    chunk.physical_type = PARQUET_TYPE_BYTE_ARRAY;
+    chunk.is_string = true;
+    chunk.parquet_encoding = PARQUET_ENCODING_DELTA_LENGTH_BYTE_ARRAY;
+
+    auto encode_page = [&](int64_t first_string, int32_t page_num_strings, std::vector<uint8_t>* out) {
+        return encode_delta_length(delta_encoder, offsets + first_string, chars, page_num_strings, out);
+    };
+
+    if(write_pages(file, num_strings, values_per_page, &chunk, encode_page) != status::OK) {
+        return status::FAIL;
+    }
+
+    return write_footer(file, chunk);
+}
+
+status SWParquetWriter::open_file(std::ofstream& file) {
+    file.open(file_path, std::ios::binary | std::ios::trunc);
+    if(!file) {
+        std::cerr << "[ERROR] Could not open " << file_path << " for writing" << std::endl;
+        return status::FAIL;
+    }
+
+    file.write("PAR1", 4);
+    file_offset = 4;
+    pages_size = 0;
+    file_size = 4;
+
+    return status::OK;
+}
+
+// Encodes the pages in batches of num_threads*WRITER_PAGES_PER_BATCH pages. The threads take the next page of a batch as soon as
+// they are done with the previous one, the encoded pages are then written in order. The page buffers are reused between
+// batches, so after the first batch encoding hardly allocates.
+template<typename F>
+status SWParquetWriter::write_pages(std::ofstream& file, int64_t num_values, int32_t values_per_page, column_chunk* chunk, F encode_page) {
+    if(values_per_page <= 0) {
+        std::cerr << "[ERROR] Pages need to hold at least one value" << std::endl;
+        return status::FAIL;
+    }
+
+    struct encoded_page {
+        std::vector<uint8_t> header;
+        std::vector<uint8_t> data;
+        status result;
+    };
+
+    const int64_t num_pages = (num_values + values_per_page - 1) / values_per_page;
+    const int64_t pages_per_batch = (int64_t) num_threads * WRITER_PAGES_PER_BATCH;
+    std::vector<encoded_page> batch(std::min(num_pages, pages_per_batch));
+
+    chunk->num_values = num_values;
+    chunk->total_size = 0;
+
+    for(int64_t batch_start = 0; batch_start < num_pages; batch_start += pages_per_batch) {
+        const int64_t batch_pages = std::min(pages_per_batch, num_pages - batch_start);
+
+        // Pages after a page that failed to encode are never written, so the threads stop taking pages after a failure
+        std::atomic<int64_t> next_page(0);
+        std::atomic<bool> failed(false);
+        auto worker = [&]() {
+            for(int64_t i = next_page++; i < batch_pages && !failed; i = next_page++) {
+                const int64_t first_value = (batch_start + i) * values_per_page;
+                const int32_t page_num_values = (int32_t) std::min((int64_t) values_per_page, num_values - first_value);
+                encoded_page& page = batch[i];
+                page.header.clear();
+                page.data.clear();
+                page.result = encode_page(first_value, page_num_values, &page.data);
+                if(page.result != status::OK) {
+                    failed = true;
+                }
+                write_page_header(&page.header, page.data.size(), page_num_values, chunk->parquet_encoding);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for(int t=1; t<std::min((int64_t) num_threads, batch_pages); t++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for(std::thread& thread : threads) {
+            thread.join();
+        }
+
+        for(int64_t i=0; i<batch_pages; i++) {
+            if(batch[i].result != status::OK) {
+                std::cerr << "[ERROR] Could not encode page " << batch_start + i << std::endl;
+                return status::FAIL;
+            }
+            if(batch[i].data.size() > (size_t) std::numeric_limits<int32_t>::max()) {
+                std::cerr << "[ERROR] Page " << batch_start + i << " is larger than 2 GB, use fewer values per page" << std::endl;
+                return status::FAIL;
+            }
+            file.write((const char*) batch[i].header.data(), batch[i].header.size());
+            file.write((const char*) batch[i].data.data(), batch[i].data.size());
+            chunk->total_size += batch[i].header.size() + batch[i].data.size();
+        }
+
+        if(!file) {
+            std::cerr << "[ERROR] Could not write to " << file_path << std::endl;
+            return status::FAIL;
+        }
+    }
+
+    pages_size = chunk->total_size;
+    file_size += chunk->total_size;
+
+    return status::OK;
+}
+
+// FileMetaData with a single required column in a single row group
+status SWParquetWriter::write_footer(std::ofstream& file, const column_chunk& chunk) {
+    std::vector<uint8_t> footer;
+    compact_writer writer(&footer);
+
+    writer.write_i32(1, 1);
+
+    writer.begin_list(2, COMPACT_STRUCT, 2);
+    writer.begin_struct_value();
+    writer.write_binary(4, "schema");
+    writer.write_i32(5, 1);
+    writer.end_struct();
+    writer.begin_struct_value();
+    writer.write_i32(1, chunk.physical_type);
+    writer.write_i32(3, PARQUET_REPETITION_REQUIRED);
+    writer.write_binary(4, chunk.name);
+    if(chunk.is_string) {
+        writer.write_i32(6, PARQUET_CONVERTED_TYPE_UTF8);
+    }
+    writer.end_struct();
+
+    writer.write_i64(3, chunk.num_values);
+
+    writer.begin_list(4, COMPACT_STRUCT, 1);
+    writer.begin_struct_value();
+    writer.begin_list(1, COMPACT_STRUCT, 1);
+    writer.begin_struct_value();
+    writer.write_i64(2, file_offset);
+    writer.begin_struct(3);
+    writer.write_i32(1, chunk.physical_type);
+    writer.begin_list(2, COMPACT_I32, 2);
+    writer.write_i32_value(PARQUET_ENCODING_BIT_PACKED);
+    writer.write_i32_value(chunk.parquet_encoding);
+    writer.begin_list(3, COMPACT_BINARY, 1);
+    writer.write_binary_value(chunk.name);
+    writer.write_i32(4, 0); // UNCOMPRESSED
+    writer.write_i64(5, chunk.num_values);
+    writer.write_i64(6, chunk.total_size);
+    writer.write_i64(7, chunk.total_size);
+    writer.write_i64(9, file_offset);
+    writer.end_struct();
+    writer.end_struct();
+    writer.write_i64(2, chunk.total_size);
+    writer.write_i64(3, chunk.num_values);
+    writer.end_struct();
+
+    writer.write_binary(6, "ptoa SWParquetWriter");
+    writer.end();
+
+    uint32_t footer_size = footer.size();
+    file.write((const char*) footer.data(), footer.size());
+    file.write((const char*) &footer_size, sizeof(footer_size));
+    file.write("PAR1", 4);
+    file.close();
+
+    if(!file) {
+        std::cerr << "[ERROR] Could not write the footer of " << file_path << std::endl;
+        return status::FAIL;
+    }
+
+    file_size += footer.size() + sizeof(footer_size) + 4;
+
+    return status::OK;
+}
+
+}
@@ -0,0 +1,83 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <arrow/api.h>
+
+#include "ptoa.h"
+#include "SWParquetReader.h"
+#include "DeltaEncoder.h"
+
+// Pages encoded by every thread before the encoded pages are written to the file in order
+#define WRITER_PAGES_PER_BATCH 16
+
+// Parquet encoding ids, as written in the page headers and column metadata
+#define PARQUET_ENCODING_PLAIN 0
+#define PARQUET_ENCODING_BIT_PACKED 4
+#define PARQUET_ENCODING_DELTA_BINARY_PACKED 5
+#define PARQUET_ENCODING_DELTA_LENGTH_BYTE_ARRAY 6
+
+namespace ptoa{
+
+/**
+ * Class that writes Parquet files with exactly the layout that SWParquetReader and the hardware expect: a single required column
+ * in a single uncompressed row group, v1 data page headers without CRC or statistics and, for the delta encodings, blocks of
+ * BLOCK_SIZE values in MINIBLOCKS_IN_BLOCK miniblocks, unless set_delta_options picks another geometry. Every page holds
+ * values_per_page values, except for the last one. Pages are encoded by num_threads threads and written in order.
+ */
+class SWParquetWriter {
+  public:
+    SWParquetWriter(std::string file_path, int num_threads = 1);
+    // Block geometry and bit width limit of the DELTA and DELTA_LENGTH pages written after this call
+    void set_delta_options(const delta_options& options);
+    status write_prim(int32_t prim_width, const uint8_t* values, int64_t num_values, int32_t values_per_page, encoding enc, std::string column_name = "int");
+    status write_prim(int32_t prim_width, const std::shared_ptr<arrow::PrimitiveArray>& prim_array, int32_t values_per_page, encoding enc, std::string column_name = "int");
+    status write_string(const int32_t* offsets, const uint8_t* chars, int64_t num_strings, int32_t values_per_page, encoding enc, std::string column_name = "str");
+    status write_string(const std::shared_ptr<arrow::StringArray>& string_array, int32_t values_per_page, encoding enc, std::string column_name = "str");
+
+    // File offset of the first page of the last written column, as passed to the read functions of SWParquetReader
+    int64_t get_file_offset() const {return file_offset;}
+    // Size of all pages of the last written column, starting at get_file_offset
+    int64_t get_pages_size() const {return pages_size;}
+    int64_t get_file_size() const {return file_size;}
+
+  private:
+    // A column chunk being written, filled in by write_pages and used by write_footer
+    struct column_chunk {
+        std::string name;
+        int32_t physical_type;
+        bool is_string;
+        int32_t parquet_encoding;
+        int64_t num_values;
+        int64_t total_size;
+    };
+
+    template<typename F>
+    status write_pages(std::ofstream& file, int64_t num_values, int32_t values_per_page, column_chunk* chunk, F encode_page);
+    status write_footer(std::ofstream& file, const column_chunk& chunk);
+    status open_file(std::ofstream& file);
+
+    std::string file_path;
+    int num_threads;
+    DeltaEncoder delta_encoder;
+    int64_t file_offset;
+    int64_t pages_size;
+    int64_t file_size;
+};
+
+}
@@ -0,0 +1,153 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Scoped per-stage instrumentation of the decode loops in SWParquetReader. Compile with -DPTOA_PROFILE_STAGES to enable it,
+ * otherwise all PTOA_STAGE* macros expand to nothing.
+ *
+ * When enabled, every PTOA_STAGE scope adds its cycles to a thread local total for that stage and PTOA_STAGE_REPORT prints
+ * the totals of one read to std::cerr when it goes out of scope. Reading the cycle counter costs a few tens of cycles, which
+ * is significant next to a single 32 value miniblock, so only compare stage times with each other within a profiled build.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef PTOA_PROFILE_STAGES
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+#endif
+
+namespace ptoa {
+
+enum stage {
+    STAGE_METADATA = 0,
+    STAGE_BLOCK_HEADER,
+    STAGE_UNPACK,
+    STAGE_ACCUMULATE,
+    STAGE_PAGE_SKIP,
+    STAGE_COPY,
+    NUM_STAGES
+};
+
+enum stage_count {
+    COUNT_PAGES = 0,
+    COUNT_BLOCKS,
+    COUNT_MINIBLOCKS,
+    COUNT_BYTES_COPIED,
+    NUM_STAGE_COUNTS
+};
+
+#ifdef PTOA_PROFILE_STAGES
+
+struct stage_stats {
+    uint64_t cycles[NUM_STAGES];
+    uint64_t counts[NUM_STAGE_COUNTS];
+    int report_depth;
+};
+
+inline stage_stats& thread_stage_stats() {
+    static thread_local stage_stats stats = {{0}, {0}, 0};
+    return stats;
+}
+
+// TSC cycles on x86, nanoseconds elsewhere
+inline uint64_t stage_clock() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+class stage_scope {
+  public:
+    explicit stage_scope(stage s) : s(s), start(stage_clock()) {}
+    ~stage_scope() { thread_stage_stats().cycles[s] += stage_clock() - start; }
+
+  private:
+    stage s;
+    uint64_t start;
+};
+
+// Resets the stage totals of this thread and prints them when the outermost report goes out of scope
+class stage_report {
+  public:
+    explicit stage_report(const char* name) : name(name), start(stage_clock()) {
+        stage_stats& stats = thread_stage_stats();
+        if(stats.report_depth++ == 0) {
+            for(uint64_t& cycles : stats.cycles) {
+                cycles = 0;
+            }
+            for(uint64_t& count : stats.counts) {
+                count = 0;
+            }
+        }
+    }
+
+    ~stage_report() {
+        stage_stats& stats = thread_stage_stats();
+        if(--stats.report_depth > 0) {
+            return;
+        }
+
+        static const char* stage_names[NUM_STAGES] = {"metadata", "block header", "unpack", "accumulate", "page skip", "copy"};
+        uint64_t total = stage_clock() - start;
+        uint64_t staged = 0;
+        std::ostringstream out;
+
+        out << "[STAGES] " << name << ": " << total << " cycles" << std::endl;
+        out << std::fixed << std::setprecision(1);
+        for(int i=0; i<NUM_STAGES; i++) {
+            staged += stats.cycles[i];
+            out << "    " << std::left << std::setw(14) << stage_names[i] << std::right << std::setw(14) << stats.cycles[i]
+                << " (" << std::setw(5) << (total > 0 ? 100.0*stats.cycles[i]/total : 0.0) << "%)" << std::endl;
+        }
+        uint64_t other = total > staged ? total - staged : 0;
+        out << "    " << std::left << std::setw(14) << "other" << std::right << std::setw(14) << other
+            << " (" << std::setw(5) << (total > 0 ? 100.0*other/total : 0.0) << "%)" << std::endl;
+        out << "    pages " << stats.counts[COUNT_PAGES] << ", blocks " << stats.counts[COUNT_BLOCKS]
+            << ", miniblocks " << stats.counts[COUNT_MINIBLOCKS] << ", bytes copied " << stats.counts[COUNT_BYTES_COPIED] << std::endl;
+
+        // One write, so reports of concurrent reads don't interleave
+        std::cerr << out.str();
+    }
+
+  private:
+    const char* name;
+    uint64_t start;
+};
+
+#define PTOA_STAGE_CONCAT_(a, b) a##b
+#define PTOA_STAGE_CONCAT(a, b) PTOA_STAGE_CONCAT_(a, b)
+
+#define PTOA_STAGE(s) ptoa::stage_scope PTOA_STAGE_CONCAT(stage_scope_, __LINE__)(ptoa::s)
+#define PTOA_STAGE_COUNT(c, n) (ptoa::thread_stage_stats().counts[ptoa::c] += (n))
+#define PTOA_STAGE_REPORT(name) ptoa::stage_report PTOA_STAGE_CONCAT(stage_report_, __LINE__)(name)
+
+#else
+
+#define PTOA_STAGE(s) do {} while(0)
+#define PTOA_STAGE_COUNT(c, n) do {} while(0)
+#define PTOA_STAGE_REPORT(name) do {} while(0)
+
+#endif
+
+}
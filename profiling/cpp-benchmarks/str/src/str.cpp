@@ -13,19 +13,26 @@
 #include <iostream>
 #include <iomanip>
 
+#include <arrow/util/config.h>
 #include <parquet/arrow/reader.h>
 
 #include <SWParquetReader.h>
 #include <timer.h>
+#include <trace.h>
+#include <results.h>
 
 //Use standard Arrow library functions to read Arrow array from Parquet file
 //Only works for Parquet version 1 style files.
 std::shared_ptr<arrow::Array> readArray(std::string hw_input_file_path) {
   std::shared_ptr<arrow::io::ReadableFile> infile;
-  PARQUET_THROW_NOT_OK(arrow::io::ReadableFile::Open(hw_input_file_path, arrow::default_memory_pool(), &infile));
+  PARQUET_ASSIGN_OR_THROW(infile, arrow::io::ReadableFile::Open(hw_input_file_path, arrow::default_memory_pool()));
   
   std::unique_ptr<parquet::arrow::FileReader> reader;
+#if ARROW_VERSION_MAJOR >= 19
+  PARQUET_ASSIGN_OR_THROW(reader, parquet::arrow::OpenFile(infile, arrow::default_memory_pool()));
+#else
   PARQUET_THROW_NOT_OK(parquet::arrow::OpenFile(infile, arrow::default_memory_pool(), &reader));
+#endif
 
   std::shared_ptr<arrow::ChunkedArray> carray;
   PARQUET_THROW_NOT_OK(reader->ReadColumn(0, &carray));
@@ -34,7 +41,7 @@ std::shared_ptr<arrow::Array> readArray(std::string hw_input_file_path) {
 }
 
 int main(int argc, char **argv) {
-    int num_strings;
+    int64_t num_strings;
     char* hw_input_file_path;
     char* reference_parquet_file_path;
     int iterations;
@@ -45,7 +52,7 @@ int main(int argc, char **argv) {
     if (argc > 5) {
       hw_input_file_path = argv[1];
       reference_parquet_file_path = argv[2];
-      num_strings = (uint32_t) std::strtoul(argv[3], nullptr, 10);
+      num_strings = std::strtoll(argv[3], nullptr, 10);
       iterations = (uint32_t) std::strtoul(argv[4], nullptr, 10);
       if(argv[5][0] == 'y') {
         verify_output = true;
@@ -60,6 +67,12 @@ int main(int argc, char **argv) {
       return 1;
     }
 
+    // Set PTOA_TRACE to a file path to write a Chrome trace of the reads
+    Trace::global().enable_from_env();
+    // Set PTOA_RESULTS to a .json or .csv path to append the timings for compare_results.py
+    Results::global().enable_from_env();
+    Results::config results_config = {{"file", hw_input_file_path}, {"strings", std::to_string(num_strings)}};
+
     ptoa::SWParquetReader reader(hw_input_file_path);
     //reader.inspect_metadata(4);
     reader.count_pages(4);
@@ -68,7 +81,7 @@ int main(int argc, char **argv) {
     auto correct_array = std::dynamic_pointer_cast<arrow::StringArray>(readArray(std::string(reference_parquet_file_path)));
 
     // Get total amount of characters from string array for buffer allocation
-    int num_chars = correct_array->value_offset(num_strings);
+    int64_t num_chars = correct_array->value_offset(num_strings);
 
     std::shared_ptr<arrow::StringArray> result_array;
     std::shared_ptr<arrow::Buffer> off_buffer;
@@ -86,13 +99,16 @@ int main(int argc, char **argv) {
 
     std::cout << "Read " << num_strings << " strings" << std::endl;
     std::cout << "Average time in seconds (not pre-allocated): " << t.average() << std::endl;
+    Results::global().add("str", results_config, "seconds_allocating", t.samples());
 
     t.clear_history();
 
     // Only relevant for the benchmark with pre-allocated (and memset) buffer
-    arrow::AllocateBuffer((num_strings+1)*sizeof(int32_t), &off_buffer);
+    if(ptoa::allocate_buffer((num_strings+1)*sizeof(int32_t), &off_buffer) != ptoa::status::OK ||
+       ptoa::allocate_buffer(num_chars, &val_buffer) != ptoa::status::OK) {
+        return 1;
+    }
     std::memset((void*)(off_buffer->mutable_data()), 0, (num_strings+1)*sizeof(int32_t));
-    arrow::AllocateBuffer(num_chars, &val_buffer);
     std::memset((void*)(val_buffer->mutable_data()), 0, num_chars);
 
     for(int i=0; i<iterations; i++){
@@ -107,6 +123,26 @@ int main(int argc, char **argv) {
 
     std::cout << "Read " << num_strings << " strings" << std::endl;
     std::cout << "Average time in seconds (pre-allocated): " << t.average() << std::endl;
+    Results::global().add("str", results_config, "seconds_preallocated", t.samples());
+
+    t.clear_history();
+
+    // Strings as views into the Parquet file, characters of long strings are not copied
+    std::shared_ptr<arrow::Buffer> views;
+    std::vector<std::shared_ptr<arrow::Buffer>> data_buffers;
+
+    for(int i=0; i<iterations; i++){
+        t.start();
+        if(reader.read_string_view(num_strings, 4, &views, &data_buffers, ptoa::encoding::DELTA_LENGTH) != ptoa::status::OK){
+            return 1;
+        }
+        t.stop();
+        t.record();
+    }
+
+    std::cout << "Read " << num_strings << " strings" << std::endl;
+    std::cout << "Average time in seconds (views): " << t.average() << std::endl;
+    Results::global().add("str", results_config, "seconds_views", t.samples());
 
     if(verify_output) {
         //std::cout<<"Num chars: "<<num_chars<<std::endl;
@@ -115,7 +151,7 @@ int main(int argc, char **argv) {
         // Verify result
         int error_count = 0;
     
-        for(int i=0; i<num_strings; i++) {
+        for(int64_t i=0; i<num_strings; i++) {
             if(result_array->GetString(i).compare(correct_array->GetString(i)) != 0) {
               error_count++;
               if(error_count<20) {
@@ -134,7 +170,7 @@ int main(int argc, char **argv) {
           std::cout << "Test failed. Found " << error_count << " errors in the output Arrow array" << std::endl;
         }
     }
-    
-    
 
+    Trace::global().write();
+    Results::global().write();
 }
@@ -0,0 +1,117 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Checks that AsyncParquetReader returns the same values as the in-memory SWParquetReader. Segments of a single alignment
+ * block make pages and page headers cross segment boundaries, large segments hold many pages each.
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Before SWParquetReader.h, AsyncParquetReader.h undoes the BLOCK_SIZE of linux/fs.h
+#include <AsyncParquetReader.h>
+#include <SWParquetReader.h>
+#include <SWParquetWriter.h>
+
+#define TEST_FILE_PATH "async_reader_test.parquet"
+// Not a multiple of any page size, so the last page is partially filled
+#define TEST_NUM_VALUES 100003
+#define TEST_QUEUE_DEPTH 4
+
+// Compare the values read by both readers with each other and with the values that were written. Returns the number of errors.
+int check_column(int32_t prim_width, ptoa::encoding enc, int32_t values_per_page, int32_t segment_size, const std::vector<int64_t>& values) {
+    std::vector<uint8_t> expected(values.size()*prim_width/8);
+    for(size_t i=0; i<values.size(); i++) {
+        if(prim_width == 64) {
+            ((int64_t*) expected.data())[i] = values[i];
+        } else {
+            ((int32_t*) expected.data())[i] = (int32_t) values[i];
+        }
+    }
+
+    ptoa::SWParquetWriter writer(TEST_FILE_PATH);
+    if(writer.write_prim(prim_width, expected.data(), values.size(), values_per_page, enc) != ptoa::status::OK) {
+        std::cerr << "[ERROR] Could not write " << TEST_FILE_PATH << std::endl;
+        return 1;
+    }
+
+    std::shared_ptr<arrow::PrimitiveArray> sw_array;
+    ptoa::SWParquetReader sw_reader(TEST_FILE_PATH);
+    if(sw_reader.read_prim(prim_width, values.size(), writer.get_file_offset(), &sw_array, enc) != ptoa::status::OK) {
+        std::cerr << "[ERROR] SWParquetReader could not read " << TEST_FILE_PATH << std::endl;
+        return 1;
+    }
+
+    // Read twice to check that the segment buffers are reusable after a read
+    int errors = 0;
+    ptoa::AsyncParquetReader async_reader(TEST_FILE_PATH, TEST_QUEUE_DEPTH, segment_size);
+    for(int run=0; run<2; run++) {
+        std::shared_ptr<arrow::PrimitiveArray> async_array;
+        if(async_reader.read_prim(prim_width, values.size(), writer.get_file_offset(), &async_array, enc) != ptoa::status::OK) {
+            std::cerr << "[ERROR] AsyncParquetReader could not read " << TEST_FILE_PATH << std::endl;
+            return errors + 1;
+        }
+
+        if(async_array->length() != sw_array->length()
+           || memcmp(async_array->values()->data(), sw_array->values()->data(), expected.size()) != 0) {
+            std::cerr << "[ERROR] AsyncParquetReader and SWParquetReader disagree" << std::endl;
+            errors++;
+        }
+    }
+
+    if(memcmp(sw_array->values()->data(), expected.data(), expected.size()) != 0) {
+        std::cerr << "[ERROR] SWParquetReader did not return the written values" << std::endl;
+        errors++;
+    }
+
+    if(errors != 0) {
+        std::cerr << "        prim_width " << prim_width << ", " << (enc == ptoa::encoding::DELTA ? "delta" : "plain")
+                  << ", " << values_per_page << " values per page, segment size " << segment_size << std::endl;
+    }
+
+    return errors;
+}
+
+int main() {
+    // Values of varying bit widths, so delta blocks don't all use the same miniblock width
+    std::vector<int64_t> values(TEST_NUM_VALUES);
+    uint64_t state = 12345;
+    for(size_t i=0; i<values.size(); i++) {
+        state = state*6364136223846793005ull + 1442695040888963407ull;
+        values[i] = (int64_t) (state >> (i % 64));
+    }
+
+    const int32_t prim_widths[] = {32, 64};
+    const ptoa::encoding encodings[] = {ptoa::encoding::PLAIN, ptoa::encoding::DELTA};
+    const int32_t page_sizes[] = {1000, 32768};
+    const int32_t segment_sizes[] = {DIRECT_IO_ALIGNMENT, 1 << 20};
+
+    int errors = 0;
+    for(int32_t prim_width : prim_widths) {
+        for(ptoa::encoding enc : encodings) {
+            for(int32_t values_per_page : page_sizes) {
+                for(int32_t segment_size : segment_sizes) {
+                    errors += check_column(prim_width, enc, values_per_page, segment_size, values);
+                }
+            }
+        }
+    }
+    std::remove(TEST_FILE_PATH);
+
+    if(errors == 0) {
+        std::cout << "Test passed!" << std::endl;
+    }
+    return errors == 0 ? 0 : 1;
+}
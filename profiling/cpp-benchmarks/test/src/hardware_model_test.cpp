@@ -0,0 +1,101 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Checks that the hardware model the writer tunes page sizes with has an optimum between the smallest and the largest candidate
+ * for pipelined reads. Page headers favor large pages, the copies that can't overlap with decoding favor pages smaller than a
+ * segment. Without pipelining the whole column is copied at once anyway, so the largest page is best.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <vector>
+
+#include <SWParquetWriter.h>
+#include <SWParquetReader.h>
+#include <HardwareModel.h>
+
+#define TEST_FILE_PATH "hardware_model_test.parquet"
+#define TEST_NUM_VALUES (1 << 20)
+#define TEST_SEGMENT_SIZE (1 << 20)
+// Candidates like those of the writer's tuning mode
+#define TEST_MIN_VALUES_PER_PAGE 1024
+#define TEST_STEP 4
+#define TEST_ELEMENTS_PER_CYCLE 16
+
+// Returns the index of the candidate with the fewest cycles, or -1 on failure
+int best_candidate(const std::vector<int32_t>& values, int64_t segment_size) {
+    int best = -1;
+    int64_t best_cycles = 0;
+    int index = 0;
+
+    for(int64_t values_per_page = TEST_MIN_VALUES_PER_PAGE; values_per_page <= TEST_NUM_VALUES; values_per_page *= TEST_STEP, index++) {
+        ptoa::SWParquetWriter writer(TEST_FILE_PATH);
+        if(writer.write_prim(32, (const uint8_t*) values.data(), values.size(), values_per_page, ptoa::encoding::PLAIN) != ptoa::status::OK) {
+            return -1;
+        }
+
+        ptoa::SWParquetReader reader(TEST_FILE_PATH);
+        if(reader.build_page_directory(writer.get_file_offset()) != ptoa::status::OK) {
+            return -1;
+        }
+
+        int64_t cycles = ptoa::hw_read_cycles(reader.get_page_directory(), values.size(), 32, segment_size,
+                                              ptoa::hw_plain_cycles(values.size(), TEST_ELEMENTS_PER_CYCLE));
+        std::cout << std::setw(16) << values_per_page << std::setw(14) << segment_size << std::setw(14) << cycles << std::endl;
+
+        if(best < 0 || cycles < best_cycles) {
+            best = index;
+            best_cycles = cycles;
+        }
+    }
+
+    return best;
+}
+
+int main() {
+    std::vector<int32_t> values(TEST_NUM_VALUES);
+    for(size_t i=0; i<values.size(); i++) {
+        values[i] = (int32_t) (i*2654435761u);
+    }
+
+    int num_candidates = 0;
+    for(int64_t values_per_page = TEST_MIN_VALUES_PER_PAGE; values_per_page <= TEST_NUM_VALUES; values_per_page *= TEST_STEP) {
+        num_candidates++;
+    }
+
+    std::cout << std::setw(16) << "values_per_page" << std::setw(14) << "segment_size" << std::setw(14) << "cycles" << std::endl;
+    int pipelined_best = best_candidate(values, TEST_SEGMENT_SIZE);
+    int unpipelined_best = best_candidate(values, 0);
+    std::remove(TEST_FILE_PATH);
+
+    if(pipelined_best < 0 || unpipelined_best < 0) {
+        std::cerr << "[ERROR] Could not write or read the candidates" << std::endl;
+        return 1;
+    }
+
+    int errors = 0;
+    if(pipelined_best == 0 || pipelined_best == num_candidates - 1) {
+        std::cerr << "[ERROR] Pipelined reads are fastest with candidate " << pipelined_best << ", expected one between the smallest and the largest" << std::endl;
+        errors++;
+    }
+    if(unpipelined_best != num_candidates - 1) {
+        std::cerr << "[ERROR] Reads without pipelining are fastest with candidate " << unpipelined_best << ", expected the largest" << std::endl;
+        errors++;
+    }
+
+    if(errors == 0) {
+        std::cout << "Test passed!" << std::endl;
+    }
+    return errors == 0 ? 0 : 1;
+}
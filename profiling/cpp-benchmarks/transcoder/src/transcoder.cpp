@@ -0,0 +1,366 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Rewrites columns of any Parquet file into the layout the hardware accepts: one required column per file, in a single row
+ * group, v1 page headers without dictionary and the first page at offset 4. The input is read with parquet::arrow, so any
+ * encoding, compression, page version and row group layout works. Only flat INT32, INT64 and BYTE_ARRAY columns without nulls
+ * can be transcoded, other columns are skipped.
+ *
+ * Every column is written to output_directory/<column>_<name>.parquet. The next column is read with Arrow while the current one
+ * is encoded by num_threads threads. An index of the written files, their page offsets and sizes and value counts is written
+ * to output_directory/index.tsv, see ColumnIndex.h.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <arrow/util/config.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/exception.h>
+#include <parquet/file_reader.h>
+#include <parquet/metadata.h>
+#include <parquet/schema.h>
+
+#include <SWParquetWriter.h>
+#include <ColumnIndex.h>
+#include <timer.h>
+
+#define DEFAULT_VALUES_PER_PAGE 100000
+#define INDEX_FILE_NAME "index.tsv"
+
+// A column of the input file that can be transcoded
+struct column_job {
+    int column;
+    std::string name;
+    int32_t prim_width;
+    std::shared_ptr<arrow::ChunkedArray> data;
+    bool read_ok;
+};
+
+// Characters other than letters, digits, '-', '_' and '.' are replaced, so column names can be used in file names
+std::string file_name_for(int column, const std::string& name) {
+    std::ostringstream file_name;
+    file_name << column << "_";
+    for(char c : name) {
+        file_name << ((isalnum((unsigned char) c) || c == '-' || c == '_' || c == '.') ? c : '_');
+    }
+    file_name << ".parquet";
+    return file_name.str();
+}
+
+void read_column(parquet::arrow::FileReader* reader, column_job* job) {
+    arrow::Status status = reader->ReadColumn(job->column, &job->data);
+    job->read_ok = status.ok();
+    if(!status.ok()) {
+        std::cerr << "[ERROR] Could not read column " << job->name << ": " << status.message() << std::endl;
+    }
+}
+
+// SWParquetWriter writes from contiguous memory. Columns of more than one row group are read into more than one chunk, which
+// are copied into a single buffer.
+bool flatten_prim(const arrow::ChunkedArray& chunked, int32_t prim_width, std::shared_ptr<arrow::Buffer>* values, const uint8_t** values_ptr) {
+    const int64_t value_size = prim_width/8;
+
+    if(chunked.num_chunks() == 1) {
+        auto array = std::static_pointer_cast<arrow::PrimitiveArray>(chunked.chunk(0));
+        *values_ptr = array->values()->data() + array->offset()*value_size;
+        return true;
+    }
+
+    arrow::Result<std::unique_ptr<arrow::Buffer>> result = arrow::AllocateBuffer(chunked.length()*value_size);
+    if(!result.ok()) {
+        std::cerr << "[ERROR] Could not allocate " << chunked.length()*value_size << " bytes" << std::endl;
+        return false;
+    }
+    *values = std::move(result).ValueOrDie();
+    uint8_t* out = (*values)->mutable_data();
+    for(int c=0; c<chunked.num_chunks(); c++) {
+        auto array = std::static_pointer_cast<arrow::PrimitiveArray>(chunked.chunk(c));
+        memcpy(out, array->values()->data() + array->offset()*value_size, array->length()*value_size);
+        out += array->length()*value_size;
+    }
+    *values_ptr = (*values)->data();
+    return true;
+}
+
+// BYTE_ARRAY columns are read as either StringArray or BinaryArray, which have the same layout
+bool flatten_strings(const arrow::ChunkedArray& chunked, std::shared_ptr<arrow::Buffer>* offsets, std::shared_ptr<arrow::Buffer>* chars,
+                     const int32_t** offsets_ptr, const uint8_t** chars_ptr) {
+    if(chunked.num_chunks() == 1) {
+        auto array = std::static_pointer_cast<arrow::StringArray>(chunked.chunk(0));
+        *offsets_ptr = array->raw_value_offsets();
+        *chars_ptr = array->value_data()->data();
+        return true;
+    }
+
+    int64_t num_chars = 0;
+    for(int c=0; c<chunked.num_chunks(); c++) {
+        auto array = std::static_pointer_cast<arrow::StringArray>(chunked.chunk(c));
+        num_chars += array->value_offset(array->length()) - array->value_offset(0);
+    }
+    if(num_chars > std::numeric_limits<int32_t>::max()) {
+        std::cerr << "[ERROR] " << num_chars << " characters don't fit in 32 bit offsets" << std::endl;
+        return false;
+    }
+
+    arrow::Result<std::unique_ptr<arrow::Buffer>> offsets_result = arrow::AllocateBuffer((chunked.length() + 1)*sizeof(int32_t));
+    arrow::Result<std::unique_ptr<arrow::Buffer>> chars_result = arrow::AllocateBuffer(num_chars);
+    if(!offsets_result.ok() || !chars_result.ok()) {
+        std::cerr << "[ERROR] Could not allocate the string buffers" << std::endl;
+        return false;
+    }
+    *offsets = std::move(offsets_result).ValueOrDie();
+    *chars = std::move(chars_result).ValueOrDie();
+    int32_t* out_offsets = (int32_t*) (*offsets)->mutable_data();
+    uint8_t* out_chars = (*chars)->mutable_data();
+    int32_t position = 0;
+    for(int c=0; c<chunked.num_chunks(); c++) {
+        auto array = std::static_pointer_cast<arrow::StringArray>(chunked.chunk(c));
+        const int32_t* in_offsets = array->raw_value_offsets();
+        for(int64_t i=0; i<array->length(); i++) {
+            *(out_offsets++) = position + in_offsets[i] - in_offsets[0];
+        }
+        int32_t length = in_offsets[array->length()] - in_offsets[0];
+        memcpy(out_chars + position, array->value_data()->data() + in_offsets[0], length);
+        position += length;
+    }
+    *out_offsets = position;
+    *offsets_ptr = (const int32_t*) (*offsets)->data();
+    *chars_ptr = (*chars)->data();
+    return true;
+}
+
+// parquet::arrow reads a column as its logical type, which doesn't always have the layout of the physical type: INT32 columns
+// annotated INT_8 or INT_16 are read as 8 or 16 bit integers and DECIMAL columns as Decimal128. flatten_prim and flatten_strings
+// only take arrays with the layout of the physical type.
+bool has_physical_layout(const arrow::DataType& type, int32_t prim_width) {
+    switch(type.id()) {
+        case arrow::Type::INT32:
+        case arrow::Type::UINT32:
+            return prim_width == 32;
+        case arrow::Type::INT64:
+        case arrow::Type::UINT64:
+            return prim_width == 64;
+        case arrow::Type::STRING:
+        case arrow::Type::BINARY:
+            return prim_width == 0;
+        default:
+            return false;
+    }
+}
+
+bool transcode_column(const column_job& job, const std::string& output_directory, ptoa::encoding enc, int32_t values_per_page,
+                      int num_threads, ptoa::column_index_entry* entry) {
+    if(job.data->null_count() > 0) {
+        std::cerr << "[WARNING] Skipping column " << job.name << ", it has " << job.data->null_count() << " nulls" << std::endl;
+        return false;
+    }
+    if(!has_physical_layout(*job.data->type(), job.prim_width)) {
+        std::cerr << "[WARNING] Skipping column " << job.name << ", it is read as " << job.data->type()->ToString()
+                  << ", which doesn't have the layout of its physical type" << std::endl;
+        return false;
+    }
+
+    entry->column_name = job.name;
+    entry->file_name = file_name_for(job.column, job.name);
+    entry->prim_width = job.prim_width;
+    entry->num_values = job.data->length();
+    entry->num_chars = 0;
+    entry->values_per_page = values_per_page;
+
+    ptoa::SWParquetWriter writer(output_directory + "/" + entry->file_name, num_threads);
+    ptoa::status result;
+
+    if(job.prim_width == 0) {
+        std::shared_ptr<arrow::Buffer> offsets, chars;
+        const int32_t* offsets_ptr;
+        const uint8_t* chars_ptr;
+        if(!flatten_strings(*job.data, &offsets, &chars, &offsets_ptr, &chars_ptr)) {
+            return false;
+        }
+        // Neither SWParquetReader nor the hardware can read PLAIN strings
+        entry->enc = ptoa::encoding::DELTA_LENGTH;
+        entry->num_chars = offsets_ptr[entry->num_values] - offsets_ptr[0];
+        result = writer.write_string(offsets_ptr, chars_ptr, entry->num_values, values_per_page, entry->enc, job.name);
+    } else {
+        std::shared_ptr<arrow::Buffer> values;
+        const uint8_t* values_ptr;
+        if(!flatten_prim(*job.data, job.prim_width, &values, &values_ptr)) {
+            return false;
+        }
+        entry->enc = enc;
+        result = writer.write_prim(job.prim_width, values_ptr, entry->num_values, values_per_page, entry->enc, job.name);
+    }
+
+    if(result != ptoa::status::OK) {
+        return false;
+    }
+
+    entry->file_offset = writer.get_file_offset();
+    entry->pages_size = writer.get_pages_size();
+    return true;
+}
+
+int main(int argc, char **argv) {
+    std::string input_file_path;
+    std::string output_directory;
+    std::vector<std::string> column_names;
+    ptoa::encoding enc = ptoa::encoding::DELTA;
+    int32_t values_per_page = DEFAULT_VALUES_PER_PAGE;
+    int num_threads = 1;
+
+    if (argc >= 3) {
+      input_file_path = argv[1];
+      output_directory = argv[2];
+      if(argc >= 4 && strcmp(argv[3], "all") != 0) {
+        std::istringstream names(argv[3]);
+        std::string name;
+        while(std::getline(names, name, ',')) {
+          column_names.push_back(name);
+        }
+      }
+      if(argc >= 5) {
+        if(!strncmp(argv[4], "delta", 5)) {
+          enc = ptoa::encoding::DELTA;
+        } else if (!strncmp(argv[4], "plain", 5)) {
+          enc = ptoa::encoding::PLAIN;
+        } else {
+          std::cerr << "Invalid argument. Option \"encoding\" should be \"delta\" or \"plain\"" << std::endl;
+          return 1;
+        }
+      }
+      if(argc >= 6) {
+        values_per_page = std::atoi(argv[5]);
+      }
+      if(argc >= 7) {
+        num_threads = std::atoi(argv[6]);
+      }
+    } else {
+      std::cerr << "Usage: transcoder input_parquet_file_path output_directory [columns(comma separated names or all)] "
+                << "[encoding(delta or plain)] [values_per_page] [num_threads]" << std::endl;
+      std::cerr << "The encoding applies to integer columns, delta meaning DELTA_BINARY_PACKED. String columns are always written with "
+                << "DELTA_LENGTH_BYTE_ARRAY encoding. values_per_page defaults to " << DEFAULT_VALUES_PER_PAGE << "." << std::endl;
+      return 1;
+    }
+
+    if(mkdir(output_directory.c_str(), 0755) != 0 && errno != EEXIST) {
+      std::cerr << "[ERROR] Could not create " << output_directory << ": " << strerror(errno) << std::endl;
+      return 1;
+    }
+
+    std::shared_ptr<arrow::io::ReadableFile> infile;
+    PARQUET_ASSIGN_OR_THROW(infile, arrow::io::ReadableFile::Open(input_file_path, arrow::default_memory_pool()));
+    std::unique_ptr<parquet::arrow::FileReader> reader;
+#if ARROW_VERSION_MAJOR >= 19
+    PARQUET_ASSIGN_OR_THROW(reader, parquet::arrow::OpenFile(infile, arrow::default_memory_pool()));
+#else
+    PARQUET_THROW_NOT_OK(parquet::arrow::OpenFile(infile, arrow::default_memory_pool(), &reader));
+#endif
+    std::shared_ptr<parquet::FileMetaData> metadata = parquet::ParquetFileReader::OpenFile(input_file_path)->metadata();
+    const parquet::SchemaDescriptor* schema = metadata->schema();
+
+    // Leaf columns of a flat schema are also the top level fields that ReadColumn takes
+    std::vector<column_job> jobs;
+    for(int column=0; column<schema->num_columns(); column++) {
+      const parquet::ColumnDescriptor* descriptor = schema->Column(column);
+      bool selected = column_names.empty() ||
+                      std::find(column_names.begin(), column_names.end(), descriptor->name()) != column_names.end();
+      if(!selected) {
+        continue;
+      }
+
+      column_job job;
+      job.column = column;
+      job.name = descriptor->name();
+      job.read_ok = false;
+      if(descriptor->max_repetition_level() > 0) {
+        std::cerr << "[WARNING] Skipping column " << job.name << ", it is a repeated column" << std::endl;
+        continue;
+      }
+      switch(descriptor->physical_type()) {
+        case parquet::Type::INT32:
+          job.prim_width = 32;
+          break;
+        case parquet::Type::INT64:
+          job.prim_width = 64;
+          break;
+        case parquet::Type::BYTE_ARRAY:
+          job.prim_width = 0;
+          break;
+        default:
+          std::cerr << "[WARNING] Skipping column " << job.name << ", it has an unsupported physical type" << std::endl;
+          continue;
+      }
+      jobs.push_back(job);
+    }
+
+    if(jobs.empty()) {
+      std::cerr << "[ERROR] None of the selected columns can be transcoded" << std::endl;
+      return 1;
+    }
+    // A group with a single leaf has as many leaves as top level fields, so every top level field has to be a leaf itself
+    const parquet::schema::GroupNode* root = schema->group_node();
+    for(int field=0; field<root->field_count(); field++) {
+      if(!root->field(field)->is_primitive()) {
+        std::cerr << "[ERROR] Only files with a flat schema can be transcoded, " << root->field(field)->name() << " is a group" << std::endl;
+        return 1;
+      }
+    }
+
+    Timer t;
+    t.start();
+
+    std::vector<ptoa::column_index_entry> entries;
+    std::thread read_thread(read_column, reader.get(), &jobs[0]);
+
+    for(size_t j=0; j<jobs.size(); j++) {
+      read_thread.join();
+      if(j + 1 < jobs.size()) {
+        read_thread = std::thread(read_column, reader.get(), &jobs[j + 1]);
+      }
+
+      ptoa::column_index_entry entry;
+      if(jobs[j].read_ok && transcode_column(jobs[j], output_directory, enc, values_per_page, num_threads, &entry)) {
+        entries.push_back(entry);
+        std::cout << "Transcoded " << entry.column_name << " to " << entry.file_name << ": " << entry.num_values << " values, "
+                  << entry.pages_size << " bytes of pages" << std::endl;
+      } else {
+        std::cerr << "[WARNING] Column " << jobs[j].name << " was not transcoded" << std::endl;
+      }
+
+      // Free the column before the next one is read
+      jobs[j].data.reset();
+    }
+
+    t.stop();
+
+    if(write_column_index(output_directory + "/" + INDEX_FILE_NAME, entries) != ptoa::status::OK) {
+      return 1;
+    }
+
+    std::cout << "Transcoded " << entries.size() << " of " << jobs.size() << " columns in " << std::setprecision(3) << t.seconds()
+              << " s, index written to " << output_directory << "/" << INDEX_FILE_NAME << std::endl;
+
+    return entries.size() == jobs.size() ? 0 : 1;
+}
@@ -0,0 +1,391 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Generates a synthetic column with datagen and writes it with SWParquetWriter, in the layout the benchmarks and the hardware
+ * expect. Replaces converting parquet-cpp output with the Java parquet-mr-custom project. Optionally also writes the same column
+ * with parquet-cpp, as the reference_parquet_file_path of the prim and str benchmarks.
+ *
+ * With values_per_page auto_cpu or auto_hw, integer columns are written with every candidate page size from
+ * TUNE_MIN_VALUES_PER_PAGE up. Each candidate is decoded page by page by num_threads threads with SWParquetReader, and the
+ * time of a pipelined hardware read is predicted with HardwareModel.h. The page size with the best throughput on the target is
+ * used for the output file.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cstdio>
+#include <limits>
+#include <atomic>
+#include <thread>
+
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <parquet/arrow/writer.h>
+#include <parquet/exception.h>
+
+#include <SWParquetWriter.h>
+#include <SWParquetReader.h>
+#include <HardwareModel.h>
+#include <datagen.h>
+#include <timer.h>
+
+#define DEFAULT_VALUES_PER_PAGE 100000
+
+// Candidate page sizes of the tuning mode, from the minimum up in steps of TUNE_STEP until a page holds the whole column
+#define TUNE_MIN_VALUES_PER_PAGE 1024
+#define TUNE_STEP 4
+// Decoding runs per candidate, the fastest one counts
+#define TUNE_REPETITIONS 5
+// The hardware model uses the decoder of the prim*_delta_decw_128 variants and the values per cycle of the prim32 and prim64 examples
+#define TUNE_HW_DEC_DATA_WIDTH 128
+#define TUNE_HW_ELEMENTS_PER_CYCLE(prim_width) ((prim_width) == 32 ? 16 : 8)
+// Segment size of the pipelined reads the hardware model assumes, see FpgaReader::set_segment_size. Pages larger than a segment
+// delay the start of decoding and the end of the last copy, which outweighs the saved page headers at some page size.
+#define TUNE_HW_SEGMENT_SIZE (1 << 20)
+
+enum class tune_target {NONE, CPU, HW};
+
+struct tune_result {
+    int32_t values_per_page;
+    int64_t num_pages;
+    int64_t file_size;
+    double cpu_seconds;
+    double hw_seconds;
+};
+
+// Writes the array as a single row group with parquet-cpp, without dictionary, compression or statistics
+void write_reference_file(const std::shared_ptr<arrow::Array>& array, const std::string& column_name, const std::string& file_path) {
+    std::shared_ptr<arrow::io::FileOutputStream> outfile;
+    PARQUET_ASSIGN_OR_THROW(outfile, arrow::io::FileOutputStream::Open(file_path));
+
+    parquet::WriterProperties::Builder builder;
+    builder.disable_statistics();
+    builder.disable_dictionary();
+    builder.compression(parquet::Compression::UNCOMPRESSED);
+
+    std::shared_ptr<arrow::Table> table = datagen::make_table(column_name, array);
+    PARQUET_THROW_NOT_OK(parquet::arrow::WriteTable(*table, arrow::default_memory_pool(), outfile, array->length(), builder.build()));
+}
+
+// Decodes all pages with num_threads threads that take pages from a shared counter, the way a multithreaded reader would split
+// the column with the page directory. Returns the fastest of TUNE_REPETITIONS runs.
+bool cpu_decode_seconds(const ptoa::SWParquetReader& directory_reader, const uint8_t* file, int32_t prim_width, ptoa::encoding enc,
+                        int64_t num_values, int num_threads, double* seconds) {
+    const std::vector<ptoa::page_directory_entry>& pages = directory_reader.get_page_directory();
+    std::vector<int64_t> first_values(pages.size() + 1, 0);
+    for(size_t p=0; p<pages.size(); p++) {
+        first_values[p + 1] = first_values[p] + pages[p].num_values;
+    }
+    if(first_values.back() != num_values) {
+        std::cerr << "[ERROR] The pages hold " << first_values.back() << " values instead of " << num_values << std::endl;
+        return false;
+    }
+
+    std::vector<uint8_t> out(num_values*prim_width/8);
+    std::atomic<bool> failed(false);
+    Timer t;
+
+    for(int it=0; it<TUNE_REPETITIONS; it++) {
+        std::atomic<size_t> next_page(0);
+        auto worker = [&]() {
+            ptoa::SWParquetReader page_decoder;
+            size_t p;
+            while((p = next_page++) < pages.size() && !failed) {
+                if(page_decoder.decode_page(prim_width, file + pages[p].offset, pages[p].num_values,
+                                            out.data() + first_values[p]*prim_width/8, enc) != ptoa::status::OK) {
+                    failed = true;
+                }
+            }
+        };
+
+        t.start();
+        std::vector<std::thread> threads;
+        for(int i=1; i<num_threads; i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for(std::thread& thread : threads) {
+            thread.join();
+        }
+        t.stop();
+        t.record();
+    }
+
+    *seconds = t.min();
+    return !failed;
+}
+
+bool hw_decode_seconds(ptoa::SWParquetReader& directory_reader, const uint8_t* file, int32_t prim_width, ptoa::encoding enc,
+                       int64_t num_values, double* seconds) {
+    const int elements_per_cycle = TUNE_HW_ELEMENTS_PER_CYCLE(prim_width);
+    const std::vector<ptoa::page_directory_entry>& pages = directory_reader.get_page_directory();
+    int64_t decode_cycles;
+
+    if(enc == ptoa::encoding::DELTA) {
+        std::vector<int64_t> bitwidth_counts(65, 0);
+        std::vector<ptoa::delta_block_info> blocks;
+
+        for(const ptoa::page_directory_entry& page : pages) {
+            int32_t page_num_values;
+            const uint8_t* end_ptr;
+            if(directory_reader.inspect_delta_page(prim_width, file + page.offset, &blocks, &page_num_values, &end_ptr) != ptoa::status::OK) {
+                return false;
+            }
+            for(const ptoa::delta_block_info& block : blocks) {
+                for(int i=0; i<block.num_miniblocks; i++) {
+                    bitwidth_counts[std::min((int) block.bitwidths[i], 64)]++;
+                }
+            }
+        }
+        decode_cycles = ptoa::hw_delta_cycles(bitwidth_counts, elements_per_cycle, TUNE_HW_DEC_DATA_WIDTH);
+    } else {
+        decode_cycles = ptoa::hw_plain_cycles(num_values, elements_per_cycle);
+    }
+
+    int64_t cycles = ptoa::hw_read_cycles(pages, num_values, prim_width, TUNE_HW_SEGMENT_SIZE, decode_cycles);
+    *seconds = cycles/(HW_CLOCK_MHZ*1e6);
+    return true;
+}
+
+bool measure_candidate(const std::string& file_path, int64_t file_offset, int32_t prim_width, ptoa::encoding enc, int64_t num_values,
+                       int num_threads, tune_result* result) {
+    ptoa::SWParquetReader reader(file_path);
+    if(reader.build_page_directory(file_offset) != ptoa::status::OK) {
+        return false;
+    }
+
+    // decode_page and inspect_delta_page accept pages anywhere in memory, so the pages are decoded straight from the file the reader loaded
+    const uint8_t* file = reader.get_file_data();
+
+    result->num_pages = reader.get_page_directory().size();
+    result->file_size = reader.get_file_size();
+    return cpu_decode_seconds(reader, file, prim_width, enc, num_values, num_threads, &result->cpu_seconds) &&
+           hw_decode_seconds(reader, file, prim_width, enc, num_values, &result->hw_seconds);
+}
+
+// Writes the column with every candidate page size to a temporary file next to the output file and returns the page size with the
+// best throughput on the target
+bool tune_values_per_page(const std::string& output_file_path, const std::shared_ptr<arrow::PrimitiveArray>& array, int32_t prim_width,
+                          ptoa::encoding enc, int num_threads, const ptoa::delta_options& delta_options, tune_target target, int32_t* values_per_page) {
+    const std::string tune_file_path = output_file_path + ".tune";
+    const int64_t num_values = array->length();
+    std::vector<tune_result> results;
+
+    for(int64_t candidate = TUNE_MIN_VALUES_PER_PAGE; ; candidate *= TUNE_STEP) {
+        tune_result result;
+        result.values_per_page = (int32_t) std::min(candidate, std::max(num_values, (int64_t) 1));
+
+        ptoa::SWParquetWriter writer(tune_file_path, num_threads);
+        writer.set_delta_options(delta_options);
+        if(writer.write_prim(prim_width, array, result.values_per_page, enc, "int") != ptoa::status::OK ||
+           !measure_candidate(tune_file_path, writer.get_file_offset(), prim_width, enc, num_values, num_threads, &result)) {
+            std::remove(tune_file_path.c_str());
+            return false;
+        }
+        results.push_back(result);
+
+        // Pages are limited to 2 GB
+        if(candidate >= num_values || candidate*TUNE_STEP*prim_width/8 > std::numeric_limits<int32_t>::max()) {
+            break;
+        }
+    }
+    std::remove(tune_file_path.c_str());
+
+    std::cout << std::setw(16) << "values_per_page" << std::setw(10) << "pages" << std::setw(14) << "file_bytes"
+              << std::setw(14) << "cpu_ms" << std::setw(16) << "cpu_Mvalues/s" << std::setw(14) << "hw_ms" << std::setw(16) << "hw_Mvalues/s" << std::endl;
+    size_t best = 0;
+    for(size_t r=0; r<results.size(); r++) {
+        const tune_result& result = results[r];
+        std::cout << std::setw(16) << result.values_per_page << std::setw(10) << result.num_pages << std::setw(14) << result.file_size
+                  << std::setw(14) << result.cpu_seconds*1e3 << std::setw(16) << num_values/result.cpu_seconds/1e6
+                  << std::setw(14) << result.hw_seconds*1e3 << std::setw(16) << num_values/result.hw_seconds/1e6 << std::endl;
+
+        double seconds = target == tune_target::CPU ? result.cpu_seconds : result.hw_seconds;
+        double best_seconds = target == tune_target::CPU ? results[best].cpu_seconds : results[best].hw_seconds;
+        if(seconds < best_seconds) {
+            best = r;
+        }
+    }
+
+    *values_per_page = results[best].values_per_page;
+    std::cout << "Best page size for " << (target == tune_target::CPU ? "the cpu with " + std::to_string(num_threads) + " threads" : std::string("the hardware model"))
+              << ": " << *values_per_page << " values per page" << std::endl;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    std::string output_file_path;
+    std::string type;
+    ptoa::encoding enc;
+    int64_t num_values;
+    int32_t values_per_page = DEFAULT_VALUES_PER_PAGE;
+    tune_target target = tune_target::NONE;
+    datagen::int_options int_options;
+    uint64_t seed = 0;
+    int num_threads = 1;
+    std::string reference_file_path;
+    ptoa::delta_options delta_options;
+
+    if (argc >= 5) {
+      output_file_path = argv[1];
+      type = argv[2];
+      if(type != "int32" && type != "int64" && type != "str") {
+        std::cerr << "Invalid argument. Option \"type\" should be \"int32\", \"int64\" or \"str\"" << std::endl;
+        return 1;
+      }
+      if(!strncmp(argv[3], "delta_length", 12)) {
+        enc = ptoa::encoding::DELTA_LENGTH;
+      } else if(!strncmp(argv[3], "delta", 5)) {
+        enc = ptoa::encoding::DELTA;
+      } else if (!strncmp(argv[3], "plain", 5)) {
+        enc = ptoa::encoding::PLAIN;
+      } else {
+        std::cerr << "Invalid argument. Option \"encoding\" should be \"delta\", \"plain\" or \"delta_length\"" << std::endl;
+        return 1;
+      }
+      num_values = std::strtoll(argv[4], nullptr, 10);
+      if(argc >= 6) {
+        if(!strcmp(argv[5], "auto_cpu")) {
+          target = tune_target::CPU;
+        } else if(!strcmp(argv[5], "auto_hw")) {
+          target = tune_target::HW;
+        } else {
+          values_per_page = std::atoi(argv[5]);
+        }
+      }
+      if(argc >= 7) {
+        std::string distribution = argv[6];
+        if(distribution == "uniform") {
+          int_options.distribution = datagen::UNIFORM;
+        } else if(distribution == "sorted") {
+          int_options.distribution = datagen::SORTED;
+        } else if(distribution == "walk") {
+          int_options.distribution = datagen::RANDOM_WALK;
+        } else if(distribution == "runs") {
+          int_options.distribution = datagen::RUNS;
+        } else if(distribution == "zipf") {
+          int_options.distribution = datagen::ZIPF;
+        } else if(distribution == "bitmix") {
+          int_options.distribution = datagen::BIT_WIDTH_MIX;
+        } else {
+          std::cerr << "Invalid argument. Option \"distribution\" should be \"uniform\", \"sorted\", \"walk\", \"runs\", \"zipf\" or \"bitmix\"" << std::endl;
+          return 1;
+        }
+      }
+      if(argc >= 8) {
+        seed = std::strtoull(argv[7], nullptr, 10);
+      }
+      if(argc >= 9) {
+        num_threads = std::atoi(argv[8]);
+      }
+      if(argc >= 10 && strcmp(argv[9], "-") != 0) {
+        reference_file_path = argv[9];
+      }
+      if(argc >= 11) {
+        delta_options.block_size = std::atoi(argv[10]);
+      }
+      if(argc >= 12) {
+        delta_options.miniblocks_in_block = std::atoi(argv[11]);
+      }
+      if(argc >= 13) {
+        delta_options.max_bitwidth = std::atoi(argv[12]);
+      }
+    } else {
+      std::cerr << "Usage: writer output_file_path type(int32, int64 or str) encoding(delta, plain or delta_length) num_values [values_per_page, auto_cpu or auto_hw] "
+                << "[distribution(uniform, sorted, walk, runs, zipf or bitmix)] [seed] [num_threads] [reference_parquet_file_path or -] "
+                << "[block_size] [miniblocks_in_block] [max_bitwidth]" << std::endl;
+      std::cerr << "values_per_page defaults to " << DEFAULT_VALUES_PER_PAGE << ", the distribution only applies to integer columns" << std::endl;
+      std::cerr << "auto_cpu and auto_hw pick the page size with the best decode throughput on the cpu with num_threads threads or on the "
+                << "hardware model, for integer columns" << std::endl;
+      std::cerr << "block_size and miniblocks_in_block default to " << BLOCK_SIZE << " and " << MINIBLOCKS_IN_BLOCK
+                << ", max_bitwidth to 0 (no limit). They should match the generics of the target hardware." << std::endl;
+      return 1;
+    }
+
+    // Neither SWParquetReader nor the hardware can read plain strings
+    if(type == "str" && enc != ptoa::encoding::DELTA_LENGTH) {
+      std::cerr << "String columns are written with delta_length encoding" << std::endl;
+      return 1;
+    }
+    if(type != "str" && enc != ptoa::encoding::PLAIN && enc != ptoa::encoding::DELTA) {
+      std::cerr << "Integer columns are written with plain or delta encoding" << std::endl;
+      return 1;
+    }
+    if(target != tune_target::NONE && type == "str") {
+      std::cerr << "Page size tuning is only supported for integer columns" << std::endl;
+      return 1;
+    }
+    // SWParquetReader and the hardware model decode DELTA_BINARY_PACKED blocks of the default geometry only, the timings of other
+    // geometries would be those of failed decodes
+    if(target != tune_target::NONE && (delta_options.block_size != BLOCK_SIZE || delta_options.miniblocks_in_block != MINIBLOCKS_IN_BLOCK)) {
+      std::cerr << "Page size tuning needs the default block_size " << BLOCK_SIZE << " and miniblocks_in_block " << MINIBLOCKS_IN_BLOCK << std::endl;
+      return 1;
+    }
+    if(type == "int64") {
+      int_options.max = std::numeric_limits<int64_t>::max();
+    }
+
+    Timer t;
+
+    t.start();
+    arrow::Result<std::shared_ptr<arrow::Array>> generated;
+    if(type == "int32") {
+      generated = datagen::generate_int32(num_values, int_options, seed, num_threads);
+    } else if(type == "int64") {
+      generated = datagen::generate_int64(num_values, int_options, seed, num_threads);
+    } else {
+      generated = datagen::generate_strings(num_values, datagen::string_options(), seed, num_threads);
+    }
+    t.stop();
+    if(!generated.ok()) {
+      std::cerr << "[ERROR] Could not generate the column: " << generated.status().ToString() << std::endl;
+      return 1;
+    }
+    std::shared_ptr<arrow::Array> array = generated.ValueOrDie();
+    std::cout << "Generated " << num_values << " values in " << t.seconds() << " s" << std::endl;
+
+    if(target != tune_target::NONE) {
+      t.start();
+      if(!tune_values_per_page(output_file_path, std::static_pointer_cast<arrow::PrimitiveArray>(array), type == "int32" ? 32 : 64, enc,
+                               num_threads, delta_options, target, &values_per_page)) {
+        return 1;
+      }
+      t.stop();
+      std::cout << "Tuned the page size in " << t.seconds() << " s" << std::endl;
+    }
+
+    ptoa::SWParquetWriter writer(output_file_path, num_threads);
+    writer.set_delta_options(delta_options);
+    ptoa::status result;
+
+    t.start();
+    if(type == "str") {
+      result = writer.write_string(std::static_pointer_cast<arrow::StringArray>(array), values_per_page, enc, "str");
+    } else {
+      result = writer.write_prim(type == "int32" ? 32 : 64, std::static_pointer_cast<arrow::PrimitiveArray>(array), values_per_page, enc, "int");
+    }
+    t.stop();
+    if(result != ptoa::status::OK) {
+      return 1;
+    }
+    std::cout << "Wrote " << output_file_path << ": " << writer.get_file_size() << " bytes in " << t.seconds() << " s ("
+              << std::setprecision(3) << writer.get_file_size()/t.seconds()/1e9 << " GB/s, " << t.seconds()*1e9/num_values << " ns/value), first page at offset " << writer.get_file_offset() << std::endl;
+
+    if(!reference_file_path.empty()) {
+      write_reference_file(array, type == "str" ? "str" : "int", reference_file_path);
+      std::cout << "Wrote reference file " << reference_file_path << std::endl;
+    }
+
+    return 0;
+}
@@ -28,7 +28,8 @@
 #include <fstream>
 #include <ctime>
 #include <cmath>
-#include <random>
+#include <limits>
+#include <thread>
 
 #include <arrow/api.h>
 #include <arrow/io/api.h>
@@ -42,290 +43,149 @@
 
 //Struct for timing code
 #include "../utils/timer.h"
+//Synthetic data generators
+#include "../utils/datagen.h"
 
-std::string gen_random_string(const int length) {
-    static const char alphanum[] =
-            "0123456789"
-            "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-            "abcdefghijklmnopqrstuvwxyz";
-
-    std::string result(length, 0);
+void write_binary_file(const std::shared_ptr<arrow::Buffer>& buffer, std::string filename) {
+    std::ofstream file(filename, std::ios::binary);
+    file.write((const char*) buffer->data(), buffer->size());
+}
 
-    for (int i = 0; i < length; ++i) {
-        result[i] = alphanum[rand() % (sizeof(alphanum) - 1)];
+// Writes every value as hexadecimal on its own line, for the hardware testbenches
+template<typename T>
+void write_hex_file(const T* values, int64_t num_values, int width, std::string filename) {
+    std::ofstream file(filename);
+    for(int64_t i=0; i<num_values; i++) {
+        file << std::hex << std::setfill('0') << std::setw(width) << (uint64_t) values[i] << std::dec << std::endl;
     }
-
-    return result;
 }
 
-std::shared_ptr<arrow::Table> generate_int32_table(int num_values, int modulo=0, bool write_to_file=false) {
+std::shared_ptr<arrow::Table> generate_int32_table(int num_values, uint64_t seed, int modulo=0, bool write_to_file=false) {
     // Generate a non nullable int32 table with random numbers. Arguments:
     // Num_values: size of the table
-    // Modulo: Numbers can take any value between 0 and modulo-1. If modulo == 0 the range is the full range of int32.
+    // Modulo: Numbers can take any value between 0 and modulo-1. If modulo == 0 the range is 0 to the maximum of int32.
     // Write_to_file: If true the data in the arrow array will also be written to a file called "int32array.bin"
-    arrow::Int32Builder i32builder;
-    int32_t number;
-    std::ofstream check_file;
-    if(write_to_file){
-        check_file.open("int32array.bin");
-    }
+    datagen::int_options options;
+    options.max = (modulo <= 0) ? std::numeric_limits<int32_t>::max() : modulo - 1;
 
-    for (int i = 0; i < num_values; i++) {
-        if(modulo <= 0){
-            number = rand();
-        } else{
-            number = rand() % modulo;
-        }
-        PARQUET_THROW_NOT_OK(i32builder.Append(number));
-    }
     std::shared_ptr<arrow::Array> i32array;
-    PARQUET_THROW_NOT_OK(i32builder.Finish(&i32array));
-
-    std::shared_ptr<arrow::Schema> schema = arrow::schema(
-            {arrow::field("int", arrow::int32(), false)});
-
+    PARQUET_ASSIGN_OR_THROW(i32array, datagen::generate_int32(num_values, options, seed, std::thread::hardware_concurrency()));
 
     if(write_to_file){
-        for(int i=0; i<i32array->data()->buffers[1]->size(); i++){
-            check_file <<i32array->data()->buffers[1]->data()[i];
-        }
-        check_file.close();
+        write_binary_file(i32array->data()->buffers[1], "int32array.bin");
     }
-    return arrow::Table::Make(schema, {i32array});
+    return datagen::make_table("int", i32array);
 }
 
-std::shared_ptr<arrow::Table> generate_int64_table(int num_values, int modulo=0, bool write_to_file=false) {
+std::shared_ptr<arrow::Table> generate_int64_table(int num_values, uint64_t seed, int modulo=0, bool write_to_file=false) {
     // Generate a non nullable int64 table with random numbers. Arguments:
     // Num_values: size of the table
     // Modulo: Numbers can take any value between 0 and modulo-1. If modulo == 0 the range is the full range of int64.
     // Write_to_file: If true the data in the arrow array will also be written to a file called "int64array.bin"
-    arrow::Int64Builder i64builder;
-    int64_t number;
-    std::ofstream check_file;
-    if(write_to_file){
-        check_file.open("int64array.bin");
+    datagen::int_options options;
+    if(modulo <= 0){
+        options.min = std::numeric_limits<int64_t>::min();
+        options.max = std::numeric_limits<int64_t>::max();
+    } else{
+        options.max = modulo - 1;
     }
 
-    std::mt19937_64 gen(std::random_device{}());
-
-    for (int i = 0; i < num_values; i++) {
-        if(modulo <= 0){
-            number = gen();
-        } else{
-            number = gen() % modulo;
-        }
-        /*
-        if (i == 60 || i == 62){
-            PARQUET_THROW_NOT_OK(i64builder.AppendNull());
-        }
-        else{
-            PARQUET_THROW_NOT_OK(i64builder.Append(number));
-        }*/
-        PARQUET_THROW_NOT_OK(i64builder.Append(number));
-    }
     std::shared_ptr<arrow::Array> i64array;
-    PARQUET_THROW_NOT_OK(i64builder.Finish(&i64array));
-
-    std::shared_ptr<arrow::Schema> schema = arrow::schema(
-            {arrow::field("int", arrow::int64(), false)});
-
+    PARQUET_ASSIGN_OR_THROW(i64array, datagen::generate_int64(num_values, options, seed, std::thread::hardware_concurrency()));
 
     if(write_to_file){
-        for(int i=0; i<i64array->data()->buffers[1]->size(); i++){
-            check_file <<i64array->data()->buffers[1]->data()[i];
-        }
-        check_file.close();
+        write_binary_file(i64array->data()->buffers[1], "int64array.bin");
     }
-    return arrow::Table::Make(schema, {i64array});
+    return datagen::make_table("int", i64array);
 }
 
-std::shared_ptr<arrow::Table> generate_int64_delta_varied_bit_width_table(int num_values, int run_length, bool write_to_file=true){
-    //Generates a non nullable int64 table. Attempts to vary widths of the bit packing.
-    arrow::Int64Builder i64builder;
-
-    int64_t modulo = 0;
-    int64_t number;
-
-    std::ofstream check_file;
-    std::ofstream dec_check_file;
-    std::ofstream hex_check_file;
-
-    std::mt19937_64 gen(std::random_device{}());
-
-
-    if(write_to_file){
-        check_file.open("delta_varied_int64array.bin");
-        dec_check_file.open("delta_varied_int64array.dec");
-        hex_check_file.open("delta_varied_int64array.hex");
+std::shared_ptr<arrow::Table> generate_int64_delta_varied_bit_width_table(int num_values, uint64_t seed, bool write_to_file=true){
+    //Generates a non nullable int64 table. Every miniblock of 32 deltas gets a random bit packing width.
+    datagen::int_options options;
+    options.distribution = datagen::BIT_WIDTH_MIX;
+    options.bit_widths.clear();
+    for(int width=0; width<64; width++){
+        options.bit_widths.push_back(width);
     }
 
-    for (int i = 0; i < num_values; i++) {
-        if((i%run_length) == 0){
-            modulo = 1ULL << (gen() % 64);
-        }
-        number = gen() % modulo;
-
-        //std::cout<<modulo<<" "<<std::log2(modulo)<<" "<<number<<std::endl;
-
-        PARQUET_THROW_NOT_OK(i64builder.Append(number));
-
-        if(write_to_file){
-            dec_check_file << number << std::endl;
-            hex_check_file << std::hex << std::setfill('0') << std::setw(8) << number << std::dec << std::endl;
-        }
-    }
     std::shared_ptr<arrow::Array> i64array;
-    PARQUET_THROW_NOT_OK(i64builder.Finish(&i64array));
-
-    std::shared_ptr<arrow::Schema> schema = arrow::schema(
-            {arrow::field("int", arrow::int64(), false)});
-
+    PARQUET_ASSIGN_OR_THROW(i64array, datagen::generate_int64(num_values, options, seed, std::thread::hardware_concurrency()));
 
     if(write_to_file){
-        for(int i=0; i<i64array->data()->buffers[1]->size(); i++){
-            check_file <<i64array->data()->buffers[1]->data()[i];
+        const int64_t* values = std::static_pointer_cast<arrow::Int64Array>(i64array)->raw_values();
+        write_binary_file(i64array->data()->buffers[1], "delta_varied_int64array.bin");
+        write_hex_file(values, num_values, 8, "delta_varied_int64array.hex");
+        std::ofstream dec_check_file("delta_varied_int64array.dec");
+        for(int i=0; i<num_values; i++){
+            dec_check_file << values[i] << std::endl;
         }
-        check_file.close();
-        dec_check_file.close();
-        hex_check_file.close();
     }
-    return arrow::Table::Make(schema, {i64array});
+    return datagen::make_table("int", i64array);
 }
 
-std::shared_ptr<arrow::Table> generate_int32_delta_varied_bit_width_table(int num_values, int run_length, bool write_to_file=true){
-    //Generates a non nullable int32 table. Attempts to vary widths of the bit packing.
-    arrow::Int32Builder i32builder;
-
-    int modulo = 0;
-    int number;
-
-    std::ofstream check_file;
-    std::ofstream dec_check_file;
-    std::ofstream hex_check_file;
-
-    if(write_to_file){
-        check_file.open("delta_varied_int32array.bin");
-        dec_check_file.open("delta_varied_int32array.dec");
-        hex_check_file.open("delta_varied_int32array.hex");
+std::shared_ptr<arrow::Table> generate_int32_delta_varied_bit_width_table(int num_values, uint64_t seed, bool write_to_file=true){
+    //Generates a non nullable int32 table. Every miniblock of 32 deltas gets a random bit packing width.
+    datagen::int_options options;
+    options.distribution = datagen::BIT_WIDTH_MIX;
+    options.bit_widths.clear();
+    for(int width=0; width<32; width++){
+        options.bit_widths.push_back(width);
     }
 
-    for (int i = 0; i < num_values; i++) {
-        if((i%run_length) == 0){
-            modulo = 1U << (rand() % 32);
-        }
-        number = rand() % modulo;
-
-        //std::cout<<modulo<<" "<<std::log2(modulo)<<" "<<number<<std::endl;
-
-        PARQUET_THROW_NOT_OK(i32builder.Append(number));
-
-        if(write_to_file){
-            dec_check_file << number << std::endl;
-            hex_check_file << std::hex << std::setfill('0') << std::setw(8) << number << std::dec << std::endl;
-        }
-    }
     std::shared_ptr<arrow::Array> i32array;
-    PARQUET_THROW_NOT_OK(i32builder.Finish(&i32array));
-
-    std::shared_ptr<arrow::Schema> schema = arrow::schema(
-            {arrow::field("int", arrow::int32(), false)});
-
+    PARQUET_ASSIGN_OR_THROW(i32array, datagen::generate_int32(num_values, options, seed, std::thread::hardware_concurrency()));
 
     if(write_to_file){
-        for(int i=0; i<i32array->data()->buffers[1]->size(); i++){
-            check_file <<i32array->data()->buffers[1]->data()[i];
+        const int32_t* values = std::static_pointer_cast<arrow::Int32Array>(i32array)->raw_values();
+        write_binary_file(i32array->data()->buffers[1], "delta_varied_int32array.bin");
+        write_hex_file((const uint32_t*) values, num_values, 8, "delta_varied_int32array.hex");
+        std::ofstream dec_check_file("delta_varied_int32array.dec");
+        for(int i=0; i<num_values; i++){
+            dec_check_file << values[i] << std::endl;
         }
-        check_file.close();
-        dec_check_file.close();
-        hex_check_file.close();
     }
-    return arrow::Table::Make(schema, {i32array});
+    return datagen::make_table("int", i32array);
 }
 
 
-std::shared_ptr<arrow::Table> generate_str_table(int num_values, int min_length, int max_length, bool write_to_file=true) {
-    std::ofstream hex_length_file;
-    std::ofstream hex_char_file;
-    std::ofstream bin_length_file;
-    std::ofstream bin_char_file;
+std::shared_ptr<arrow::Table> generate_str_table(int num_values, uint64_t seed, int min_length, int max_length, bool write_to_file=true) {
+    datagen::string_options options;
+    options.min_length = min_length;
+    options.max_length = max_length;
 
-    if(write_to_file){
-        hex_length_file.open("lengths_small_strarray.hex");
-        hex_char_file.open("chars_small_strarray.hex");
-        bin_length_file.open("lengths_small_strarray.bin");
-        bin_char_file.open("chars_small_strarray.bin");
-    }
-
-    arrow::StringBuilder strbuilder;
-    for (int i = 0; i < num_values; i++) {
-        int length = rand() % (max_length - min_length + 1) + min_length;
-        std::string rand_string = gen_random_string(length);
-
-        if(write_to_file){
-            hex_length_file << std::hex << std::setfill('0') << std::setw(8) << length << std::dec << std::endl;
-            for(char& c : rand_string){
-                hex_char_file << std::hex << std::setfill('0') << std::setw(2) << (int) c << std::dec << std::endl;
-            }
-        }
-
-        PARQUET_THROW_NOT_OK(strbuilder.Append(rand_string));
-    }
     std::shared_ptr<arrow::Array> strarray;
-    PARQUET_THROW_NOT_OK(strbuilder.Finish(&strarray));
-
-    std::shared_ptr<arrow::Schema> schema = arrow::schema(
-            {arrow::field("str", arrow::utf8(), false)});
+    PARQUET_ASSIGN_OR_THROW(strarray, datagen::generate_strings(num_values, options, seed, std::thread::hardware_concurrency()));
 
     if(write_to_file){
-        for(int i=0; i<strarray->data()->buffers[1]->size(); i++){
-            bin_length_file << strarray->data()->buffers[1]->data()[i];
-        }
-        for(int i=0; i<strarray->data()->buffers[2]->size(); i++){
-            bin_char_file << strarray->data()->buffers[2]->data()[i];
+        std::shared_ptr<arrow::StringArray> strings = std::static_pointer_cast<arrow::StringArray>(strarray);
+        std::vector<int32_t> lengths(num_values);
+        for(int i=0; i<num_values; i++){
+            lengths[i] = strings->value_length(i);
         }
-        hex_length_file.close();
-        hex_char_file.close();
-        bin_length_file.close();
-        bin_char_file.close();
+        const uint8_t* chars = strings->value_data()->data();
+
+        write_hex_file(lengths.data(), num_values, 8, "lengths_small_strarray.hex");
+        write_hex_file(chars, strings->value_offset(num_values), 2, "chars_small_strarray.hex");
+        write_binary_file(strarray->data()->buffers[1], "lengths_small_strarray.bin");
+        write_binary_file(strarray->data()->buffers[2], "chars_small_strarray.bin");
     }
 
-    return arrow::Table::Make(schema, {strarray});
+    return datagen::make_table("str", strarray);
 }
 
-std::shared_ptr<arrow::Table> generate_int64_str_table(int num_values, int min_length, int max_length, int modulo=0) {
-
-    //Generate ints
-    arrow::Int64Builder i64builder;
-    int number;
+std::shared_ptr<arrow::Table> generate_int64_str_table(int num_values, uint64_t seed, int min_length, int max_length, int modulo=0) {
+    datagen::int_options int_options;
+    int_options.max = (modulo <= 0) ? std::numeric_limits<int32_t>::max() : modulo - 1;
 
-    for (int i = 0; i < num_values; i++) {
-        if(modulo <= 0){
-            number = rand();
-        } else{
-            number = rand() % modulo;
-        }
-        /*
-        if (i == 60 || i == 62){
-            PARQUET_THROW_NOT_OK(i64builder.AppendNull());
-        }
-        else{
-            PARQUET_THROW_NOT_OK(i64builder.Append(number));
-        }*/
-        PARQUET_THROW_NOT_OK(i64builder.Append(number));
+    datagen::string_options str_options;
+    str_options.min_length = min_length;
+    str_options.max_length = max_length;
 
-    }
+    // Different seeds for both columns, so they are not correlated
     std::shared_ptr<arrow::Array> i64array;
-    PARQUET_THROW_NOT_OK(i64builder.Finish(&i64array));
-
-    //Generate strings
-    arrow::StringBuilder strbuilder;
-    for (int i = 0; i < num_values; i++) {
-        int length = rand() % (max_length - min_length + 1) + min_length;
-        std::string rand_string = gen_random_string(length);
-        PARQUET_THROW_NOT_OK(strbuilder.Append(rand_string));
-    }
+    PARQUET_ASSIGN_OR_THROW(i64array, datagen::generate_int64(num_values, int_options, seed, std::thread::hardware_concurrency()));
     std::shared_ptr<arrow::Array> strarray;
-    PARQUET_THROW_NOT_OK(strbuilder.Finish(&strarray));
+    PARQUET_ASSIGN_OR_THROW(strarray, datagen::generate_strings(num_values, str_options, seed + 1, std::thread::hardware_concurrency()));
 
     std::shared_ptr<arrow::Schema> schema = arrow::schema(
             {arrow::field("int", arrow::int64(), true), arrow::field("str", arrow::utf8(), true)});
@@ -473,13 +333,14 @@ std::shared_ptr<arrow::Array> readArray(std::string hw_input_file_path) {
 
 int main(int argc, char **argv) {
     if (argc < 2) {
-        std::cout << "Usage: prelim num_values [iterations] [modulo]" << std::endl;
+        std::cout << "Usage: prelim num_values [iterations] [modulo] [seed]" << std::endl;
         return 1;
     }
 
     int num_values = atoi(argv[1]);
     int iterations = 1;
     int modulo = 0;
+    uint64_t seed = 42;
 
     if (argc >= 3) {
         iterations = atoi(argv[2]);
@@ -489,12 +350,16 @@ int main(int argc, char **argv) {
         modulo = atoi(argv[3]);
     }
 
+    if (argc >= 5) {
+        seed = std::strtoull(argv[4], nullptr, 10);
+    }
+
     std::cout << "Size of Arrow table: " << num_values << " values." << std::endl;
-    //std::shared_ptr<arrow::Table> int64_table = generate_int64_table(num_values, modulo, true);
-    std::shared_ptr<arrow::Table> int64_table = generate_int64_delta_varied_bit_width_table(num_values, 256, false);
-    //std::shared_ptr<arrow::Table> int32_table = generate_int32_delta_varied_bit_width_table(num_values, 256, false);
-    //std::shared_ptr<arrow::Table> int32_table = generate_int32_table(num_values, modulo, false);
-    //std::shared_ptr<arrow::Table> str_table = generate_str_table(num_values, 2, 500, false);
+    //std::shared_ptr<arrow::Table> int64_table = generate_int64_table(num_values, seed, modulo, true);
+    std::shared_ptr<arrow::Table> int64_table = generate_int64_delta_varied_bit_width_table(num_values, seed, false);
+    //std::shared_ptr<arrow::Table> int32_table = generate_int32_delta_varied_bit_width_table(num_values, seed, false);
+    //std::shared_ptr<arrow::Table> int32_table = generate_int32_table(num_values, seed, modulo, false);
+    //std::shared_ptr<arrow::Table> str_table = generate_str_table(num_values, seed, 2, 500, false);
 
     std::cout << "Finished Arrow table generation." << std::endl;
     std::cout << "Starting Parquet file writing." << std::endl;
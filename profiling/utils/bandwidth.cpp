@@ -0,0 +1,96 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements. See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership. The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "bandwidth.h"
+#include "timer.h"
+
+static volatile uint64_t bandwidth_sink;
+
+template<typename F>
+static double run_threads(int num_threads, F kernel) {
+  Timer t;
+  std::vector<std::thread> threads;
+
+  t.start();
+  for(int i=1; i<num_threads; i++) {
+    threads.emplace_back(kernel, i);
+  }
+  kernel(0);
+  for(std::thread& thread : threads) {
+    thread.join();
+  }
+  t.stop();
+
+  return t.seconds();
+}
+
+bandwidth measure_bandwidth(int num_threads, size_t array_size, int iterations) {
+  size_t num_words = array_size/sizeof(uint64_t);
+  size_t words_per_thread = num_words/num_threads;
+
+  // Not initialized here, every thread first touches its own part so the pages end up on its NUMA node
+  uint64_t* src = (uint64_t*) std::malloc(num_words*sizeof(uint64_t));
+  uint64_t* dst = (uint64_t*) std::malloc(num_words*sizeof(uint64_t));
+
+  run_threads(num_threads, [&](int t) {
+    for(size_t i=t*words_per_thread; i<(t+1)*words_per_thread; i++) {
+      src[i] = i;
+      dst[i] = 0;
+    }
+  });
+
+  double best_read = 0;
+  double best_copy = 0;
+
+  for(int it=0; it<iterations; it++) {
+    std::vector<uint64_t> sums(num_threads);
+
+    double read_seconds = run_threads(num_threads, [&](int t) {
+      uint64_t sum = 0;
+      for(size_t i=t*words_per_thread; i<(t+1)*words_per_thread; i++) {
+        sum += src[i];
+      }
+      sums[t] = sum;
+    });
+
+    double copy_seconds = run_threads(num_threads, [&](int t) {
+      for(size_t i=t*words_per_thread; i<(t+1)*words_per_thread; i++) {
+        dst[i] = src[i];
+      }
+    });
+
+    bandwidth_sink = sums[0] + dst[words_per_thread/2];
+
+    size_t bytes = num_threads*words_per_thread*sizeof(uint64_t);
+    if(bytes/read_seconds > best_read) {
+      best_read = bytes/read_seconds;
+    }
+    if(2*bytes/copy_seconds > best_copy) {
+      best_copy = 2*bytes/copy_seconds;
+    }
+  }
+
+  std::free(src);
+  std::free(dst);
+
+  return {num_threads, best_read, best_copy};
+}
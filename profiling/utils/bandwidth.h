@@ -0,0 +1,36 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements. See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership. The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+// STREAM style memory bandwidth measurement, used as the roofline for decode throughput.
+
+#pragma once
+
+#include <cstddef>
+
+// Size of each array in bytes. STREAM asks for at least 4 times the size of the last level cache.
+#define BANDWIDTH_ARRAY_SIZE (512*1024*1024)
+
+struct bandwidth {
+  int num_threads;
+  // Bytes read per second when summing an array
+  double read;
+  // Bytes read plus bytes written per second when copying an array, counted like STREAM does
+  double copy;
+};
+
+// Best of iterations runs, with the arrays split evenly over num_threads threads
+bandwidth measure_bandwidth(int num_threads, size_t array_size = BANDWIDTH_ARRAY_SIZE, int iterations = 5);
@@ -0,0 +1,56 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements. See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership. The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "cache.h"
+
+static volatile uint8_t flush_sink;
+
+void flush_caches() {
+  static std::vector<uint8_t> flush_buffer(CACHE_FLUSH_SIZE);
+  uint8_t sum = 0;
+
+  for(size_t i=0; i<flush_buffer.size(); i+=64) {
+    flush_buffer[i]++;
+    sum += flush_buffer[i];
+  }
+  flush_sink = sum;
+}
+
+bool evict_file(const std::string& file_path) {
+  int fd = open(file_path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    std::cerr << "Could not open " << file_path << std::endl;
+    return false;
+  }
+  // Dirty pages are not dropped by POSIX_FADV_DONTNEED
+  fdatasync(fd);
+  int result = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  close(fd);
+
+  if(result != 0) {
+    std::cerr << "Could not evict " << file_path << " from the page cache" << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,32 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements. See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership. The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+// Helpers to start a benchmark run from cold caches.
+
+#pragma once
+
+#include <string>
+
+// Should be larger than the last level cache of the machine the benchmark is running on
+#define CACHE_FLUSH_SIZE (256*1024*1024)
+
+// Evict earlier data from the CPU caches by walking over a buffer larger than the LLC
+void flush_caches();
+
+// Write back and drop the page cache pages of a file, so the next read of it comes from disk.
+// Returns false when the file could not be opened or evicted.
+bool evict_file(const std::string& file_path);
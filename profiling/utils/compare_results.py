@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+# Compares two benchmark result files written through PTOA_RESULTS (see results.h) and flags the measurements that got
+# significantly slower or faster. All samples of a measurement are pooled, so run a benchmark a few times into the same
+# file to include run to run variation. The confidence interval of the ratio of medians (new/old) comes from bootstrap
+# resampling. A measurement is a regression when the whole interval lies above 1 + threshold.
+# Every metric is a time, lower is better.
+#
+# Usage: compare_results.py old_results new_results [--confidence 0.95] [--threshold 0.02]
+# Exits with 1 if any measurement regressed.
+
+import argparse
+import csv
+import json
+import random
+import statistics
+import sys
+
+
+def read_results(path):
+    samples = {}
+    machines = set()
+
+    with open(path) as f:
+        if path.endswith(".json"):
+            for line in f:
+                if not line.strip():
+                    continue
+                r = json.loads(line)
+                config = ";".join(k + "=" + v for k, v in r["config"].items())
+                samples.setdefault((r["benchmark"], config, r["metric"]), []).extend(r["samples"])
+                machines.add((r["cpu"], r["compiler"], r["flags"], r["git"]))
+        else:
+            for r in csv.DictReader(f):
+                samples.setdefault((r["benchmark"], r["config"], r["metric"]), []).append(float(r["value"]))
+                machines.add((r["cpu"], r["compiler"], r["flags"], r["git"]))
+
+    return samples, machines
+
+
+def ratio_interval(old, new, confidence, resamples, rng):
+    ratios = []
+    for _ in range(resamples):
+        old_median = statistics.median(rng.choices(old, k=len(old)))
+        new_median = statistics.median(rng.choices(new, k=len(new)))
+        ratios.append(new_median / old_median)
+    ratios.sort()
+
+    low = ratios[int((1 - confidence) / 2 * (resamples - 1))]
+    high = ratios[int((1 + confidence) / 2 * (resamples - 1))]
+    return low, high
+
+
+def describe(machines):
+    return "; ".join("cpu {}, compiler {}, flags {}, git {}".format(*m) for m in sorted(machines))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Flag significant differences between two benchmark result files")
+    parser.add_argument("old")
+    parser.add_argument("new")
+    parser.add_argument("--confidence", type=float, default=0.95)
+    parser.add_argument("--threshold", type=float, default=0.02,
+                        help="relative change below which a difference is not reported, even if significant")
+    parser.add_argument("--resamples", type=int, default=2000)
+    args = parser.parse_args()
+
+    old, old_machines = read_results(args.old)
+    new, new_machines = read_results(args.new)
+
+    print("old: " + describe(old_machines))
+    print("new: " + describe(new_machines))
+    if {m[:3] for m in old_machines} != {m[:3] for m in new_machines}:
+        print("[WARNING] The results come from different machines, compilers or flags")
+
+    # Fixed seed, so comparing the same files twice gives the same answer
+    rng = random.Random(0)
+    regressions = 0
+
+    for key in sorted(old.keys() & new.keys()):
+        if len(old[key]) < 2 or len(new[key]) < 2:
+            print("[WARNING] Skipping {} {} {}: fewer than two samples".format(*key))
+            continue
+
+        low, high = ratio_interval(old[key], new[key], args.confidence, args.resamples, rng)
+        ratio = statistics.median(new[key]) / statistics.median(old[key])
+
+        if low > 1 + args.threshold:
+            verdict = "REGRESSION"
+            regressions += 1
+        elif high < 1 - args.threshold:
+            verdict = "improvement"
+        else:
+            verdict = ""
+
+        print("{:<10} {:<60} {:<10} {:7.3f}x [{:.3f}, {:.3f}] {}".format(key[0], key[1], key[2], ratio, low, high, verdict))
+
+    for key in sorted(old.keys() ^ new.keys()):
+        print("[WARNING] {} {} {} is only in {}".format(*key, args.old if key in old else args.new))
+
+    return 1 if regressions > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,319 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements. See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership. The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <random>
+#include <thread>
+
+#include "datagen.h"
+
+namespace datagen {
+
+// Random streams of one chunk, so generating a chunk never depends on the chunks before it
+enum stream {
+  STREAM_VALUES = 0,
+  STREAM_NULLS,
+  STREAM_CHARS
+};
+
+static std::mt19937_64 chunk_generator(uint64_t seed, int64_t chunk, stream s) {
+  std::seed_seq seq{(uint32_t) seed, (uint32_t) (seed >> 32), (uint32_t) chunk, (uint32_t) (chunk >> 32), (uint32_t) s};
+  return std::mt19937_64(seq);
+}
+
+template<typename F>
+static void for_each_chunk(int64_t num_chunks, int num_threads, F function) {
+  std::atomic<int64_t> next_chunk(0);
+
+  auto worker = [&]() {
+    for(int64_t chunk = next_chunk++; chunk < num_chunks; chunk = next_chunk++) {
+      function(chunk);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for(int t=1; t<std::min((int64_t) num_threads, num_chunks); t++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for(std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+static arrow::Status allocate(int64_t size, std::shared_ptr<arrow::Buffer>* buffer) {
+  ARROW_ASSIGN_OR_RAISE(*buffer, arrow::AllocateBuffer(size));
+  return arrow::Status::OK();
+}
+
+// Replaces per-chunk totals by the sum of all chunks before them
+static void exclusive_scan(std::vector<uint64_t>& totals) {
+  uint64_t sum = 0;
+  for(uint64_t& total : totals) {
+    uint64_t chunk_total = total;
+    total = sum;
+    sum += chunk_total;
+  }
+}
+
+static std::vector<double> zipf_cdf(const int_options& options) {
+  uint64_t range = (uint64_t) options.max - (uint64_t) options.min + 1;
+  int64_t num_ranks = (range == 0 || range > DATAGEN_ZIPF_MAX_RANKS) ? DATAGEN_ZIPF_MAX_RANKS : (int64_t) range;
+
+  std::vector<double> cdf(num_ranks);
+  double sum = 0;
+  for(int64_t r=0; r<num_ranks; r++) {
+    sum += 1.0/std::pow((double) (r + 1), options.zipf_exponent);
+    cdf[r] = sum;
+  }
+  for(double& c : cdf) {
+    c /= sum;
+  }
+
+  return cdf;
+}
+
+// Fills the validity bitmap of one chunk, returns the amount of nulls
+static int64_t generate_nulls(uint8_t* valid_bitmap, int64_t first, int64_t count, double null_ratio, uint64_t seed, int64_t chunk) {
+  std::mt19937_64 gen = chunk_generator(seed, chunk, STREAM_NULLS);
+  std::bernoulli_distribution is_null(null_ratio);
+  int64_t null_count = 0;
+
+  std::memset(valid_bitmap + first/8, 0, (count + 7)/8);
+  for(int64_t i=first; i<first+count; i++) {
+    if(is_null(gen)) {
+      null_count++;
+    } else {
+      valid_bitmap[i/8] |= (uint8_t) (1 << (i%8));
+    }
+  }
+
+  return null_count;
+}
+
+template<typename T, typename ArrayType>
+static arrow::Result<std::shared_ptr<arrow::Array>> generate_ints(int64_t num_values, const int_options& options, uint64_t seed, int num_threads) {
+  int64_t num_chunks = (num_values + DATAGEN_CHUNK_SIZE - 1)/DATAGEN_CHUNK_SIZE;
+  bool walk = (options.distribution == SORTED) || (options.distribution == RANDOM_WALK) || (options.distribution == BIT_WIDTH_MIX);
+
+  std::shared_ptr<arrow::Buffer> values_buffer;
+  std::shared_ptr<arrow::Buffer> valid_buffer;
+  ARROW_RETURN_NOT_OK(allocate(num_values*sizeof(T), &values_buffer));
+  if(options.null_ratio > 0) {
+    ARROW_RETURN_NOT_OK(allocate((num_values + 7)/8, &valid_buffer));
+  }
+  T* values = (T*) values_buffer->mutable_data();
+
+  std::vector<double> cdf;
+  if(options.distribution == ZIPF) {
+    cdf = zipf_cdf(options);
+  }
+
+  // Sums of the steps of every chunk of a walk, turned into the starting point of every chunk afterwards
+  std::vector<uint64_t> chunk_totals(num_chunks, 0);
+  std::vector<int64_t> chunk_null_counts(num_chunks, 0);
+
+  for_each_chunk(num_chunks, num_threads, [&](int64_t chunk) {
+    std::mt19937_64 gen = chunk_generator(seed, chunk, STREAM_VALUES);
+    int64_t first = chunk*DATAGEN_CHUNK_SIZE;
+    int64_t last = std::min(num_values, first + DATAGEN_CHUNK_SIZE);
+
+    // Unsigned, so walks wrap around instead of overflowing
+    uint64_t sum = 0;
+
+    if(options.distribution == UNIFORM) {
+      std::uniform_int_distribution<int64_t> value(options.min, options.max);
+      for(int64_t i=first; i<last; i++) {
+        values[i] = (T) value(gen);
+      }
+    } else if(options.distribution == SORTED || options.distribution == RANDOM_WALK) {
+      std::uniform_int_distribution<int64_t> step(options.distribution == SORTED ? 0 : -options.max_step, options.max_step);
+      for(int64_t i=first; i<last; i++) {
+        sum += (uint64_t) step(gen);
+        values[i] = (T) sum;
+      }
+    } else if(options.distribution == RUNS) {
+      std::uniform_int_distribution<int64_t> value(options.min, options.max);
+      std::geometric_distribution<int64_t> extra_length(1.0/std::max(1.0, options.mean_run_length));
+      for(int64_t i=first; i<last; ) {
+        T run_value = (T) value(gen);
+        int64_t run_end = std::min(last, i + 1 + extra_length(gen));
+        for(; i<run_end; i++) {
+          values[i] = run_value;
+        }
+      }
+    } else if(options.distribution == ZIPF) {
+      std::uniform_real_distribution<double> u(0, 1);
+      for(int64_t i=first; i<last; i++) {
+        int64_t rank = std::lower_bound(cdf.begin(), cdf.end(), u(gen)) - cdf.begin();
+        values[i] = (T) (options.min + std::min(rank, (int64_t) cdf.size() - 1));
+      }
+    } else {
+      std::uniform_int_distribution<size_t> width_index(0, options.bit_widths.size() - 1);
+      uint64_t mask = 0;
+      for(int64_t i=first; i<last; i++) {
+        if(i%32 == 0) {
+          int width = options.bit_widths[width_index(gen)];
+          mask = (width >= 64) ? ~0ULL : (1ULL << width) - 1;
+        }
+        sum += gen() & mask;
+        values[i] = (T) sum;
+      }
+    }
+
+    chunk_totals[chunk] = sum;
+
+    if(valid_buffer) {
+      chunk_null_counts[chunk] = generate_nulls(valid_buffer->mutable_data(), first, last - first, options.null_ratio, seed, chunk);
+    }
+  });
+
+  if(walk) {
+    exclusive_scan(chunk_totals);
+
+    for_each_chunk(num_chunks, num_threads, [&](int64_t chunk) {
+      uint64_t start = (uint64_t) options.min + chunk_totals[chunk];
+      int64_t first = chunk*DATAGEN_CHUNK_SIZE;
+      int64_t last = std::min(num_values, first + DATAGEN_CHUNK_SIZE);
+      for(int64_t i=first; i<last; i++) {
+        values[i] = (T) ((uint64_t) values[i] + start);
+      }
+    });
+  }
+
+  int64_t null_count = 0;
+  for(int64_t count : chunk_null_counts) {
+    null_count += count;
+  }
+
+  std::shared_ptr<arrow::Array> array = std::make_shared<ArrayType>(num_values, values_buffer, valid_buffer, null_count);
+  return array;
+}
+
+arrow::Result<std::shared_ptr<arrow::Array>> generate_int32(int64_t num_values, const int_options& options, uint64_t seed, int num_threads) {
+  return generate_ints<int32_t, arrow::Int32Array>(num_values, options, seed, num_threads);
+}
+
+arrow::Result<std::shared_ptr<arrow::Array>> generate_int64(int64_t num_values, const int_options& options, uint64_t seed, int num_threads) {
+  return generate_ints<int64_t, arrow::Int64Array>(num_values, options, seed, num_threads);
+}
+
+arrow::Result<std::shared_ptr<arrow::Array>> generate_strings(int64_t num_values, const string_options& options, uint64_t seed, int num_threads) {
+  int64_t num_chunks = (num_values + DATAGEN_CHUNK_SIZE - 1)/DATAGEN_CHUNK_SIZE;
+
+  std::shared_ptr<arrow::Buffer> offsets_buffer;
+  std::shared_ptr<arrow::Buffer> valid_buffer;
+  ARROW_RETURN_NOT_OK(allocate((num_values + 1)*sizeof(int32_t), &offsets_buffer));
+  if(options.null_ratio > 0) {
+    ARROW_RETURN_NOT_OK(allocate((num_values + 7)/8, &valid_buffer));
+  }
+  int32_t* offsets = (int32_t*) offsets_buffer->mutable_data();
+  const uint8_t* valid_bitmap = valid_buffer ? valid_buffer->data() : nullptr;
+
+  std::vector<uint64_t> chunk_totals(num_chunks, 0);
+  std::vector<int64_t> chunk_null_counts(num_chunks, 0);
+
+  // First the length of every string, in the offsets buffer shifted by one
+  for_each_chunk(num_chunks, num_threads, [&](int64_t chunk) {
+    std::mt19937_64 gen = chunk_generator(seed, chunk, STREAM_VALUES);
+    int64_t first = chunk*DATAGEN_CHUNK_SIZE;
+    int64_t last = std::min(num_values, first + DATAGEN_CHUNK_SIZE);
+
+    std::uniform_int_distribution<int32_t> uniform_length(options.min_length, options.max_length);
+    std::normal_distribution<double> normal_length(options.mean_length, options.stddev_length);
+    std::exponential_distribution<double> exponential_length(1.0/std::max(1.0, options.mean_length - options.min_length));
+
+    if(valid_buffer) {
+      chunk_null_counts[chunk] = generate_nulls(valid_buffer->mutable_data(), first, last - first, options.null_ratio, seed, chunk);
+    }
+
+    uint64_t sum = 0;
+    for(int64_t i=first; i<last; i++) {
+      double length;
+      if(options.lengths == LENGTH_UNIFORM) {
+        length = uniform_length(gen);
+      } else if(options.lengths == LENGTH_NORMAL) {
+        length = std::round(normal_length(gen));
+      } else {
+        length = options.min_length + std::floor(exponential_length(gen));
+      }
+      length = std::max((double) options.min_length, std::min((double) options.max_length, length));
+
+      // Drawn for nulls as well, so the lengths of the other strings don't depend on the null ratio
+      if(valid_bitmap && !(valid_bitmap[i/8] & (1 << (i%8)))) {
+        length = 0;
+      }
+
+      offsets[i+1] = (int32_t) length;
+      sum += (uint64_t) length;
+    }
+    chunk_totals[chunk] = sum;
+  });
+
+  uint64_t num_chars = 0;
+  for(uint64_t total : chunk_totals) {
+    num_chars += total;
+  }
+  exclusive_scan(chunk_totals);
+
+  if(num_chars > (uint64_t) std::numeric_limits<int32_t>::max()) {
+    return arrow::Status::CapacityError(std::to_string(num_chars) + " characters don't fit in a StringArray");
+  }
+
+  std::shared_ptr<arrow::Buffer> chars_buffer;
+  ARROW_RETURN_NOT_OK(allocate(num_chars, &chars_buffer));
+  uint8_t* chars = chars_buffer->mutable_data();
+  offsets[0] = 0;
+
+  // Then the offsets and characters, a chunk only writes the offsets after its own first string
+  for_each_chunk(num_chunks, num_threads, [&](int64_t chunk) {
+    std::mt19937_64 gen = chunk_generator(seed, chunk, STREAM_CHARS);
+    std::uniform_int_distribution<size_t> char_index(0, options.alphabet.size() - 1);
+    int64_t first = chunk*DATAGEN_CHUNK_SIZE;
+    int64_t last = std::min(num_values, first + DATAGEN_CHUNK_SIZE);
+
+    int32_t offset = (int32_t) chunk_totals[chunk];
+    for(int64_t i=first; i<last; i++) {
+      int32_t length = offsets[i+1];
+      for(int32_t c=0; c<length; c++) {
+        chars[offset + c] = (uint8_t) options.alphabet[char_index(gen)];
+      }
+      offset += length;
+      offsets[i+1] = offset;
+    }
+  });
+
+  int64_t null_count = 0;
+  for(int64_t count : chunk_null_counts) {
+    null_count += count;
+  }
+
+  std::shared_ptr<arrow::Array> array = std::make_shared<arrow::StringArray>(num_values, offsets_buffer, chars_buffer, valid_buffer, null_count);
+  return array;
+}
+
+std::shared_ptr<arrow::Table> make_table(const std::string& column_name, const std::shared_ptr<arrow::Array>& array) {
+  bool nullable = array->null_bitmap_data() != nullptr;
+  std::shared_ptr<arrow::Schema> schema = arrow::schema({arrow::field(column_name, array->type(), nullable)});
+  return arrow::Table::Make(schema, {array});
+}
+
+}
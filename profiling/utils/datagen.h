@@ -0,0 +1,98 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements. See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership. The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+// Seedable generators for synthetic benchmark and test inputs.
+// The output only depends on the seed and the options, not on the number of threads: the values are generated in chunks
+// of DATAGEN_CHUNK_SIZE values that each get their own random stream derived from the seed and the chunk index.
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arrow/api.h>
+
+// Multiple of 8 so every chunk owns whole bytes of the validity bitmap, and of 32 so it owns whole miniblocks
+#define DATAGEN_CHUNK_SIZE 65536
+// Zipf ranks beyond this have a negligible chance of being drawn and would only make the table bigger
+#define DATAGEN_ZIPF_MAX_RANKS (1 << 20)
+
+namespace datagen {
+
+enum int_distribution {
+  // Independent values from [min, max]
+  UNIFORM,
+  // Non-decreasing from min, steps from [0, max_step]
+  SORTED,
+  // From min, steps from [-max_step, max_step]
+  RANDOM_WALK,
+  // Values from [min, max] repeated in runs with an average length of mean_run_length
+  RUNS,
+  // min + rank, where rank r is drawn with a chance proportional to 1/(r+1)^zipf_exponent
+  ZIPF,
+  // Non-decreasing from min. Every 32 values one of bit_widths is chosen and the steps are drawn from [0, 2^width), so
+  // DELTA_BINARY_PACKED packs the miniblocks at that width. Miniblocks are counted from the first value, so they line up
+  // with the miniblocks of the first page only.
+  BIT_WIDTH_MIX
+};
+
+struct int_options {
+  int_distribution distribution = UNIFORM;
+  int64_t min = 0;
+  int64_t max = std::numeric_limits<int32_t>::max();
+  int64_t max_step = 1024;
+  double mean_run_length = 8;
+  double zipf_exponent = 1.0;
+  std::vector<int> bit_widths = {0, 4, 8, 12, 16, 20, 24, 28, 32};
+  // Chance of every value to be null. No validity bitmap is created if this is 0.
+  double null_ratio = 0;
+};
+
+enum length_distribution {
+  // From [min_length, max_length]
+  LENGTH_UNIFORM,
+  // mean_length and stddev_length, clamped to [min_length, max_length]
+  LENGTH_NORMAL,
+  // min_length plus an exponential with mean mean_length - min_length, clamped to max_length. Mostly short strings with
+  // a long tail, as in many text columns.
+  LENGTH_EXPONENTIAL
+};
+
+struct string_options {
+  length_distribution lengths = LENGTH_UNIFORM;
+  int32_t min_length = 0;
+  int32_t max_length = 32;
+  double mean_length = 16;
+  double stddev_length = 4;
+  std::string alphabet = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+  // Null strings are empty and marked in the validity bitmap. No validity bitmap is created if this is 0.
+  double null_ratio = 0;
+};
+
+// The generators fail if a buffer can't be allocated. Values outside the range of int32 wrap around.
+arrow::Result<std::shared_ptr<arrow::Array>> generate_int32(int64_t num_values, const int_options& options, uint64_t seed, int num_threads = 1);
+arrow::Result<std::shared_ptr<arrow::Array>> generate_int64(int64_t num_values, const int_options& options, uint64_t seed, int num_threads = 1);
+// Also fails if the characters don't fit in the 32 bit offsets of a StringArray
+arrow::Result<std::shared_ptr<arrow::Array>> generate_strings(int64_t num_values, const string_options& options, uint64_t seed, int num_threads = 1);
+
+// A table with one column, which is nullable if the array has a validity bitmap
+std::shared_ptr<arrow::Table> make_table(const std::string& column_name, const std::shared_ptr<arrow::Array>& array);
+
+}
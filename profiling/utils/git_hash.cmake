@@ -0,0 +1,37 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+# Writes the commit the sources in SOURCE_DIR are at to the header OUTPUT as PTOA_GIT_HASH, for results.cpp. Run on every build
+# with cmake -DSOURCE_DIR=... -DOUTPUT=... -P git_hash.cmake. OUTPUT is only rewritten when the commit changed, so builds on the
+# same commit don't recompile anything.
+
+execute_process(COMMAND git describe --always --dirty
+		WORKING_DIRECTORY ${SOURCE_DIR}
+		OUTPUT_VARIABLE PTOA_GIT_HASH
+		OUTPUT_STRIP_TRAILING_WHITESPACE
+		ERROR_QUIET)
+if(NOT PTOA_GIT_HASH)
+	set(PTOA_GIT_HASH "unknown")
+endif()
+
+set(CONTENT "#define PTOA_GIT_HASH \"${PTOA_GIT_HASH}\"\n")
+if(EXISTS ${OUTPUT})
+	file(READ ${OUTPUT} OLD_CONTENT)
+endif()
+if(NOT CONTENT STREQUAL OLD_CONTENT)
+	file(WRITE ${OUTPUT} "${CONTENT}")
+endif()
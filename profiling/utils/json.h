@@ -0,0 +1,39 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements. See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership. The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+// Helpers for the JSON written by the trace and result writers.
+
+#pragma once
+
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+// Write str as a quoted JSON string, escaping quotes, backslashes and control characters
+inline void write_json_string(std::ostream& out, const std::string& str) {
+  out << '"';
+  for(char c : str) {
+    if((c == '"') || (c == '\\')) {
+      out << '\\' << c;
+    } else if((unsigned char) c < 0x20) {
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int) c << std::dec << std::setfill(' ');
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
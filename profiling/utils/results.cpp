@@ -0,0 +1,214 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements. See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership. The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <limits>
+
+#include "results.h"
+#include "json.h"
+
+#ifdef PTOA_GIT_HASH_HEADER
+// Generated by git_hash.cmake on every build
+#include "git_hash.h"
+#endif
+
+#ifndef PTOA_GIT_HASH
+#define PTOA_GIT_HASH "unknown"
+#endif
+
+#ifndef PTOA_CXX_FLAGS
+#define PTOA_CXX_FLAGS "unknown"
+#endif
+
+Results& Results::global() {
+  static Results results;
+  return results;
+}
+
+void Results::enable(const std::string& output_path) {
+  this->output_path = output_path;
+  json = (output_path.size() >= 5) && (output_path.compare(output_path.size() - 5, 5, ".json") == 0);
+  enabled_ = true;
+}
+
+bool Results::enable_from_env() {
+  const char* path = std::getenv("PTOA_RESULTS");
+
+  if((path == nullptr) || (path[0] == '\0')) {
+    return false;
+  }
+
+  this->enable(path);
+  return true;
+}
+
+std::string Results::git_hash() {
+  return PTOA_GIT_HASH;
+}
+
+std::string Results::compiler_flags() {
+  std::string flags = PTOA_CXX_FLAGS;
+#ifdef PTOA_PROFILE_STAGES
+  // The stage profiler changes the timing of the decode loops
+  flags += " -DPTOA_PROFILE_STAGES";
+#endif
+  return flags;
+}
+
+std::string Results::compiler() {
+#if defined(__clang__)
+  return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+  return std::string("gcc ") + __VERSION__;
+#else
+  return "unknown";
+#endif
+}
+
+std::string Results::cpu_model() {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+
+  while(std::getline(cpuinfo, line)) {
+    if(line.compare(0, 10, "model name") == 0) {
+      size_t colon = line.find(':');
+      if(colon != std::string::npos) {
+        size_t start = line.find_first_not_of(' ', colon + 1);
+        return start == std::string::npos ? "" : line.substr(start);
+      }
+    }
+  }
+
+  return "unknown";
+}
+
+void Results::add(const std::string& benchmark, const config& configuration, const std::string& metric,
+                  const std::vector<double>& samples) {
+  if(!enabled_) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(records_mutex);
+  records.push_back({benchmark, configuration, metric, samples});
+}
+
+static void write_csv_field(std::ostream& out, const std::string& str) {
+  if(str.find_first_of(",\"\n") == std::string::npos) {
+    out << str;
+    return;
+  }
+
+  out << '"';
+  for(char c : str) {
+    if(c == '"') {
+      out << '"';
+    }
+    out << c;
+  }
+  out << '"';
+}
+
+// The configuration as one CSV field, "key=value;key=value"
+static std::string config_string(const Results::config& configuration) {
+  std::string str;
+  for(const auto& entry : configuration) {
+    str += (str.empty() ? "" : ";") + entry.first + "=" + entry.second;
+  }
+  return str;
+}
+
+bool Results::write() {
+  if(!enabled_) {
+    return true;
+  }
+
+  bool new_file = !std::ifstream(output_path).good();
+
+  std::ofstream out(output_path, std::ios::app);
+  if(!out.is_open()) {
+    std::cerr << "[ERROR] Could not open results file " << output_path << std::endl;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(records_mutex);
+  std::string cpu = cpu_model();
+  std::string comp = compiler();
+  std::string flags = compiler_flags();
+  std::string git = git_hash();
+
+  // Round trip exact
+  out << std::setprecision(std::numeric_limits<double>::max_digits10);
+
+  if(json) {
+    for(const record& r : records) {
+      out << "{\"benchmark\":";
+      write_json_string(out, r.benchmark);
+      out << ",\"config\":{";
+      for(size_t i=0; i<r.configuration.size(); i++) {
+        out << (i == 0 ? "" : ",");
+        write_json_string(out, r.configuration[i].first);
+        out << ":";
+        write_json_string(out, r.configuration[i].second);
+      }
+      out << "},\"metric\":";
+      write_json_string(out, r.metric);
+      out << ",\"samples\":[";
+      for(size_t i=0; i<r.samples.size(); i++) {
+        out << (i == 0 ? "" : ",") << r.samples[i];
+      }
+      out << "],\"cpu\":";
+      write_json_string(out, cpu);
+      out << ",\"compiler\":";
+      write_json_string(out, comp);
+      out << ",\"flags\":";
+      write_json_string(out, flags);
+      out << ",\"git\":";
+      write_json_string(out, git);
+      out << "}" << std::endl;
+    }
+  } else {
+    if(new_file) {
+      out << "benchmark,config,metric,sample,value,cpu,compiler,flags,git" << std::endl;
+    }
+    for(const record& r : records) {
+      std::string configuration = config_string(r.configuration);
+      for(size_t i=0; i<r.samples.size(); i++) {
+        write_csv_field(out, r.benchmark);
+        out << ",";
+        write_csv_field(out, configuration);
+        out << ",";
+        write_csv_field(out, r.metric);
+        out << "," << i << "," << r.samples[i] << ",";
+        write_csv_field(out, cpu);
+        out << ",";
+        write_csv_field(out, comp);
+        out << ",";
+        write_csv_field(out, flags);
+        out << ",";
+        write_csv_field(out, git);
+        out << std::endl;
+      }
+    }
+  }
+
+  records.clear();
+
+  return out.good();
+}
@@ -0,0 +1,72 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements. See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership. The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+// Machine readable benchmark results, for tracking regressions across commits and machines.
+// Every record holds all samples of one measurement, tagged with the CPU model, compiler, compiler flags and git commit
+// of the benchmark binary. Nothing is recorded until the results are enabled, either with Results::enable() or by setting
+// the PTOA_RESULTS environment variable to an output path and calling Results::enable_from_env().
+// Records are appended to the output file, so repeated runs of a benchmark accumulate samples. Paths ending in .json get
+// one JSON object per line, all other paths get CSV with one row per sample. Compare two result files with
+// compare_results.py.
+
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Results {
+  public:
+    using config = std::vector<std::pair<std::string, std::string>>;
+
+    struct record {
+      std::string benchmark;
+      config configuration;
+      std::string metric;
+      std::vector<double> samples;
+    };
+
+    static Results& global();
+
+    void enable(const std::string& output_path);
+    bool enable_from_env();
+    inline bool enabled() { return enabled_; }
+
+    // Compiled in by CMake, "unknown" otherwise
+    static std::string git_hash();
+    static std::string compiler_flags();
+    static std::string compiler();
+    // Model name from /proc/cpuinfo
+    static std::string cpu_model();
+
+    void add(const std::string& benchmark, const config& configuration, const std::string& metric,
+             const std::vector<double>& samples);
+
+    // Append all added records to the output path. Returns false if the file could not be written.
+    bool write();
+
+  private:
+    Results() {}
+
+    bool enabled_ = false;
+    bool json = false;
+    std::string output_path;
+
+    std::mutex records_mutex;
+    std::vector<record> records;
+};
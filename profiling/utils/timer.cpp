@@ -19,6 +19,9 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
 #include "timer.h"
 
@@ -43,3 +46,175 @@ double Timer::total() {
 
   return total;
 }
+
+double Timer::min() {
+  return *std::min_element(history.begin(), history.end());
+}
+
+double Timer::median() {
+  return this->percentile(50);
+}
+
+// Nearest-rank percentile (p between 0 and 100) of the recorded times
+double Timer::percentile(double p) {
+  std::vector<double> sorted(history);
+  std::sort(sorted.begin(), sorted.end());
+
+  size_t rank = (size_t) std::ceil((p/100)*sorted.size());
+  if(rank > 0) {
+    rank--;
+  }
+
+  return sorted[std::min(rank, sorted.size()-1)];
+}
+
+#ifdef __linux__
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static int open_counter(uint32_t type, uint64_t config) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+bool Timer::enable_counters() {
+  const uint64_t dtlb_read_miss = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+  counter_fds[CYCLES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+  counter_fds[INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+  counter_fds[LLC_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  counter_fds[BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+  counter_fds[DTLB_MISSES] = open_counter(PERF_TYPE_HW_CACHE, dtlb_read_miss);
+
+  for(int i=0; i<NUM_COUNTERS; i++) {
+    if(counter_fds[i] >= 0) {
+      counters_enabled = true;
+    }
+  }
+
+  if(!counters_enabled) {
+    std::cerr << "[WARNING] Could not open any hardware performance counters" << std::endl;
+  }
+
+  return counters_enabled;
+}
+
+void Timer::start_counters() {
+  for(int fd : counter_fds) {
+    if(fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void Timer::stop_counters() {
+  for(int i=0; i<NUM_COUNTERS; i++) {
+    if(counter_fds[i] >= 0) {
+      ioctl(counter_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+
+  for(int i=0; i<NUM_COUNTERS; i++) {
+    uint64_t result[3] = {0, 0, 0};
+
+    counter_values[i] = 0;
+    if((counter_fds[i] >= 0) && (read(counter_fds[i], result, sizeof(result)) == sizeof(result)) && (result[2] > 0)) {
+      // Scale for the time the counter was multiplexed out
+      counter_values[i] = (double) result[0] * ((double) result[1] / result[2]);
+    }
+  }
+}
+
+Timer::~Timer() {
+  for(int fd : counter_fds) {
+    if(fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+#else
+
+bool Timer::enable_counters() {
+  std::cerr << "[WARNING] Hardware performance counters are only supported on Linux" << std::endl;
+  return false;
+}
+
+void Timer::start_counters() {}
+void Timer::stop_counters() {}
+Timer::~Timer() {}
+
+#endif
+
+bool Timer::counter_available(counter_id counter) {
+  return counter_fds[counter] >= 0;
+}
+
+double Timer::counter_average(counter_id counter) {
+  double total = 0;
+
+  if(counter_history.empty()) {
+    return 0;
+  }
+
+  for(const auto& values : counter_history) {
+    total += values[counter];
+  }
+
+  return total/counter_history.size();
+}
+
+double Timer::ipc() {
+  double cycles = this->counter_average(CYCLES);
+
+  return cycles > 0 ? this->counter_average(INSTRUCTIONS)/cycles : 0;
+}
+
+double Timer::cycles_per(int64_t num_values) {
+  return num_values > 0 ? this->counter_average(CYCLES)/num_values : 0;
+}
+
+double Timer::bytes_per_cycle(int64_t num_bytes) {
+  double cycles = this->counter_average(CYCLES);
+
+  return cycles > 0 ? num_bytes/cycles : 0;
+}
+
+// Print the average counter values per start()/stop() pair and the metrics derived from them
+void Timer::print_counters(int64_t num_values, int64_t num_bytes) {
+  static const char* names[NUM_COUNTERS] = {"cycles", "instructions", "LLC misses", "branch misses", "dTLB misses"};
+
+  if(!counters_enabled || counter_history.empty()) {
+    return;
+  }
+
+  for(int i=0; i<NUM_COUNTERS; i++) {
+    std::cout << std::setw(16) << names[i] << ": ";
+    if(this->counter_available((counter_id) i)) {
+      std::cout << std::fixed << std::setprecision(0) << this->counter_average((counter_id) i) << std::defaultfloat << std::endl;
+    } else {
+      std::cout << "not supported" << std::endl;
+    }
+  }
+
+  if(this->counter_available(CYCLES)) {
+    std::cout << std::setw(16) << "IPC" << ": " << this->ipc() << std::endl;
+    std::cout << std::setw(16) << "cycles/value" << ": " << this->cycles_per(num_values) << std::endl;
+    std::cout << std::setw(16) << "bytes/cycle" << ": " << this->bytes_per_cycle(num_bytes) << std::endl;
+  }
+}
@@ -19,9 +19,22 @@
 
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <cstdint>
 #include <vector>
 
+// Hardware performance counters that can be captured between start() and stop() on Linux, through perf_event_open.
+// The counters include all threads started by the calling thread after enable_counters().
+enum counter_id {
+  CYCLES = 0,
+  INSTRUCTIONS,
+  LLC_MISSES,
+  BRANCH_MISSES,
+  DTLB_MISSES,
+  NUM_COUNTERS
+};
+
 class Timer {
   using system_clock = std::chrono::system_clock;
   using nanoseconds = std::chrono::nanoseconds;
@@ -33,17 +46,60 @@ class Timer {
   
     time_point start_{};
     time_point stop_{};
+
+    bool counters_enabled = false;
+    std::array<int, NUM_COUNTERS> counter_fds;
+    std::array<double, NUM_COUNTERS> counter_values;
+    std::vector<std::array<double, NUM_COUNTERS>> counter_history;
+
+    void start_counters();
+    void stop_counters();
   
   public:
-    Timer() = default;
+    Timer() { counter_fds.fill(-1); counter_values.fill(0); }
+    ~Timer();
+
+    // Owns the perf event file descriptors
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
   
-    inline void start() { start_ = std::chrono::high_resolution_clock::now(); }
-    inline void stop() { stop_ = std::chrono::high_resolution_clock::now(); }
+    inline void start() {
+      if(counters_enabled) {
+        start_counters();
+      }
+      start_ = std::chrono::high_resolution_clock::now();
+    }
+    inline void stop() {
+      stop_ = std::chrono::high_resolution_clock::now();
+      if(counters_enabled) {
+        stop_counters();
+      }
+    }
   
-    inline void record() { history.push_back(this->seconds()); }
-    inline void clear_history() { history.clear(); }
+    inline void record() {
+      history.push_back(this->seconds());
+      if(counters_enabled) {
+        counter_history.push_back(counter_values);
+      }
+    }
+    inline void clear_history() { history.clear(); counter_history.clear(); }
+    inline const std::vector<double>& samples() const { return history; }
+
+    // Returns false if none of the counters could be opened (e.g. because of /proc/sys/kernel/perf_event_paranoid)
+    bool enable_counters();
+    bool counter_available(counter_id counter);
+
+    // Averages over the recorded start()/stop() pairs
+    double counter_average(counter_id counter);
+    double ipc();
+    double cycles_per(int64_t num_values);
+    double bytes_per_cycle(int64_t num_bytes);
+    void print_counters(int64_t num_values, int64_t num_bytes);
   
     double seconds();
     double average();
     double total();
+    double min();
+    double median();
+    double percentile(double p);
 };
@@ -0,0 +1,109 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements. See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership. The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+#include "trace.h"
+#include "json.h"
+
+Trace& Trace::global() {
+  static Trace trace;
+  return trace;
+}
+
+void Trace::enable(const std::string& output_path) {
+  this->output_path = output_path;
+  enabled_.store(true);
+}
+
+bool Trace::enable_from_env() {
+  const char* path = std::getenv("PTOA_TRACE");
+
+  if((path == nullptr) || (path[0] == '\0')) {
+    return false;
+  }
+
+  this->enable(path);
+  return true;
+}
+
+Trace::thread_events* Trace::local_events() {
+  static thread_local thread_events* events = nullptr;
+
+  if(events == nullptr) {
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    threads.emplace_back(new thread_events());
+    events = threads.back().get();
+    events->tid = (int) threads.size();
+  }
+
+  return events;
+}
+
+void Trace::name_thread(const std::string& thread_name) {
+  local_events()->thread_name = thread_name;
+}
+
+void Trace::record(const char* name, const char* category, int64_t start_ns, int64_t stop_ns) {
+  local_events()->events.push_back({name, category, start_ns, stop_ns - start_ns});
+}
+
+// Should only be called when no other thread is recording anymore
+bool Trace::write() {
+  if(!this->enabled()) {
+    return true;
+  }
+
+  std::ofstream out(output_path);
+  if(!out.is_open()) {
+    std::cerr << "[ERROR] Could not open trace file " << output_path << std::endl;
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(threads_mutex);
+  bool first = true;
+
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" << std::endl;
+  out << std::fixed << std::setprecision(3);
+
+  for(const auto& thread : threads) {
+    if(!thread->thread_name.empty()) {
+      out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->tid << ",\"args\":{\"name\":";
+      write_json_string(out, thread->thread_name);
+      out << "}}";
+      first = false;
+    }
+
+    // Timestamps and durations are in microseconds
+    for(const event& e : thread->events) {
+      out << (first ? "" : ",\n") << "{\"name\":";
+      write_json_string(out, e.name);
+      out << ",\"cat\":";
+      write_json_string(out, e.category);
+      out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->tid
+          << ",\"ts\":" << e.start_ns/1e3 << ",\"dur\":" << e.duration_ns/1e3 << "}";
+      first = false;
+    }
+  }
+
+  out << std::endl << "]}" << std::endl;
+
+  return out.good();
+}
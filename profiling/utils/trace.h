@@ -0,0 +1,102 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements. See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership. The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License. You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied. See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+// Event tracer writing Chrome trace JSON (chrome://tracing, https://ui.perfetto.dev).
+// Every thread records its spans in its own buffer, so recording does not take a lock. Nothing is recorded until the
+// trace is enabled, either with Trace::enable() or by setting the PTOA_TRACE environment variable to an output path
+// and calling Trace::enable_from_env().
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Trace {
+  using steady_clock = std::chrono::steady_clock;
+
+  public:
+    struct event {
+      const char* name;
+      const char* category;
+      int64_t start_ns;
+      int64_t duration_ns;
+    };
+
+    struct thread_events {
+      int tid;
+      std::string thread_name;
+      std::vector<event> events;
+    };
+
+    static Trace& global();
+
+    void enable(const std::string& output_path);
+    bool enable_from_env();
+    inline bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    // Name shown for the calling thread in the trace viewer
+    void name_thread(const std::string& thread_name);
+
+    inline int64_t now() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock::now() - origin).count();
+    }
+
+    // name and category have to be string literals or otherwise outlive the trace
+    void record(const char* name, const char* category, int64_t start_ns, int64_t stop_ns);
+
+    // Write all recorded events to the output path. Returns false if the file could not be written.
+    bool write();
+
+  private:
+    Trace() : origin(steady_clock::now()) {}
+    thread_events* local_events();
+
+    std::atomic<bool> enabled_{false};
+    std::string output_path;
+    steady_clock::time_point origin;
+
+    std::mutex threads_mutex;
+    std::vector<std::unique_ptr<thread_events>> threads;
+};
+
+// Records the time between construction and destruction as one span of the calling thread
+class TraceSpan {
+  public:
+    TraceSpan(const char* name, const char* category) : name(name), category(category), start_ns(-1) {
+      if(Trace::global().enabled()) {
+        start_ns = Trace::global().now();
+      }
+    }
+
+    ~TraceSpan() {
+      if(start_ns >= 0) {
+        Trace::global().record(name, category, start_ns, Trace::global().now());
+      }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+  private:
+    const char* name;
+    const char* category;
+    int64_t start_ns;
+};
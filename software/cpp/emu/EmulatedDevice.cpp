@@ -0,0 +1,442 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "EmulatedDevice.h"
+#include "HardwareModel.h"
+#include "ptoa.h"
+
+namespace ptoa {
+
+static std::string env_string(const char* name, const std::string& fallback) {
+    const char* value = std::getenv(name);
+    return value == nullptr ? fallback : value;
+}
+
+EmulatedDevice::EmulatedDevice() {
+    type = kernel_type::PRIM32;
+    enc = encoding::PLAIN;
+    num_instances = 0;
+    link_bandwidth = 0;
+    link_latency = 0;
+    kernel_model = false;
+}
+
+EmulatedDevice::~EmulatedDevice() {
+    terminate();
+}
+
+status EmulatedDevice::parse_config() {
+    const std::string kernel = env_string("PTOA_EMU_KERNEL", "prim32");
+    if(kernel == "prim32") {
+        type = kernel_type::PRIM32;
+    } else if(kernel == "prim64") {
+        type = kernel_type::PRIM64;
+    } else if(kernel == "str") {
+        type = kernel_type::STRING;
+    } else {
+        std::cerr << "[ERROR] Unknown kernel " << kernel << " in PTOA_EMU_KERNEL, expected prim32, prim64 or str" << std::endl;
+        return status::FAIL;
+    }
+
+    const std::string encoding_name = env_string("PTOA_EMU_ENCODING", type == kernel_type::STRING ? "delta_length" : "plain");
+    if(encoding_name == "plain") {
+        enc = encoding::PLAIN;
+    } else if(encoding_name == "delta") {
+        enc = encoding::DELTA;
+    } else if(encoding_name == "delta_length") {
+        enc = encoding::DELTA_LENGTH;
+    } else {
+        std::cerr << "[ERROR] Unknown encoding " << encoding_name << " in PTOA_EMU_ENCODING, expected plain, delta or delta_length" << std::endl;
+        return status::FAIL;
+    }
+    if((type == kernel_type::STRING) != (enc == encoding::DELTA_LENGTH)) {
+        std::cerr << "[ERROR] The string kernels read DELTA_LENGTH pages, the integer kernels PLAIN or DELTA pages" << std::endl;
+        return status::FAIL;
+    }
+
+    num_instances = std::atoi(env_string("PTOA_EMU_INSTANCES", "0").c_str());
+    if(num_instances < 0 || (num_instances > 0 && type == kernel_type::STRING)) {
+        std::cerr << "[ERROR] PTOA_EMU_INSTANCES should be 0, or the number of instances of an integer kernel" << std::endl;
+        return status::FAIL;
+    }
+
+    link_bandwidth = std::atof(env_string("PTOA_EMU_LINK_GBPS", "0").c_str())*1e9;
+    link_latency = std::atof(env_string("PTOA_EMU_LINK_LATENCY_US", "0").c_str())*1e-6;
+    kernel_model = env_string("PTOA_EMU_KERNEL_MODEL", "0") == "1";
+
+    return status::OK;
+}
+
+status EmulatedDevice::init() {
+    terminate();
+    if(parse_config() != status::OK) {
+        return status::FAIL;
+    }
+
+    if(num_instances > 0) {
+        registers.assign(FPGA_REG_BASE + num_instances*FPGA_INSTANCE_REGS, 0);
+    } else {
+        registers.assign(FPGA_REG_MAX_SIZE + 2, 0);
+    }
+
+    units.clear();
+    for(int i=0; i<std::max(num_instances, 1); i++) {
+        units.emplace_back(new kernel_unit());
+        units.back()->busy = false;
+        units.back()->done = false;
+    }
+
+    std::cout << "Platform [" << EMU_PLATFORM_NAME << "]: Emulating " << std::max(num_instances, 1) << " kernel(s) in software"
+              << (link_bandwidth > 0 || link_latency > 0 ? ", with modeled copies" : "")
+              << (kernel_model ? ", with modeled kernel times" : "") << "." << std::endl;
+
+    return status::OK;
+}
+
+// Waits for the kernels that are still running and frees the device buffers the host did not free
+void EmulatedDevice::terminate() {
+    for(std::unique_ptr<kernel_unit>& unit : units) {
+        if(unit->thread.joinable()) {
+            unit->thread.join();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(allocation_mutex);
+    for(const auto& allocation : allocations) {
+        free((void*) allocation.first);
+    }
+    allocations.clear();
+}
+
+int EmulatedDevice::control_unit(uint64_t offset) const {
+    if(num_instances == 0) {
+        return offset == EMU_REG_CONTROL ? 0 : -1;
+    }
+    if(offset < FPGA_REG_BASE || (offset - FPGA_REG_BASE) % FPGA_INSTANCE_REGS != FPGA_INSTANCE_CONTROL) {
+        return -1;
+    }
+    return (offset - FPGA_REG_BASE)/FPGA_INSTANCE_REGS;
+}
+
+int EmulatedDevice::status_unit(uint64_t offset) const {
+    if(num_instances == 0) {
+        return offset == EMU_REG_STATUS ? 0 : -1;
+    }
+    if(offset < FPGA_REG_BASE || (offset - FPGA_REG_BASE) % FPGA_INSTANCE_REGS != FPGA_INSTANCE_STATUS) {
+        return -1;
+    }
+    return (offset - FPGA_REG_BASE)/FPGA_INSTANCE_REGS;
+}
+
+status EmulatedDevice::write_mmio(uint64_t offset, uint32_t value) {
+    if(offset >= registers.size()) {
+        std::cerr << "[ERROR] Write to register " << offset << ", the emulated device has " << registers.size() << " registers" << std::endl;
+        return status::FAIL;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(register_mutex);
+        registers[offset] = value;
+    }
+
+    const int unit = control_unit(offset);
+    if(unit >= 0) {
+        control(unit, value);
+    }
+
+    return status::OK;
+}
+
+status EmulatedDevice::read_mmio(uint64_t offset, uint32_t* value) {
+    if(offset >= registers.size()) {
+        std::cerr << "[ERROR] Read from register " << offset << ", the emulated device has " << registers.size() << " registers" << std::endl;
+        return status::FAIL;
+    }
+
+    const int unit = status_unit(offset);
+    if(unit >= 0) {
+        if(units[unit]->done) {
+            *value = FPGA_STATUS_DONE;
+        } else {
+            *value = units[unit]->busy ? EMU_STATUS_BUSY : EMU_STATUS_IDLE;
+        }
+        return status::OK;
+    }
+
+    std::lock_guard<std::mutex> lock(register_mutex);
+    *value = registers[offset];
+    return status::OK;
+}
+
+// A reset waits for a running kernel, as an emulated kernel can't be stopped halfway
+void EmulatedDevice::control(int unit, uint32_t value) {
+    kernel_unit& kernel = *units[unit];
+
+    if(value & FPGA_CONTROL_RESET) {
+        if(kernel.thread.joinable()) {
+            kernel.thread.join();
+        }
+        kernel.busy = false;
+        kernel.done = false;
+    }
+
+    if(value & FPGA_CONTROL_START) {
+        if(kernel.busy) {
+            std::cerr << "[ERROR] Kernel " << unit << " was started while it is busy, the start is ignored" << std::endl;
+            return;
+        }
+        if(kernel.thread.joinable()) {
+            kernel.thread.join();
+        }
+        kernel.done = false;
+        kernel.busy = true;
+        kernel.thread = std::thread(&EmulatedDevice::run_kernel, this, unit, read_args(unit));
+    }
+}
+
+// Called with register_mutex held
+da_t EmulatedDevice::read_address(uint64_t offset) {
+    dau_t mmio64_reader;
+    mmio64_reader.lo = registers[offset];
+    mmio64_reader.hi = registers[offset + 1];
+    return mmio64_reader.full;
+}
+
+EmulatedDevice::kernel_args EmulatedDevice::read_args(int unit) {
+    std::lock_guard<std::mutex> lock(register_mutex);
+    kernel_args args;
+
+    if(num_instances == 0) {
+        args.num_values = registers[FPGA_REG_NUM_VAL];
+        args.page_address = read_address(FPGA_REG_PAGE_ADDR);
+        args.max_size = read_address(FPGA_REG_MAX_SIZE);
+        args.values_address = read_address(FPGA_REG_BUFFER_ADDR);
+        args.chars_address = read_address(FPGA_REG_BUFFER_ADDR + 2);
+    } else {
+        const uint64_t base = FPGA_REG_BASE + unit*FPGA_INSTANCE_REGS;
+        args.num_values = registers[base + FPGA_INSTANCE_NUM_VAL];
+        args.page_address = read_address(base + FPGA_INSTANCE_PAGE_ADDR);
+        args.max_size = read_address(base + FPGA_INSTANCE_MAX_SIZE);
+        args.values_address = read_address(base + FPGA_INSTANCE_VALUES_ADDR);
+        args.chars_address = 0;
+    }
+
+    return args;
+}
+
+// A kernel that fails still reports done, like it would with corrupted pages on the FPGA, only with an error on stderr
+void EmulatedDevice::run_kernel(int unit, kernel_args args) {
+    const clock::time_point start = clock::now();
+
+    double model_seconds = 0;
+    if(decode(args, &model_seconds) != status::OK) {
+        std::cerr << "[ERROR] Emulated kernel " << unit << " failed, its output is incomplete" << std::endl;
+    }
+    if(kernel_model) {
+        std::this_thread::sleep_until(start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(model_seconds)));
+    }
+
+    units[unit]->done = true;
+    units[unit]->busy = false;
+}
+
+// The characters of string columns are not checked against the room in their buffer, the host sizes it for the number of
+// characters like it does for the hardware
+status EmulatedDevice::decode(const kernel_args& args, double* model_seconds) {
+    const int32_t prim_width = type == kernel_type::PRIM64 ? 64 : 32;
+
+    if(args.max_size <= 0 || device_room(args.page_address) < args.max_size) {
+        std::cerr << "[ERROR] The " << args.max_size << " bytes from page address 0x" << std::hex << args.page_address << std::dec
+                  << " are not in a device buffer" << std::endl;
+        return status::FAIL;
+    }
+
+    // Pages past the maximum size are out of reach of the kernel
+    const uint8_t* pages = (const uint8_t*) args.page_address;
+    SWParquetReader reader(std::make_shared<arrow::Buffer>(pages, args.max_size));
+    if(reader.build_page_directory(0) != status::OK) {
+        return status::FAIL;
+    }
+    int64_t values_in_pages = 0;
+    for(const page_directory_entry& page : reader.get_page_directory()) {
+        if(page.offset + page.metadata_size + page.compressed_size > args.max_size) {
+            break;
+        }
+        values_in_pages += page.num_values;
+    }
+    if(values_in_pages < args.num_values) {
+        std::cerr << "[ERROR] Only " << values_in_pages << " of the " << args.num_values << " values are in the pages within the maximum size" << std::endl;
+        return status::FAIL;
+    }
+
+    if(type == kernel_type::STRING) {
+        const int64_t offsets_size = (args.num_values + 1)*sizeof(int32_t);
+        const int64_t chars_room = device_room(args.chars_address);
+        if(device_room(args.values_address) < offsets_size || chars_room == 0) {
+            std::cerr << "[ERROR] The offsets and characters of " << args.num_values << " strings are not in device buffers" << std::endl;
+            return status::FAIL;
+        }
+
+        std::shared_ptr<arrow::StringArray> string_array;
+        if(reader.read_string(args.num_values, 0, &string_array, std::make_shared<arrow::MutableBuffer>((uint8_t*) args.values_address, offsets_size),
+                              std::make_shared<arrow::MutableBuffer>((uint8_t*) args.chars_address, chars_room), enc) != status::OK) {
+            return status::FAIL;
+        }
+    } else {
+        const int64_t values_size = args.num_values*prim_width/8;
+        if(device_room(args.values_address) < values_size) {
+            std::cerr << "[ERROR] The " << args.num_values << " values are not in a device buffer" << std::endl;
+            return status::FAIL;
+        }
+
+        std::shared_ptr<arrow::PrimitiveArray> prim_array;
+        if(reader.read_prim(prim_width, args.num_values, 0, &prim_array, std::make_shared<arrow::MutableBuffer>((uint8_t*) args.values_address, values_size), enc) != status::OK) {
+            return status::FAIL;
+        }
+    }
+
+    if(kernel_model) {
+        int64_t cycles;
+        if(model_cycles(reader, pages, prim_width, args.num_values, &cycles) != status::OK) {
+            return status::FAIL;
+        }
+        *model_seconds = cycles/(HW_CLOCK_MHZ*1e6);
+    }
+
+    return status::OK;
+}
+
+// Cycles HardwareModel predicts for the pages that hold the first num_values values, like pagecounter does for whole files. Only
+// the lengths of strings are modeled, the characters are not.
+status EmulatedDevice::model_cycles(SWParquetReader& reader, const uint8_t* pages, int32_t prim_width, int64_t num_values, int64_t* cycles) {
+    const int elements_per_cycle = prim_width == 64 ? EMU_ELEMENTS_PER_CYCLE_64 : EMU_ELEMENTS_PER_CYCLE_32;
+    std::vector<int64_t> bitwidth_counts(65, 0);
+    std::vector<delta_block_info> blocks;
+    int64_t values_left = num_values;
+
+    *cycles = 0;
+    for(const page_directory_entry& page : reader.get_page_directory()) {
+        if(values_left <= 0) {
+            break;
+        }
+        values_left -= page.num_values;
+        *cycles += hw_page_header_cycles(page.metadata_size);
+
+        if(enc == encoding::PLAIN) {
+            continue;
+        }
+
+        int32_t page_num_values;
+        const uint8_t* end_ptr;
+        if(reader.inspect_delta_page(enc == encoding::DELTA_LENGTH ? 32 : prim_width, pages + page.offset, &blocks, &page_num_values, &end_ptr) != status::OK) {
+            return status::FAIL;
+        }
+        for(const delta_block_info& block : blocks) {
+            for(int i=0; i<block.num_miniblocks; i++) {
+                bitwidth_counts[std::min((int) block.bitwidths[i], 64)]++;
+            }
+        }
+    }
+
+    if(enc == encoding::PLAIN) {
+        *cycles += hw_plain_cycles(num_values, elements_per_cycle);
+    } else {
+        *cycles += hw_delta_cycles(bitwidth_counts, elements_per_cycle, EMU_DEC_DATA_WIDTH);
+    }
+
+    return status::OK;
+}
+
+void EmulatedDevice::model_transfer(int64_t size, clock::time_point start) {
+    if(link_bandwidth <= 0 && link_latency <= 0) {
+        return;
+    }
+
+    const double seconds = link_latency + (link_bandwidth > 0 ? size/link_bandwidth : 0);
+    std::this_thread::sleep_until(start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds)));
+}
+
+int64_t EmulatedDevice::device_room(da_t address) {
+    std::lock_guard<std::mutex> lock(allocation_mutex);
+
+    auto allocation = allocations.upper_bound(address);
+    if(allocation == allocations.begin()) {
+        return 0;
+    }
+    allocation--;
+
+    const da_t end = allocation->first + allocation->second;
+    return address < end ? end - address : 0;
+}
+
+// Device buffers are aligned like the host memory the oc-accel kernels read
+status EmulatedDevice::device_malloc(da_t* device_address, int64_t size) {
+    void* buffer = nullptr;
+    if(size < 0 || posix_memalign(&buffer, FPGA_HOST_ALIGNMENT, std::max(size, (int64_t) 1)) != 0) {
+        std::cerr << "[ERROR] Could not allocate " << size << " bytes of emulated device memory" << std::endl;
+        return status::FAIL;
+    }
+
+    std::lock_guard<std::mutex> lock(allocation_mutex);
+    allocations[(da_t) buffer] = size;
+    *device_address = (da_t) buffer;
+    return status::OK;
+}
+
+status EmulatedDevice::device_free(da_t device_address) {
+    std::lock_guard<std::mutex> lock(allocation_mutex);
+
+    auto allocation = allocations.find(device_address);
+    if(allocation == allocations.end()) {
+        std::cerr << "[ERROR] No device buffer at 0x" << std::hex << device_address << std::dec << " to free" << std::endl;
+        return status::FAIL;
+    }
+
+    free((void*) device_address);
+    allocations.erase(allocation);
+    return status::OK;
+}
+
+status EmulatedDevice::copy_host_to_device(const uint8_t* host_source, da_t device_destination, int64_t size) {
+    const clock::time_point start = clock::now();
+
+    if(size < 0 || device_room(device_destination) < size) {
+        std::cerr << "[ERROR] A copy of " << size << " bytes to 0x" << std::hex << device_destination << std::dec
+                  << " does not fit in a device buffer" << std::endl;
+        return status::FAIL;
+    }
+    std::memcpy((void*) device_destination, host_source, size);
+
+    model_transfer(size, start);
+    return status::OK;
+}
+
+status EmulatedDevice::copy_device_to_host(da_t device_source, uint8_t* host_destination, int64_t size) {
+    const clock::time_point start = clock::now();
+
+    if(size < 0 || device_room(device_source) < size) {
+        std::cerr << "[ERROR] A copy of " << size << " bytes from 0x" << std::hex << device_source << std::dec
+                  << " is not in a device buffer" << std::endl;
+        return status::FAIL;
+    }
+    std::memcpy(host_destination, (const void*) device_source, size);
+
+    model_transfer(size, start);
+    return status::OK;
+}
+
+}
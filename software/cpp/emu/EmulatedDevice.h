@@ -0,0 +1,138 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MultiKernelReader.h"
+#include "SWParquetReader.h"
+#include "ptoa.h"
+
+// Name the Fletcher runtime knows the platform by, it loads libfletcher_<name>.so. MultiKernelReader only runs on a platform
+// named FPGA_MULTI_INSTANCE_PLATFORM, keep the two the same.
+#define EMU_PLATFORM_NAME "ptoa_emu"
+
+// Control and status register of the single kernel wrappers, and the status bits of the Fletcher UserCoreController besides
+// FPGA_STATUS_DONE
+#define EMU_REG_CONTROL 0
+#define EMU_REG_STATUS 1
+#define EMU_STATUS_IDLE 0x1
+#define EMU_STATUS_BUSY 0x2
+
+// Values per cycle of the decoders in the modeled kernels, those of the prim32 and prim64 builds in platforms/, and the
+// decoder data width of the _decw_64 variants
+#define EMU_ELEMENTS_PER_CYCLE_32 16
+#define EMU_ELEMENTS_PER_CYCLE_64 8
+#define EMU_DEC_DATA_WIDTH 64
+
+namespace ptoa{
+
+/**
+ * Software stand-in for an FPGA with ParquetReader kernels, behind the MMIO registers and device buffers of a Fletcher
+ * platform. Device memory is host memory, and a kernel that is started decodes the pages at its page address with
+ * SWParquetReader on a thread of its own, so the host polls it like a real kernel.
+ *
+ * Without instances the registers are those of the single kernel wrappers in examples/, read by FpgaReader. With instances
+ * every instance has its own register block like the multi-instance wrappers read by MultiKernelReader.
+ *
+ * Copies and kernels take as long as the work on the host does. With a link bandwidth they take at least as long as the
+ * modeled transfer, and with the kernel model at least as long as HardwareModel predicts for the hardware at HW_CLOCK_MHZ.
+ *
+ * The configuration comes from the environment when the platform is initialized:
+ *  PTOA_EMU_KERNEL: prim32 (default), prim64 or str, the column type of the emulated kernels
+ *  PTOA_EMU_ENCODING: plain, delta or delta_length. Defaults to plain for integers and delta_length for strings.
+ *  PTOA_EMU_INSTANCES: number of instances with register blocks of their own, 0 (default) for the single kernel wrappers
+ *  PTOA_EMU_LINK_GBPS: modeled bandwidth of the copies between host and device in GB/s, 0 (default) disables the model
+ *  PTOA_EMU_LINK_LATENCY_US: modeled latency of every copy in microseconds, 0 by default
+ *  PTOA_EMU_KERNEL_MODEL: 1 to make kernels take at least the time HardwareModel predicts, 0 by default
+ */
+class EmulatedDevice {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    EmulatedDevice();
+    ~EmulatedDevice();
+    EmulatedDevice(const EmulatedDevice&) = delete;
+    EmulatedDevice& operator=(const EmulatedDevice&) = delete;
+
+    status init();
+    void terminate();
+
+    status write_mmio(uint64_t offset, uint32_t value);
+    status read_mmio(uint64_t offset, uint32_t* value);
+
+    status device_malloc(da_t* device_address, int64_t size);
+    status device_free(da_t device_address);
+    status copy_host_to_device(const uint8_t* host_source, da_t device_destination, int64_t size);
+    status copy_device_to_host(da_t device_source, uint8_t* host_destination, int64_t size);
+
+  private:
+    enum class kernel_type {PRIM32, PRIM64, STRING};
+
+    // Registers of a kernel, taken when it is started
+    struct kernel_args {
+        int64_t num_values;
+        da_t page_address;
+        int64_t max_size;
+        // Values of integer columns, offsets of string columns
+        da_t values_address;
+        da_t chars_address;
+    };
+
+    // A kernel and the thread it runs on
+    struct kernel_unit {
+        std::thread thread;
+        std::atomic<bool> busy;
+        std::atomic<bool> done;
+    };
+
+    status parse_config();
+    // Kernel whose control or status register is at offset, -1 for other registers
+    int control_unit(uint64_t offset) const;
+    int status_unit(uint64_t offset) const;
+    void control(int unit, uint32_t value);
+    kernel_args read_args(int unit);
+    void run_kernel(int unit, kernel_args args);
+    status decode(const kernel_args& args, double* model_seconds);
+    status model_cycles(SWParquetReader& reader, const uint8_t* pages, int32_t prim_width, int64_t num_values, int64_t* cycles);
+    void model_transfer(int64_t size, clock::time_point start);
+
+    // Bytes from address until the end of its device buffer, 0 if it is not in one
+    int64_t device_room(da_t address);
+    da_t read_address(uint64_t offset);
+
+    kernel_type type;
+    encoding enc;
+    int num_instances;
+    double link_bandwidth;
+    double link_latency;
+    bool kernel_model;
+
+    std::vector<uint32_t> registers;
+    std::vector<std::unique_ptr<kernel_unit>> units;
+    std::mutex register_mutex;
+
+    // Start address and size of every device buffer
+    std::map<da_t, int64_t> allocations;
+    std::mutex allocation_mutex;
+};
+
+}
@@ -0,0 +1,95 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+/*
+ * Fletcher platform library of the emulated device. fletcher::Platform::Make("ptoa_emu", ...) loads it as
+ * libfletcher_ptoa_emu.so, like the aws-f1 and oc-accel platform libraries, so FpgaReader and MultiKernelReader run unchanged
+ * with PTOA_PLATFORM=ptoa_emu. See EmulatedDevice.h for its configuration.
+ */
+
+#include <cstring>
+
+#include "fletcher/fletcher.h"
+
+#include "EmulatedDevice.h"
+#include "ptoa.h"
+
+static ptoa::EmulatedDevice device;
+
+static fstatus_t fletcher_status(ptoa::status s) {
+    return s == ptoa::status::OK ? FLETCHER_STATUS_OK : FLETCHER_STATUS_ERROR;
+}
+
+// Buffers of the record batches of a context are copied to device buffers like on aws-f1
+static fstatus_t copy_to_new_buffer(const uint8_t* host_source, da_t* device_destination, int64_t size) {
+    if(device.device_malloc(device_destination, size) != ptoa::status::OK) {
+        return FLETCHER_STATUS_ERROR;
+    }
+    return fletcher_status(device.copy_host_to_device(host_source, *device_destination, size));
+}
+
+extern "C" {
+
+fstatus_t platformGetName(char* name, size_t size) {
+    if(size == 0) {
+        return FLETCHER_STATUS_ERROR;
+    }
+    std::strncpy(name, EMU_PLATFORM_NAME, size - 1);
+    name[size - 1] = '\0';
+    return FLETCHER_STATUS_OK;
+}
+
+fstatus_t platformInit(void* arg) {
+    (void) arg;
+    return fletcher_status(device.init());
+}
+
+fstatus_t platformWriteMMIO(uint64_t offset, uint32_t value) {
+    return fletcher_status(device.write_mmio(offset, value));
+}
+
+fstatus_t platformReadMMIO(uint64_t offset, uint32_t* value) {
+    return fletcher_status(device.read_mmio(offset, value));
+}
+
+fstatus_t platformDeviceMalloc(da_t* device_address, int64_t size) {
+    return fletcher_status(device.device_malloc(device_address, size));
+}
+
+fstatus_t platformDeviceFree(da_t device_address) {
+    return fletcher_status(device.device_free(device_address));
+}
+
+fstatus_t platformCopyHostToDevice(const uint8_t* host_source, da_t device_destination, int64_t size) {
+    return fletcher_status(device.copy_host_to_device(host_source, device_destination, size));
+}
+
+fstatus_t platformCopyDeviceToHost(const da_t device_source, uint8_t* host_destination, int64_t size) {
+    return fletcher_status(device.copy_device_to_host(device_source, host_destination, size));
+}
+
+fstatus_t platformPrepareHostBuffer(const uint8_t* host_source, da_t* device_destination, int64_t size, int* alloced) {
+    *alloced = 1;
+    return copy_to_new_buffer(host_source, device_destination, size);
+}
+
+fstatus_t platformCacheHostBuffer(const uint8_t* host_source, da_t* device_destination, int64_t size) {
+    return copy_to_new_buffer(host_source, device_destination, size);
+}
+
+fstatus_t platformTerminate(void* arg) {
+    (void) arg;
+    device.terminate();
+    return FLETCHER_STATUS_OK;
+}
+
+}
@@ -0,0 +1,139 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "CompletionPoller.h"
+#include "ptoa.h"
+
+namespace ptoa {
+
+CompletionPoller::CompletionPoller() {
+    fixed_interval_us = 0;
+    throughput = POLL_INITIAL_THROUGHPUT;
+    total_polls = 0;
+}
+
+CompletionPoller::poll_state CompletionPoller::begin(int64_t bytes) {
+    poll_state state;
+    state.start = clock::now();
+    state.last_poll = state.start;
+    state.expected_seconds = bytes/throughput;
+    state.backoff_seconds = POLL_BACKOFF_MIN_US*1e-6;
+    state.bytes = bytes;
+    state.polls = 0;
+    return state;
+}
+
+CompletionPoller::clock::time_point CompletionPoller::next_poll(poll_state* state) {
+    using seconds = std::chrono::duration<double>;
+
+    if(fixed_interval_us > 0) {
+        return state->last_poll + std::chrono::microseconds(fixed_interval_us);
+    }
+
+    // Sleep through most of the expected duration, unless that is shorter than the spin phase
+    const double sleep_seconds = POLL_SLEEP_FRACTION*state->expected_seconds;
+    const bool sleeps = sleep_seconds > POLL_SPIN_US*1e-6;
+    if(state->polls == 0 && sleeps) {
+        return state->start + std::chrono::duration_cast<clock::duration>(seconds(sleep_seconds));
+    }
+
+    // Spin from the first poll on, for short runs until some time after they are expected to finish, then back off
+    const double spin_end = (sleeps ? sleep_seconds : state->expected_seconds) + POLL_SPIN_US*1e-6;
+    const clock::time_point now = clock::now();
+    if(seconds(now - state->start).count() < spin_end) {
+        return now;
+    }
+
+    const double max_backoff = std::min(std::max(POLL_BACKOFF_MAX_FRACTION*state->expected_seconds, POLL_BACKOFF_MIN_US*1e-6), POLL_BACKOFF_MAX_US*1e-6);
+    const double backoff = std::min(state->backoff_seconds, max_backoff);
+    state->backoff_seconds = std::min(2*state->backoff_seconds, max_backoff);
+    return now + std::chrono::duration_cast<clock::duration>(seconds(backoff));
+}
+
+void CompletionPoller::polled(poll_state* state, bool done) {
+    using seconds = std::chrono::duration<double>;
+
+    const clock::time_point now = clock::now();
+    state->polls++;
+    total_polls++;
+
+    if(done) {
+        const double completion = seconds(now - state->start).count();
+        const double detection = seconds(now - state->last_poll).count();
+        completion_samples.push_back(completion);
+        detection_samples.push_back(detection);
+
+        // The kernel finished somewhere between the last two polls. Taking the end of that range would make every sleep that
+        // overshoots lower the throughput and lengthen the next sleep.
+        const double duration = completion - detection/2;
+        if(state->bytes > 0 && duration > 0) {
+            throughput = (1 - POLL_THROUGHPUT_WEIGHT)*throughput + POLL_THROUGHPUT_WEIGHT*state->bytes/duration;
+        }
+    }
+
+    state->last_poll = now;
+}
+
+status CompletionPoller::wait(int64_t bytes, const std::function<status(bool*)>& is_done) {
+    poll_state state = begin(bytes);
+
+    bool done = false;
+    while(!done) {
+        std::this_thread::sleep_until(next_poll(&state));
+        if(is_done(&done) != status::OK) {
+            return status::FAIL;
+        }
+        polled(&state, done);
+    }
+
+    return status::OK;
+}
+
+// Nearest-rank percentiles, like Timer::percentile in profiling/utils
+latency_distribution CompletionPoller::distribution(std::vector<double> samples) {
+    if(samples.empty()) {
+        return latency_distribution{0, 0, 0, 0};
+    }
+
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&](double p) {
+        size_t rank = (size_t) std::ceil((p/100)*samples.size());
+        if(rank > 0) {
+            rank--;
+        }
+        return samples[std::min(rank, samples.size()-1)];
+    };
+
+    return latency_distribution{percentile(50), percentile(90), percentile(99), samples.back()};
+}
+
+poll_stats CompletionPoller::get_stats() const {
+    poll_stats stats;
+    stats.num_completions = completion_samples.size();
+    stats.total_polls = total_polls;
+    stats.average_polls = completion_samples.empty() ? 0 : (double) total_polls/completion_samples.size();
+    stats.completion = distribution(completion_samples);
+    stats.detection = distribution(detection_samples);
+    return stats;
+}
+
+void CompletionPoller::clear_stats() {
+    completion_samples.clear();
+    detection_samples.clear();
+    total_polls = 0;
+}
+
+}
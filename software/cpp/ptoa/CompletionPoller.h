@@ -0,0 +1,108 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "ptoa.h"
+
+// Bytes of pages per second that the kernels are expected to convert before the first completion has been measured
+#define POLL_INITIAL_THROUGHPUT 1e9
+// Weight of the last completion in the throughput model
+#define POLL_THROUGHPUT_WEIGHT 0.25
+// Fraction of the expected duration that is slept through before the first poll
+#define POLL_SLEEP_FRACTION 0.8
+// Microseconds of polling without sleeping after the first poll. Kernels that are expected to finish within this time are
+// polled without sleeping from the start, as a sleep this short tends to take several times longer.
+#define POLL_SPIN_US 50
+// Sleep between polls after the spin phase, doubling after every poll up to a fraction of the expected duration, within
+// these bounds in microseconds
+#define POLL_BACKOFF_MIN_US 1
+#define POLL_BACKOFF_MAX_US 1000
+#define POLL_BACKOFF_MAX_FRACTION 0.05
+
+namespace ptoa{
+
+// Percentiles of a latency in seconds
+struct latency_distribution {
+    double p50;
+    double p90;
+    double p99;
+    double max;
+};
+
+// Completion is the time from the start of a kernel until it was seen to be done, detection is the time between the last
+// poll that found the kernel busy and the one that found it done, the most the completion could have been seen late.
+struct poll_stats {
+    int64_t num_completions;
+    int64_t total_polls;
+    double average_polls;
+    latency_distribution completion;
+    latency_distribution detection;
+};
+
+/**
+ * Decides when to poll the status of a running kernel. The expected duration of a run follows from its bytes and the
+ * throughput measured in earlier runs. The poller sleeps through most of it, polls without sleeping for a short while and then
+ * backs off exponentially. Short runs are seen done soon after they are, without spinning a core through long runs.
+ *
+ * Every run is tracked in a poll_state, so a single poller can schedule the polls of several kernels that run at the same
+ * time. A poller is not thread safe.
+ */
+class CompletionPoller {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    struct poll_state {
+        clock::time_point start;
+        clock::time_point last_poll;
+        double expected_seconds;
+        double backoff_seconds;
+        int64_t bytes;
+        int64_t polls;
+    };
+
+    CompletionPoller();
+
+    // Called right after the kernel was started
+    poll_state begin(int64_t bytes);
+    // Time of the next poll of a kernel that has not been seen done yet
+    clock::time_point next_poll(poll_state* state);
+    // Called after every poll. A done kernel adds to the stats and the throughput model.
+    void polled(poll_state* state, bool done);
+
+    // Polls with is_done until the kernel is done or is_done fails
+    status wait(int64_t bytes, const std::function<status(bool*)>& is_done);
+
+    // Polls every interval_us microseconds like before, 0 (default) polls adaptively
+    void set_fixed_interval(int interval_us) {fixed_interval_us = interval_us;}
+    double get_throughput() const {return throughput;}
+
+    poll_stats get_stats() const;
+    void clear_stats();
+
+  private:
+    static latency_distribution distribution(std::vector<double> samples);
+
+    int fixed_interval_us;
+    double throughput;
+
+    std::vector<double> completion_samples;
+    std::vector<double> detection_samples;
+    int64_t total_polls;
+};
+
+}
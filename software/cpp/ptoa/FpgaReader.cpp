@@ -0,0 +1,735 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "FpgaReader.h"
+#include "trace.h"
+#include "ptoa.h"
+
+namespace ptoa {
+
+// Memory from posix_memalign, freed with the buffer
+class AlignedBuffer : public arrow::Buffer {
+  public:
+    AlignedBuffer(uint8_t* data, int64_t size) : arrow::Buffer(data, size) {}
+    ~AlignedBuffer() {
+        std::free((void*) data());
+    }
+};
+
+// Thrift compact protocol types, see https://github.com/apache/thrift/blob/master/doc/specs/thrift-compact-protocol.md
+enum compact_type {
+    COMPACT_BOOLEAN_TRUE = 1,
+    COMPACT_BOOLEAN_FALSE = 2,
+    COMPACT_BYTE = 3,
+    COMPACT_I16 = 4,
+    COMPACT_I32 = 5,
+    COMPACT_I64 = 6,
+    COMPACT_DOUBLE = 7,
+    COMPACT_BINARY = 8,
+    COMPACT_LIST = 9,
+    COMPACT_SET = 10,
+    COMPACT_MAP = 11,
+    COMPACT_STRUCT = 12
+};
+
+// Just enough of the Thrift compact protocol to find the size and value count of a page in its header, all other fields are
+// skipped. Reads never go past end, failed is set instead.
+class compact_reader {
+  public:
+    compact_reader(const uint8_t* ptr, const uint8_t* end) : ptr(ptr), end(end), failed(false) {}
+
+    const uint8_t* position() const {return ptr;}
+    bool has_failed() const {return failed;}
+
+    uint64_t read_varint() {
+        uint64_t result = 0;
+        for(int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = read_byte();
+            result |= (uint64_t) (byte & 0x7f) << shift;
+            if(failed || !(byte & 0x80)) {
+                return result;
+            }
+        }
+        failed = true;
+        return 0;
+    }
+
+    int64_t read_zigzag() {
+        uint64_t value = read_varint();
+        return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+    }
+
+    // Returns false at the end of the struct
+    bool read_field(int16_t* field_id, int* type) {
+        uint8_t byte = read_byte();
+        if(failed || byte == 0) {
+            return false;
+        }
+        *type = byte & 0x0f;
+        *field_id = (byte >> 4) == 0 ? (int16_t) read_zigzag() : *field_id + (byte >> 4);
+        return !failed;
+    }
+
+    void skip(int type) {
+        switch(type) {
+            // The value of boolean fields is in their type
+            case COMPACT_BOOLEAN_TRUE:
+            case COMPACT_BOOLEAN_FALSE:
+                break;
+            case COMPACT_BYTE:
+                advance(1);
+                break;
+            case COMPACT_I16:
+            case COMPACT_I32:
+            case COMPACT_I64:
+                read_varint();
+                break;
+            case COMPACT_DOUBLE:
+                advance(8);
+                break;
+            case COMPACT_BINARY:
+                advance(read_varint());
+                break;
+            case COMPACT_LIST:
+            case COMPACT_SET: {
+                uint8_t header = read_byte();
+                uint64_t size = header >> 4 == 15 ? read_varint() : header >> 4;
+                for(uint64_t i=0; i<size && !failed; i++) {
+                    skip_element(header & 0x0f);
+                }
+                break;
+            }
+            case COMPACT_MAP: {
+                uint64_t size = read_varint();
+                uint8_t types = size > 0 ? read_byte() : 0;
+                for(uint64_t i=0; i<size && !failed; i++) {
+                    skip_element(types >> 4);
+                    skip_element(types & 0x0f);
+                }
+                break;
+            }
+            case COMPACT_STRUCT: {
+                int16_t field_id = 0;
+                int field_type;
+                while(read_field(&field_id, &field_type)) {
+                    skip(field_type);
+                }
+                break;
+            }
+            default:
+                failed = true;
+        }
+    }
+
+  private:
+    uint8_t read_byte() {
+        if(ptr >= end) {
+            failed = true;
+            return 0;
+        }
+        return *(ptr++);
+    }
+
+    void advance(uint64_t bytes) {
+        if(bytes > (uint64_t) (end - ptr)) {
+            failed = true;
+            return;
+        }
+        ptr += bytes;
+    }
+
+    // Booleans in lists, sets and maps take a byte
+    void skip_element(int type) {
+        if(type == COMPACT_BOOLEAN_TRUE || type == COMPACT_BOOLEAN_FALSE) {
+            advance(1);
+        } else {
+            skip(type);
+        }
+    }
+
+    const uint8_t* ptr;
+    const uint8_t* end;
+    bool failed;
+};
+
+// Size of the page including its header, and the number of values in the data_page_header or data_page_header_v2
+static status read_page_header(const uint8_t* page_ptr, const uint8_t* end, int64_t* page_size, int64_t* page_num_values) {
+    compact_reader reader(page_ptr, end);
+    int64_t compressed_size = -1;
+    int64_t num_values = -1;
+    int16_t field_id = 0;
+    int type;
+
+    while(reader.read_field(&field_id, &type)) {
+        if(field_id == 3 && type == COMPACT_I32) {
+            compressed_size = reader.read_zigzag();
+        } else if((field_id == 5 || field_id == 8) && type == COMPACT_STRUCT) {
+            int16_t header_field_id = 0;
+            int header_type;
+            while(reader.read_field(&header_field_id, &header_type)) {
+                if(header_field_id == 1 && header_type == COMPACT_I32) {
+                    num_values = reader.read_zigzag();
+                } else {
+                    reader.skip(header_type);
+                }
+            }
+        } else {
+            reader.skip(type);
+        }
+    }
+
+    if(reader.has_failed() || compressed_size < 0 || num_values < 0) {
+        return status::FAIL;
+    }
+
+    *page_size = (reader.position() - page_ptr) + compressed_size;
+    *page_num_values = num_values;
+    return status::OK;
+}
+
+FpgaReader::FpgaReader() {
+    host_memory = false;
+    context_type = column_type::NONE;
+    value_capacity = 0;
+    char_capacity = 0;
+    device_data = 0;
+    device_data_capacity = 0;
+    segment_size = 0;
+    last_read_stats = fpga_read_stats{0, 0, 0, 0, 0};
+}
+
+FpgaReader::~FpgaReader() {
+    if(device_data_capacity > 0) {
+        platform->DeviceFree(device_data);
+    }
+    for(segment_buffers& buffers : pipeline_buffers) {
+        if(buffers.pages_capacity > 0) {
+            platform->DeviceFree(buffers.pages);
+        }
+        if(buffers.values_capacity > 0) {
+            platform->DeviceFree(buffers.values);
+        }
+    }
+}
+
+std::string FpgaReader::platform_from_env() {
+    const char* name = std::getenv("PTOA_PLATFORM");
+    return name == nullptr ? "" : name;
+}
+
+status FpgaReader::init(const std::string& name) {
+    const std::string platform_name = name.empty() ? platform_from_env() : name;
+    fletcher::Status fletcher_status;
+    if(platform_name.empty()) {
+        fletcher_status = fletcher::Platform::Make(&platform, false);
+    } else {
+        fletcher_status = fletcher::Platform::Make(platform_name, &platform, false);
+    }
+    if(!fletcher_status.ok()) {
+        std::cerr << "[ERROR] Could not create Fletcher platform " << platform_name << std::endl;
+        return status::FAIL;
+    }
+
+    if(!platform->Init().ok()) {
+        std::cerr << "[ERROR] Could not initialize Fletcher platform " << platform->name() << std::endl;
+        return status::FAIL;
+    }
+
+    host_memory = platform->name() == "oc-accel" || platform->name() == "snap";
+    if(host_memory) {
+        std::cout << "Platform [" << platform->name() << "]: Skipping device buffer allocation and host to device copy." << std::endl;
+    }
+
+    return status::OK;
+}
+
+status FpgaReader::load_file(const std::string& file_path, int64_t file_offset, std::shared_ptr<arrow::Buffer>* data) {
+    return load_range(file_path, file_offset, -1, data);
+}
+
+status FpgaReader::load_column(const std::string& index_path, const std::string& column_name, column_index_entry* entry,
+                               std::shared_ptr<arrow::Buffer>* data) {
+    if(find_column_index_entry(index_path, column_name, entry) != status::OK) {
+        return status::FAIL;
+    }
+    return load_range(entry->file_name, entry->file_offset, entry->pages_size, data);
+}
+
+// Loads size bytes from file_offset on, or everything from file_offset on if size is negative
+status FpgaReader::load_range(const std::string& file_path, int64_t file_offset, int64_t size, std::shared_ptr<arrow::Buffer>* data) {
+    std::ifstream parquet_file(file_path, std::ifstream::binary);
+    if(!parquet_file.is_open()) {
+        std::cerr << "[ERROR] Could not open " << file_path << std::endl;
+        return status::FAIL;
+    }
+
+    parquet_file.seekg(0, parquet_file.end);
+    int64_t file_size = (int64_t) parquet_file.tellg();
+    parquet_file.seekg(file_offset, parquet_file.beg);
+    if(size < 0) {
+        size = file_size - file_offset;
+    }
+    if(size <= 0 || file_offset + size > file_size) {
+        std::cerr << "[ERROR] " << file_path << " ends before offset " << file_offset + std::max(size, (int64_t) 0) << std::endl;
+        return status::FAIL;
+    }
+
+    uint8_t* buffer;
+    if(posix_memalign((void**) &buffer, FPGA_HOST_ALIGNMENT, size) != 0) {
+        std::cerr << "[ERROR] Could not allocate " << size << " bytes for " << file_path << std::endl;
+        return status::FAIL;
+    }
+    *data = std::make_shared<AlignedBuffer>(buffer, size);
+
+    parquet_file.read((char*) buffer, size);
+    if(!parquet_file) {
+        std::cerr << "[ERROR] Could not read " << file_path << std::endl;
+        return status::FAIL;
+    }
+
+    return status::OK;
+}
+
+// The output buffers on the device are those of a record batch with room for capacity values, which Fletcher allocates when the
+// context is enabled. Their addresses are written to the MMIO registers once, reads only write their own arguments.
+status FpgaReader::prepare_context(column_type type, int64_t num_values, int64_t num_chars) {
+    if(context && type == context_type && num_values <= value_capacity && num_chars <= char_capacity) {
+        return status::OK;
+    }
+
+    if(type == context_type) {
+        value_capacity = std::max(num_values, 2*value_capacity);
+        char_capacity = std::max(num_chars, 2*char_capacity);
+    } else {
+        value_capacity = num_values;
+        char_capacity = num_chars;
+    }
+    kernel.reset();
+    context.reset();
+    context_type = column_type::NONE;
+
+    std::shared_ptr<arrow::Array> array;
+    std::shared_ptr<arrow::Field> field;
+    if(type == column_type::STRING) {
+        arrow::Result<std::unique_ptr<arrow::Buffer>> offsets = arrow::AllocateBuffer(sizeof(int32_t)*(value_capacity + 1));
+        arrow::Result<std::unique_ptr<arrow::Buffer>> values = arrow::AllocateBuffer(char_capacity);
+        if(!offsets.ok() || !values.ok()) {
+            std::cerr << "[ERROR] Could not allocate the output buffers for " << value_capacity << " strings" << std::endl;
+            return status::FAIL;
+        }
+        std::shared_ptr<arrow::Buffer> offsets_buffer = std::move(offsets).ValueOrDie();
+        std::shared_ptr<arrow::Buffer> values_buffer = std::move(values).ValueOrDie();
+        // Make sure the buffers are allocated
+        memset(offsets_buffer->mutable_data(), 0, offsets_buffer->size());
+        memset(values_buffer->mutable_data(), 0, values_buffer->size());
+        array = std::make_shared<arrow::StringArray>(value_capacity, offsets_buffer, values_buffer);
+        field = arrow::field("str", arrow::utf8(), false);
+    } else {
+        int32_t value_size = type == column_type::INT32 ? sizeof(int32_t) : sizeof(int64_t);
+        arrow::Result<std::unique_ptr<arrow::Buffer>> values = arrow::AllocateBuffer(value_size*value_capacity);
+        if(!values.ok()) {
+            std::cerr << "[ERROR] Could not allocate the output buffer for " << value_capacity << " values" << std::endl;
+            return status::FAIL;
+        }
+        std::shared_ptr<arrow::Buffer> values_buffer = std::move(values).ValueOrDie();
+        memset(values_buffer->mutable_data(), 0, values_buffer->size());
+        if(type == column_type::INT32) {
+            array = std::make_shared<arrow::Int32Array>(arrow::int32(), value_capacity, values_buffer);
+            field = arrow::field("int", arrow::int32(), false);
+        } else {
+            array = std::make_shared<arrow::Int64Array>(arrow::int64(), value_capacity, values_buffer);
+            field = arrow::field("int", arrow::int64(), false);
+        }
+    }
+
+    std::shared_ptr<arrow::RecordBatch> record_batch = arrow::RecordBatch::Make(arrow::schema({field}), value_capacity, {array});
+
+    if(!fletcher::Context::Make(&context, platform).ok() || !context->QueueRecordBatch(record_batch).ok() || !context->Enable().ok()) {
+        std::cerr << "[ERROR] Could not create the Fletcher context" << std::endl;
+        context.reset();
+        return status::FAIL;
+    }
+    kernel = std::make_shared<fletcher::Kernel>(context);
+    context_type = type;
+
+    return status::OK;
+}
+
+status FpgaReader::device_realloc(da_t* address, int64_t* capacity, int64_t size) {
+    if(size <= *capacity) {
+        return status::OK;
+    }
+
+    if(*capacity > 0) {
+        platform->DeviceFree(*address);
+        *capacity = 0;
+    }
+    if(!platform->DeviceMalloc(address, size).ok()) {
+        std::cerr << "[ERROR] Could not allocate " << size << " bytes on the device" << std::endl;
+        return status::FAIL;
+    }
+    *capacity = size;
+
+    return status::OK;
+}
+
+status FpgaReader::prepare_data(const uint8_t* data, int64_t data_size, da_t* device_address) {
+    if(host_memory) {
+        *device_address = (da_t) data;
+        last_read_stats.copy_to_device = 0;
+        return status::OK;
+    }
+
+    if(device_realloc(&device_data, &device_data_capacity, data_size) != status::OK) {
+        return status::FAIL;
+    }
+
+    fletcher::Timer t;
+    t.start();
+    {
+        TraceSpan span("CopyHostToDevice", "transfer");
+        if(!platform->CopyHostToDevice(data, device_data, data_size).ok()) {
+            std::cerr << "[ERROR] Could not copy " << data_size << " bytes to the device" << std::endl;
+            return status::FAIL;
+        }
+    }
+    t.stop();
+    last_read_stats.copy_to_device = t.seconds();
+
+    *device_address = device_data;
+    return status::OK;
+}
+
+void FpgaReader::write_address(uint64_t reg, da_t address) {
+    dau_t mmio64_writer;
+    mmio64_writer.full = address;
+    platform->WriteMMIO(reg + 0, mmio64_writer.lo);
+    platform->WriteMMIO(reg + 1, mmio64_writer.hi);
+}
+
+// buffer_address is written over the address of the first output buffer that Fletcher wrote, which pipelined reads change
+status FpgaReader::run(int64_t num_values, da_t device_address, int64_t data_size, da_t buffer_address) {
+    if(num_values > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "[ERROR] The kernels read at most " << std::numeric_limits<uint32_t>::max() << " values at once" << std::endl;
+        return status::FAIL;
+    }
+
+    fletcher::Timer t;
+    t.start();
+
+    kernel->Reset();
+
+    platform->WriteMMIO(FPGA_REG_NUM_VAL, (uint32_t) num_values);
+    write_address(FPGA_REG_PAGE_ADDR, device_address);
+    write_address(FPGA_REG_MAX_SIZE, data_size);
+    write_address(FPGA_REG_BUFFER_ADDR, buffer_address);
+
+    {
+        TraceSpan span("kernel.Start", "fpga");
+        if(!kernel->Start().ok()) {
+            std::cerr << "[ERROR] Could not start the kernel" << std::endl;
+            return status::FAIL;
+        }
+    }
+    {
+        // The kernel is expected to take time in proportion to the pages it reads
+        TraceSpan span("poll", "fpga");
+        auto is_done = [&](bool* done) {
+            uint32_t kernel_status;
+            if(!kernel->GetStatus(&kernel_status).ok()) {
+                std::cerr << "[ERROR] Could not poll the kernel status" << std::endl;
+                return status::FAIL;
+            }
+            *done = (kernel_status & FPGA_STATUS_DONE) != 0;
+            return status::OK;
+        };
+        if(poller.wait(data_size, is_done) != status::OK) {
+            return status::FAIL;
+        }
+    }
+
+    t.stop();
+    last_read_stats.processing = t.seconds();
+    return status::OK;
+}
+
+// Results are copied to buffers of their own, so arrays from earlier reads stay valid when the device buffers are reused
+status FpgaReader::copy_to_host(size_t buffer_index, int64_t size, std::shared_ptr<arrow::Buffer>* buffer) {
+    arrow::Result<std::unique_ptr<arrow::Buffer>> result = arrow::AllocateBuffer(size);
+    if(!result.ok()) {
+        std::cerr << "[ERROR] Could not allocate " << size << " bytes for the result" << std::endl;
+        return status::FAIL;
+    }
+    *buffer = std::move(result).ValueOrDie();
+
+    TraceSpan span("CopyDeviceToHost", "transfer");
+    if(!platform->CopyDeviceToHost(context->device_buffer(buffer_index).device_address, (*buffer)->mutable_data(), size).ok()) {
+        std::cerr << "[ERROR] Could not copy " << size << " bytes from the device" << std::endl;
+        return status::FAIL;
+    }
+    return status::OK;
+}
+
+status FpgaReader::read_prim(int32_t prim_width, int64_t num_values, const uint8_t* data, int64_t data_size, std::shared_ptr<arrow::PrimitiveArray>* prim_array) {
+    arrow::Result<std::unique_ptr<arrow::Buffer>> result = arrow::AllocateBuffer(num_values*prim_width/8);
+    if(!result.ok()) {
+        std::cerr << "[ERROR] Could not allocate " << num_values*prim_width/8 << " bytes for the result" << std::endl;
+        return status::FAIL;
+    }
+    std::shared_ptr<arrow::Buffer> values = std::move(result).ValueOrDie();
+
+    if(read_prim(prim_width, num_values, data, data_size, values->mutable_data()) != status::OK) {
+        return status::FAIL;
+    }
+
+    if(prim_width == 32) {
+        *prim_array = std::make_shared<arrow::Int32Array>(arrow::int32(), num_values, values);
+    } else {
+        *prim_array = std::make_shared<arrow::Int64Array>(arrow::int64(), num_values, values);
+    }
+
+    return status::OK;
+}
+
+status FpgaReader::read_prim(int32_t prim_width, int64_t num_values, const uint8_t* data, int64_t data_size, uint8_t* values) {
+    if(prim_width != 32 && prim_width != 64) {
+        std::cerr << "[ERROR] The kernels read 32 or 64 bit integers, not " << prim_width << " bit" << std::endl;
+        return status::FAIL;
+    }
+    if(!platform) {
+        std::cerr << "[ERROR] FpgaReader::init should be called before reading" << std::endl;
+        return status::FAIL;
+    }
+
+    std::lock_guard<std::mutex> lock(read_mutex);
+
+    if(segment_size > 0 && !host_memory) {
+        return read_prim_pipelined(prim_width, num_values, data, data_size, values);
+    }
+
+    fletcher::Timer total;
+    total.start();
+
+    column_type type = prim_width == 32 ? column_type::INT32 : column_type::INT64;
+    da_t device_address;
+    if(prepare_context(type, num_values, 0) != status::OK || prepare_data(data, data_size, &device_address) != status::OK ||
+       run(num_values, device_address, data_size, context->device_buffer(0).device_address) != status::OK) {
+        return status::FAIL;
+    }
+
+    fletcher::Timer t;
+    t.start();
+    {
+        TraceSpan span("CopyDeviceToHost", "transfer");
+        if(!platform->CopyDeviceToHost(context->device_buffer(0).device_address, values, num_values*prim_width/8).ok()) {
+            std::cerr << "[ERROR] Could not copy " << num_values*prim_width/8 << " bytes from the device" << std::endl;
+            return status::FAIL;
+        }
+    }
+    t.stop();
+    last_read_stats.copy_to_host = t.seconds();
+
+    total.stop();
+    last_read_stats.total = total.seconds();
+    last_read_stats.num_segments = 1;
+
+    return status::OK;
+}
+
+status FpgaReader::read_string(int64_t num_strings, int64_t num_chars, const uint8_t* data, int64_t data_size, std::shared_ptr<arrow::StringArray>* string_array) {
+    if(!platform) {
+        std::cerr << "[ERROR] FpgaReader::init should be called before reading" << std::endl;
+        return status::FAIL;
+    }
+    if(num_chars > std::numeric_limits<int32_t>::max()) {
+        std::cerr << "[ERROR] " << num_chars << " characters don't fit in 32 bit offsets" << std::endl;
+        return status::FAIL;
+    }
+
+    std::lock_guard<std::mutex> lock(read_mutex);
+
+    fletcher::Timer total;
+    total.start();
+
+    da_t device_address;
+    if(prepare_context(column_type::STRING, num_strings, num_chars) != status::OK || prepare_data(data, data_size, &device_address) != status::OK ||
+       run(num_strings, device_address, data_size, context->device_buffer(0).device_address) != status::OK) {
+        return status::FAIL;
+    }
+
+    fletcher::Timer t;
+    t.start();
+    std::shared_ptr<arrow::Buffer> offsets;
+    std::shared_ptr<arrow::Buffer> values;
+    if(copy_to_host(0, sizeof(int32_t)*(num_strings + 1), &offsets) != status::OK || copy_to_host(1, num_chars, &values) != status::OK) {
+        return status::FAIL;
+    }
+    t.stop();
+    last_read_stats.copy_to_host = t.seconds();
+
+    total.stop();
+    last_read_stats.total = total.seconds();
+    last_read_stats.num_segments = 1;
+
+    *string_array = std::make_shared<arrow::StringArray>(num_strings, offsets, values);
+
+    return status::OK;
+}
+
+status FpgaReader::split_segments(const uint8_t* data, int64_t data_size, int64_t num_values, std::vector<segment>* segments) {
+    segments->clear();
+    segment current = {0, 0, 0, 0};
+    int64_t offset = 0;
+    int64_t values = 0;
+
+    while(values < num_values) {
+        int64_t page_size;
+        int64_t page_num_values;
+        if(read_page_header(data + offset, data + data_size, &page_size, &page_num_values) != status::OK || offset + page_size > data_size) {
+            std::cerr << "[ERROR] Could not read the page at offset " << offset << ", after " << values << " of " << num_values << " values" << std::endl;
+            return status::FAIL;
+        }
+
+        page_num_values = std::min(page_num_values, num_values - values);
+        offset += page_size;
+        values += page_num_values;
+        current.size += page_size;
+        current.num_values += page_num_values;
+
+        if(current.size >= segment_size || values == num_values) {
+            segments->push_back(current);
+            current = {offset, 0, values, 0};
+        }
+    }
+
+    return status::OK;
+}
+
+status FpgaReader::prepare_segment_buffers(int64_t pages_size, int64_t values_size) {
+    pipeline_buffers.resize(FPGA_SEGMENT_BUFFER_SETS, segment_buffers{0, 0, 0, 0});
+    for(segment_buffers& buffers : pipeline_buffers) {
+        if(device_realloc(&buffers.pages, &buffers.pages_capacity, pages_size) != status::OK ||
+           device_realloc(&buffers.values, &buffers.values_capacity, values_size) != status::OK) {
+            return status::FAIL;
+        }
+    }
+    return status::OK;
+}
+
+// Every step copies segment s to the device, decodes segment s - 1 and copies the values of segment s - 2 back, each from their
+// own buffer set. The copies run on threads of their own, the kernel is run from the calling thread. All three are done before
+// the next step starts, so a buffer set is never used by two steps at once.
+status FpgaReader::read_prim_pipelined(int32_t prim_width, int64_t num_values, const uint8_t* data, int64_t data_size, uint8_t* values) {
+    fletcher::Timer total;
+    total.start();
+
+    std::vector<segment> segments;
+    if(split_segments(data, data_size, num_values, &segments) != status::OK) {
+        return status::FAIL;
+    }
+
+    std::vector<int64_t> copy_sizes(segments.size());
+    int64_t max_copy_size = 0;
+    int64_t max_segment_values = 0;
+    for(size_t s=0; s<segments.size(); s++) {
+        copy_sizes[s] = std::min(segments[s].size + FPGA_SEGMENT_MARGIN, data_size - segments[s].offset);
+        max_copy_size = std::max(max_copy_size, copy_sizes[s]);
+        max_segment_values = std::max(max_segment_values, segments[s].num_values);
+    }
+
+    column_type type = prim_width == 32 ? column_type::INT32 : column_type::INT64;
+    if(prepare_context(type, max_segment_values, 0) != status::OK ||
+       prepare_segment_buffers(max_copy_size, max_segment_values*prim_width/8) != status::OK) {
+        return status::FAIL;
+    }
+
+    last_read_stats = fpga_read_stats{0, 0, 0, 0, (int64_t) segments.size()};
+    const int64_t num_segments = segments.size();
+
+    for(int64_t step=0; step<num_segments + 2; step++) {
+        status in_status = status::OK;
+        status out_status = status::OK;
+        double in_seconds = 0;
+        double out_seconds = 0;
+        std::thread copy_in;
+        std::thread copy_out;
+
+        if(step < num_segments) {
+            const segment& in = segments[step];
+            const segment_buffers& buffers = pipeline_buffers[step % FPGA_SEGMENT_BUFFER_SETS];
+            const int64_t copy_size = copy_sizes[step];
+            copy_in = std::thread([&, in, buffers, copy_size]() {
+                fletcher::Timer t;
+                t.start();
+                TraceSpan span("CopyHostToDevice", "transfer");
+                if(!platform->CopyHostToDevice(data + in.offset, buffers.pages, copy_size).ok()) {
+                    std::cerr << "[ERROR] Could not copy " << copy_size << " bytes to the device" << std::endl;
+                    in_status = status::FAIL;
+                }
+                t.stop();
+                in_seconds = t.seconds();
+            });
+        }
+
+        if(step >= 2) {
+            const segment& out = segments[step - 2];
+            const segment_buffers& buffers = pipeline_buffers[(step - 2) % FPGA_SEGMENT_BUFFER_SETS];
+            copy_out = std::thread([&, out, buffers]() {
+                fletcher::Timer t;
+                t.start();
+                TraceSpan span("CopyDeviceToHost", "transfer");
+                if(!platform->CopyDeviceToHost(buffers.values, values + out.first_value*prim_width/8, out.num_values*prim_width/8).ok()) {
+                    std::cerr << "[ERROR] Could not copy " << out.num_values*prim_width/8 << " bytes from the device" << std::endl;
+                    out_status = status::FAIL;
+                }
+                t.stop();
+                out_seconds = t.seconds();
+            });
+        }
+
+        status kernel_status = status::OK;
+        if(step >= 1 && step <= num_segments) {
+            const segment& current = segments[step - 1];
+            const segment_buffers& buffers = pipeline_buffers[(step - 1) % FPGA_SEGMENT_BUFFER_SETS];
+            // run overwrites the processing time with that of this segment
+            double processing = last_read_stats.processing;
+            kernel_status = run(current.num_values, buffers.pages, copy_sizes[step - 1], buffers.values);
+            last_read_stats.processing += processing;
+        }
+
+        if(copy_in.joinable()) {
+            copy_in.join();
+        }
+        if(copy_out.joinable()) {
+            copy_out.join();
+        }
+        if(in_status != status::OK || out_status != status::OK || kernel_status != status::OK) {
+            return status::FAIL;
+        }
+        last_read_stats.copy_to_device += in_seconds;
+        last_read_stats.copy_to_host += out_seconds;
+    }
+
+    total.stop();
+    last_read_stats.total = total.seconds();
+    return status::OK;
+}
+
+}
@@ -0,0 +1,169 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <arrow/api.h>
+
+#include "fletcher/api.h"
+
+#include "ColumnIndex.h"
+#include "CompletionPoller.h"
+#include "ptoa.h"
+
+// First MMIO register with the arguments of the ParquetReader kernels, after the registers Fletcher uses for control, status,
+// return values and buffer addresses. Coordinate with REG_NUM_VAL in the hardware wrappers.
+#define FPGA_REG_BASE 10
+#define FPGA_REG_NUM_VAL (FPGA_REG_BASE + 0)
+#define FPGA_REG_PAGE_ADDR (FPGA_REG_BASE + 1)
+#define FPGA_REG_MAX_SIZE (FPGA_REG_BASE + 3)
+// Address of the first output buffer, the values of integer columns. Fletcher writes it when the context is enabled.
+#define FPGA_REG_BUFFER_ADDR 6
+
+// Control and status bits of the kernels, those of the Fletcher UserCoreController
+#define FPGA_CONTROL_START 0x1
+#define FPGA_CONTROL_RESET 0x4
+#define FPGA_STATUS_DONE 0x4
+
+// The oc-accel platforms read the pages straight from host memory, which has to be page aligned
+#define FPGA_HOST_ALIGNMENT 4096
+
+// Device buffer sets of pipelined reads. While a segment is decoded from one set, the next segment is copied to the other set
+// and the values of the previous segment are copied back from it.
+#define FPGA_SEGMENT_BUFFER_SETS 2
+// Bytes after the pages of a segment that are copied with it and included in the maximum size the kernel may read, so segments
+// don't fit tightly in their data size, like whole files with their footer
+#define FPGA_SEGMENT_MARGIN 4096
+
+namespace ptoa{
+
+// Seconds spent in every step of a read. Pipelined reads overlap the steps, their times add up the time spent on every segment.
+struct fpga_read_stats {
+    double copy_to_device;
+    double processing;
+    double copy_to_host;
+    double total;
+    int64_t num_segments;
+};
+
+/**
+ * Host runtime of the ParquetReader kernels in examples/ and platforms/: converts the pages of a hardware compatible Parquet
+ * file to an Arrow array on the FPGA.
+ *
+ * The Fletcher platform is created and initialized once by init(). The context with the output buffers on the device and the
+ * device buffer for the pages are kept between reads, and are only reallocated when a read needs more room or a different
+ * column type, so a single FpgaReader serves any number of reads. Reads from multiple threads are serialized, as a kernel
+ * converts one column at a time.
+ *
+ * With a segment size set, integer columns are read in segments of whole pages of about that size. The copy of the next
+ * segment to the device and the copy of the previous values back to the host overlap with the decoding of the current
+ * segment, using two sets of device buffers.
+ */
+class FpgaReader {
+  public:
+    FpgaReader();
+    ~FpgaReader();
+    FpgaReader(const FpgaReader&) = delete;
+    FpgaReader& operator=(const FpgaReader&) = delete;
+
+    // Creates the Fletcher platform with the given name. Without a name the one in PTOA_PLATFORM is used, like ptoa_emu for the
+    // emulation platform in software/cpp/emu, or the autodetected one if that is not set either.
+    status init(const std::string& platform_name = "");
+
+    // data points to the first page, data_size bytes from there on are given to the hardware as the maximum it may read. The
+    // DataAligner has had trouble with sizes that fit the pages exactly, so data_size should include the footer after them.
+    status read_prim(int32_t prim_width, int64_t num_values, const uint8_t* data, int64_t data_size, std::shared_ptr<arrow::PrimitiveArray>* prim_array);
+    // Writes the values to host memory with room for num_values values instead of a new array
+    status read_prim(int32_t prim_width, int64_t num_values, const uint8_t* data, int64_t data_size, uint8_t* values);
+    status read_string(int64_t num_strings, int64_t num_chars, const uint8_t* data, int64_t data_size, std::shared_ptr<arrow::StringArray>* string_array);
+
+    // Pipelines read_prim in segments of segment_size bytes of pages, 0 disables pipelining. Has no effect on platforms that read
+    // host memory, as there is nothing to copy.
+    void set_segment_size(int64_t segment_size) {this->segment_size = segment_size;}
+
+    // Polls the kernel status every interval_us microseconds, 0 (default) polls adaptively, see CompletionPoller
+    void set_poll_interval(int interval_us) {poller.set_fixed_interval(interval_us);}
+    // Completion latencies of all kernel runs since the last clear, segments of pipelined reads are runs of their own
+    poll_stats get_poll_stats() const {return poller.get_stats();}
+    void clear_poll_stats() {poller.clear_stats();}
+
+    const fpga_read_stats& get_last_read_stats() const {return last_read_stats;}
+    std::shared_ptr<fletcher::Platform> get_platform() const {return platform;}
+
+    // Platform name in the PTOA_PLATFORM environment variable, empty if it is not set
+    static std::string platform_from_env();
+
+    // Loads the file from file_offset on in memory aligned to FPGA_HOST_ALIGNMENT
+    static status load_file(const std::string& file_path, int64_t file_offset, std::shared_ptr<arrow::Buffer>* data);
+    // Loads only the pages of column_name, as listed in the column index written by the transcoder, see ColumnIndex.h
+    static status load_column(const std::string& index_path, const std::string& column_name, column_index_entry* entry,
+                              std::shared_ptr<arrow::Buffer>* data);
+
+  private:
+    enum class column_type {NONE, INT32, INT64, STRING};
+
+    // Whole pages that are copied, decoded and copied back at once by pipelined reads
+    struct segment {
+        int64_t offset;
+        int64_t size;
+        int64_t first_value;
+        int64_t num_values;
+    };
+
+    // Device buffers of one of the segments in flight
+    struct segment_buffers {
+        da_t pages;
+        int64_t pages_capacity;
+        da_t values;
+        int64_t values_capacity;
+    };
+
+    static status load_range(const std::string& file_path, int64_t file_offset, int64_t size, std::shared_ptr<arrow::Buffer>* data);
+    status prepare_context(column_type type, int64_t num_values, int64_t num_chars);
+    status prepare_data(const uint8_t* data, int64_t data_size, da_t* device_address);
+    status run(int64_t num_values, da_t device_address, int64_t data_size, da_t buffer_address);
+    status copy_to_host(size_t buffer_index, int64_t size, std::shared_ptr<arrow::Buffer>* buffer);
+    void write_address(uint64_t reg, da_t address);
+
+    status read_prim_pipelined(int32_t prim_width, int64_t num_values, const uint8_t* data, int64_t data_size, uint8_t* values);
+    status split_segments(const uint8_t* data, int64_t data_size, int64_t num_values, std::vector<segment>* segments);
+    status prepare_segment_buffers(int64_t pages_size, int64_t values_size);
+    status device_realloc(da_t* address, int64_t* capacity, int64_t size);
+
+    std::shared_ptr<fletcher::Platform> platform;
+    // oc-accel and snap read host memory, there is nothing to allocate or copy on the device
+    bool host_memory;
+
+    std::shared_ptr<fletcher::Context> context;
+    std::shared_ptr<fletcher::Kernel> kernel;
+    column_type context_type;
+    int64_t value_capacity;
+    int64_t char_capacity;
+
+    da_t device_data;
+    int64_t device_data_capacity;
+
+    int64_t segment_size;
+    std::vector<segment_buffers> pipeline_buffers;
+
+    CompletionPoller poller;
+    fpga_read_stats last_read_stats;
+    std::mutex read_mutex;
+};
+
+}
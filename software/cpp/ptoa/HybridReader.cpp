@@ -0,0 +1,188 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "HybridReader.h"
+#include "trace.h"
+#include "ptoa.h"
+
+namespace ptoa {
+
+HybridReader::HybridReader(FpgaReader* fpga_reader, int num_threads) {
+    this->fpga_reader = fpga_reader;
+    this->num_threads = std::max(num_threads, 1);
+    fpga_fraction = -1;
+    fpga_throughput = 0;
+    cpu_throughput = 0;
+    last_read_stats = hybrid_read_stats{0, 0, 0, 0, 0, 0, 0};
+}
+
+// first_values holds the index of the first value of every page, followed by num_values
+status HybridReader::build_page_directory(const uint8_t* data, int64_t data_size, int64_t num_values, std::vector<int64_t>* page_offsets, std::vector<int64_t>* first_values) {
+    SWParquetReader page_reader;
+    int64_t offset = 0;
+
+    page_offsets->clear();
+    first_values->assign(1, 0);
+
+    while(first_values->back() < num_values) {
+        int32_t page_size;
+        int32_t page_num_values;
+        if(offset >= data_size || page_reader.read_page_size(data + offset, &page_size, &page_num_values) != status::OK || offset + page_size > data_size) {
+            std::cerr << "[ERROR] Could not read the page at offset " << offset << ", after " << first_values->back() << " of " << num_values << " values" << std::endl;
+            return status::FAIL;
+        }
+
+        page_offsets->push_back(offset);
+        first_values->push_back(first_values->back() + std::min((int64_t) page_num_values, num_values - first_values->back()));
+        offset += page_size;
+    }
+
+    return status::OK;
+}
+
+// Number of pages, from the first one on, that are read by the FPGA
+size_t HybridReader::split_pages(const std::vector<int64_t>& first_values) {
+    double fraction = fpga_fraction;
+    if(fraction < 0) {
+        if(fpga_throughput > 0 && cpu_throughput > 0) {
+            fraction = fpga_throughput/(fpga_throughput + cpu_throughput);
+        } else {
+            fraction = HYBRID_INITIAL_FPGA_FRACTION;
+        }
+    }
+    fraction = std::min(fraction, 1.0);
+
+    const int64_t target = (int64_t) (fraction*first_values.back());
+    size_t split = std::lower_bound(first_values.begin(), first_values.end(), target) - first_values.begin();
+    if(split > 0 && target - first_values[split - 1] < first_values[split] - target) {
+        split--;
+    }
+
+    // A side without pages isn't measured, so a split on the measured throughput leaves a page to either side. Otherwise a side
+    // that was slow once would never get work again.
+    const size_t num_pages = first_values.size() - 1;
+    if(fpga_fraction < 0 && num_pages >= 2) {
+        split = std::max(std::min(split, num_pages - 1), (size_t) 1);
+    }
+
+    return split;
+}
+
+// Decodes the pages from first_page on into their place in values, with pages handed out to the threads one at a time
+status HybridReader::decode_pages(int32_t prim_width, const uint8_t* data, const std::vector<int64_t>& page_offsets, const std::vector<int64_t>& first_values, size_t first_page, encoding enc, uint8_t* values) {
+    std::atomic<size_t> next_page(first_page);
+    std::atomic<bool> failed(false);
+
+    auto worker = [&]() {
+        TraceSpan span("decode_pages", "decode");
+        SWParquetReader page_decoder;
+        size_t p;
+        while((p = next_page++) < page_offsets.size() && !failed) {
+            if(page_decoder.decode_page(prim_width, data + page_offsets[p], first_values[p + 1] - first_values[p],
+                                        values + first_values[p]*prim_width/8, enc) != status::OK) {
+                failed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(int i=1; i<num_threads; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+
+    return failed ? status::FAIL : status::OK;
+}
+
+status HybridReader::read_prim(int32_t prim_width, int64_t num_values, const uint8_t* data, int64_t data_size, encoding enc, std::shared_ptr<arrow::PrimitiveArray>* prim_array) {
+    if(prim_width != 32 && prim_width != 64) {
+        std::cerr << "[ERROR] Only 32 or 64 bit integer columns can be split, not " << prim_width << " bit" << std::endl;
+        return status::FAIL;
+    }
+
+    fletcher::Timer total;
+    total.start();
+
+    std::vector<int64_t> page_offsets;
+    std::vector<int64_t> first_values;
+    if(build_page_directory(data, data_size, num_values, &page_offsets, &first_values) != status::OK) {
+        return status::FAIL;
+    }
+    const size_t num_pages = page_offsets.size();
+    const size_t fpga_pages = split_pages(first_values);
+
+    std::shared_ptr<arrow::Buffer> values;
+    if(allocate_buffer(num_values*prim_width/8, &values) != status::OK) {
+        return status::FAIL;
+    }
+
+    last_read_stats = hybrid_read_stats{(int64_t) fpga_pages, first_values[fpga_pages], 0,
+                                        (int64_t) (num_pages - fpga_pages), num_values - first_values[fpga_pages], 0, 0};
+
+    // The kernel gets the same room after its last page as the segments of pipelined reads
+    status fpga_status = status::OK;
+    std::thread fpga_thread;
+    if(fpga_pages > 0) {
+        const int64_t fpga_data_size = fpga_pages == num_pages ? data_size : std::min(page_offsets[fpga_pages] + FPGA_SEGMENT_MARGIN, data_size);
+        fpga_thread = std::thread([&, fpga_data_size]() {
+            fletcher::Timer t;
+            t.start();
+            fpga_status = fpga_reader->read_prim(prim_width, last_read_stats.fpga_values, data, fpga_data_size, values->mutable_data());
+            t.stop();
+            last_read_stats.fpga_seconds = t.seconds();
+        });
+    }
+
+    status cpu_status = status::OK;
+    if(fpga_pages < num_pages) {
+        fletcher::Timer t;
+        t.start();
+        cpu_status = decode_pages(prim_width, data, page_offsets, first_values, fpga_pages, enc, values->mutable_data());
+        t.stop();
+        last_read_stats.cpu_seconds = t.seconds();
+    }
+
+    if(fpga_thread.joinable()) {
+        fpga_thread.join();
+    }
+    if(fpga_status != status::OK || cpu_status != status::OK) {
+        return status::FAIL;
+    }
+
+    // A side without pages keeps its last measurement
+    if(last_read_stats.fpga_values > 0 && last_read_stats.fpga_seconds > 0) {
+        fpga_throughput = last_read_stats.fpga_values/last_read_stats.fpga_seconds;
+    }
+    if(last_read_stats.cpu_values > 0 && last_read_stats.cpu_seconds > 0) {
+        cpu_throughput = last_read_stats.cpu_values/last_read_stats.cpu_seconds;
+    }
+
+    if(prim_width == 32) {
+        *prim_array = std::make_shared<arrow::Int32Array>(arrow::int32(), num_values, values);
+    } else {
+        *prim_array = std::make_shared<arrow::Int64Array>(arrow::int64(), num_values, values);
+    }
+
+    total.stop();
+    last_read_stats.total = total.seconds();
+    return status::OK;
+}
+
+}
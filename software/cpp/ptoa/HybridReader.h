@@ -0,0 +1,83 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+#include <arrow/api.h>
+
+#include "FpgaReader.h"
+#include "SWParquetReader.h"
+#include "ptoa.h"
+
+// Fraction of the values that is read by the FPGA as long as the throughput of either side hasn't been measured
+#define HYBRID_INITIAL_FPGA_FRACTION 0.5
+
+namespace ptoa{
+
+// Work done by both sides of the last hybrid read and the seconds they took. Both sides run at the same time, total is the
+// wall time of the whole read.
+struct hybrid_read_stats {
+    int64_t fpga_pages;
+    int64_t fpga_values;
+    double fpga_seconds;
+    int64_t cpu_pages;
+    int64_t cpu_values;
+    double cpu_seconds;
+    double total;
+};
+
+/**
+ * Reads an integer column chunk with the ParquetReader kernel and a multithreaded software decode at the same time. The page
+ * directory of the chunk is split in two: the FPGA converts the first pages through an FpgaReader, while num_threads threads
+ * decode the other pages one at a time with SWParquetReader::decode_page. Both write to their own part of one Arrow buffer.
+ *
+ * The split point is chosen from the throughput in values per second of both sides in the previous read, so that they finish
+ * at about the same time. It is rounded to the nearest page boundary, but either side keeps at least one page of a column
+ * chunk with several pages, so its throughput is measured again in every read. A side that is much slower than the other
+ * only reads that single page.
+ */
+class HybridReader {
+  public:
+    // fpga_reader has to be initialized and outlive this reader
+    HybridReader(FpgaReader* fpga_reader, int num_threads);
+
+    // data points to the first page, like for FpgaReader::read_prim. enc is the encoding the pages are decoded with on the CPU,
+    // it should match the kernel.
+    status read_prim(int32_t prim_width, int64_t num_values, const uint8_t* data, int64_t data_size, encoding enc, std::shared_ptr<arrow::PrimitiveArray>* prim_array);
+
+    // Fixes the fraction of the values read by the FPGA, 0 or 1 leave one side without pages. A negative fraction splits on
+    // the measured throughput again.
+    void set_fpga_fraction(double fpga_fraction) {this->fpga_fraction = fpga_fraction;}
+
+    const hybrid_read_stats& get_last_read_stats() const {return last_read_stats;}
+    // Values per second measured in the last read in which the side had pages, 0 if there was none yet
+    double get_fpga_throughput() const {return fpga_throughput;}
+    double get_cpu_throughput() const {return cpu_throughput;}
+
+  private:
+    status build_page_directory(const uint8_t* data, int64_t data_size, int64_t num_values, std::vector<int64_t>* page_offsets, std::vector<int64_t>* first_values);
+    size_t split_pages(const std::vector<int64_t>& first_values);
+    status decode_pages(int32_t prim_width, const uint8_t* data, const std::vector<int64_t>& page_offsets, const std::vector<int64_t>& first_values, size_t first_page, encoding enc, uint8_t* values);
+
+    FpgaReader* fpga_reader;
+    int num_threads;
+    double fpga_fraction;
+    double fpga_throughput;
+    double cpu_throughput;
+    hybrid_read_stats last_read_stats;
+};
+
+}
@@ -0,0 +1,315 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <algorithm>
+#include <limits>
+#include <chrono>
+#include <thread>
+
+#include "MultiKernelReader.h"
+#include "SWParquetReader.h"
+#include "trace.h"
+#include "ptoa.h"
+
+namespace ptoa {
+
+MultiKernelReader::MultiKernelReader() {
+    last_run_seconds = 0;
+}
+
+MultiKernelReader::~MultiKernelReader() {
+    for(instance_state& instance : instances) {
+        if(instance.pages_capacity > 0) {
+            platform->DeviceFree(instance.pages);
+        }
+        if(instance.values_capacity > 0) {
+            platform->DeviceFree(instance.values);
+        }
+    }
+}
+
+status MultiKernelReader::init(int num_instances, const std::string& name) {
+    if(num_instances < 1) {
+        std::cerr << "[ERROR] A device has at least one ParquetReader instance" << std::endl;
+        return status::FAIL;
+    }
+
+    const std::string platform_name = name.empty() ? FpgaReader::platform_from_env() : name;
+    fletcher::Status fletcher_status;
+    if(platform_name.empty()) {
+        fletcher_status = fletcher::Platform::Make(&platform, false);
+    } else {
+        fletcher_status = fletcher::Platform::Make(platform_name, &platform, false);
+    }
+    if(!fletcher_status.ok()) {
+        std::cerr << "[ERROR] Could not create Fletcher platform " << platform_name << std::endl;
+        return status::FAIL;
+    }
+
+    // Writing the register blocks of the instances to the registers of a single kernel wrapper would start it with garbage
+    if(platform->name() != FPGA_MULTI_INSTANCE_PLATFORM) {
+        std::cerr << "[ERROR] Platform " << platform->name() << " has no multi-instance wrapper, MultiKernelReader only runs on "
+                  << FPGA_MULTI_INSTANCE_PLATFORM << std::endl;
+        platform.reset();
+        return status::FAIL;
+    }
+
+    if(!platform->Init().ok()) {
+        std::cerr << "[ERROR] Could not initialize Fletcher platform " << platform->name() << std::endl;
+        return status::FAIL;
+    }
+
+    instances.resize(num_instances);
+    for(instance_state& instance : instances) {
+        instance.pages = 0;
+        instance.pages_capacity = 0;
+        instance.values = 0;
+        instance.values_capacity = 0;
+        instance.task = -1;
+    }
+
+    return status::OK;
+}
+
+status MultiKernelReader::device_realloc(da_t* address, int64_t* capacity, int64_t size) {
+    if(size <= *capacity) {
+        return status::OK;
+    }
+
+    if(*capacity > 0) {
+        platform->DeviceFree(*address);
+        *capacity = 0;
+    }
+    if(!platform->DeviceMalloc(address, size).ok()) {
+        std::cerr << "[ERROR] Could not allocate " << size << " bytes on the device" << std::endl;
+        return status::FAIL;
+    }
+    *capacity = size;
+
+    return status::OK;
+}
+
+void MultiKernelReader::write_register(int instance, uint64_t offset, uint32_t value) {
+    platform->WriteMMIO(FPGA_REG_BASE + instance*FPGA_INSTANCE_REGS + offset, value);
+}
+
+void MultiKernelReader::write_address(int instance, uint64_t offset, da_t address) {
+    dau_t mmio64_writer;
+    mmio64_writer.full = address;
+    write_register(instance, offset + 0, mmio64_writer.lo);
+    write_register(instance, offset + 1, mmio64_writer.hi);
+}
+
+status MultiKernelReader::is_done(int instance, bool* done) {
+    uint32_t instance_status;
+    if(!platform->ReadMMIO(FPGA_REG_BASE + instance*FPGA_INSTANCE_REGS + FPGA_INSTANCE_STATUS, &instance_status).ok()) {
+        std::cerr << "[ERROR] Could not read the status of instance " << instance << std::endl;
+        return status::FAIL;
+    }
+    *done = (instance_status & FPGA_STATUS_DONE) != 0;
+    return status::OK;
+}
+
+status MultiKernelReader::start_task(int instance, size_t task_index, const fpga_task& task) {
+    instance_state& state = instances[instance];
+    fpga_task_stats& stats = last_task_stats[task_index];
+    stats.instance = instance;
+
+    if(task.num_values > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "[ERROR] The kernels read at most " << std::numeric_limits<uint32_t>::max() << " values at once" << std::endl;
+        return status::FAIL;
+    }
+    if(device_realloc(&state.values, &state.values_capacity, task.num_values*task.prim_width/8) != status::OK) {
+        return status::FAIL;
+    }
+
+    if(device_realloc(&state.pages, &state.pages_capacity, task.data_size) != status::OK) {
+        return status::FAIL;
+    }
+
+    fletcher::Timer t;
+    t.start();
+    {
+        TraceSpan span("CopyHostToDevice", "transfer");
+        if(!platform->CopyHostToDevice(task.data, state.pages, task.data_size).ok()) {
+            std::cerr << "[ERROR] Could not copy " << task.data_size << " bytes to the device" << std::endl;
+            return status::FAIL;
+        }
+    }
+    t.stop();
+    stats.copy_to_device = t.seconds();
+
+    write_register(instance, FPGA_INSTANCE_CONTROL, FPGA_CONTROL_RESET);
+    write_register(instance, FPGA_INSTANCE_CONTROL, 0);
+    write_register(instance, FPGA_INSTANCE_NUM_VAL, (uint32_t) task.num_values);
+    write_address(instance, FPGA_INSTANCE_PAGE_ADDR, state.pages);
+    write_address(instance, FPGA_INSTANCE_MAX_SIZE, task.data_size);
+    write_address(instance, FPGA_INSTANCE_VALUES_ADDR, state.values);
+
+    state.timer.start();
+    write_register(instance, FPGA_INSTANCE_CONTROL, FPGA_CONTROL_START);
+    write_register(instance, FPGA_INSTANCE_CONTROL, 0);
+    state.task = task_index;
+    state.poll = poller.begin(task.data_size);
+    state.next_poll = poller.next_poll(&state.poll);
+
+    return status::OK;
+}
+
+status MultiKernelReader::finish_task(int instance, const fpga_task& task) {
+    instance_state& state = instances[instance];
+    fpga_task_stats& stats = last_task_stats[state.task];
+    state.timer.stop();
+    stats.processing = state.timer.seconds();
+    state.task = -1;
+
+    fletcher::Timer t;
+    t.start();
+    TraceSpan span("CopyDeviceToHost", "transfer");
+    if(!platform->CopyDeviceToHost(state.values, task.values, task.num_values*task.prim_width/8).ok()) {
+        std::cerr << "[ERROR] Could not copy " << task.num_values*task.prim_width/8 << " bytes from the device" << std::endl;
+        return status::FAIL;
+    }
+    t.stop();
+    stats.copy_to_host = t.seconds();
+
+    return status::OK;
+}
+
+// Tasks are started in order, each on the first free instance. Running instances are polled when their schedule says so, in
+// between the host sleeps until the first next poll.
+status MultiKernelReader::run_tasks(const std::vector<fpga_task>& tasks) {
+    if(!platform) {
+        std::cerr << "[ERROR] MultiKernelReader::init should be called before reading" << std::endl;
+        return status::FAIL;
+    }
+    for(const fpga_task& task : tasks) {
+        if(task.prim_width != 32 && task.prim_width != 64) {
+            std::cerr << "[ERROR] The kernels read 32 or 64 bit integers, not " << task.prim_width << " bit" << std::endl;
+            return status::FAIL;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(run_mutex);
+
+    fletcher::Timer total;
+    total.start();
+    last_task_stats.assign(tasks.size(), fpga_task_stats{-1, 0, 0, 0});
+    // Instances that were running when an earlier run failed are reset when they get their next task
+    for(instance_state& instance : instances) {
+        instance.task = -1;
+    }
+
+    size_t next_task = 0;
+    size_t finished_tasks = 0;
+    while(finished_tasks < tasks.size()) {
+        for(int i=0; i<(int) instances.size() && next_task < tasks.size(); i++) {
+            if(instances[i].task < 0) {
+                if(start_task(i, next_task, tasks[next_task]) != status::OK) {
+                    return status::FAIL;
+                }
+                next_task++;
+            }
+        }
+
+        bool any_done = false;
+        CompletionPoller::clock::time_point first_poll = CompletionPoller::clock::time_point::max();
+        for(int i=0; i<(int) instances.size(); i++) {
+            instance_state& state = instances[i];
+            if(state.task < 0) {
+                continue;
+            }
+
+            if(CompletionPoller::clock::now() >= state.next_poll) {
+                bool done;
+                if(is_done(i, &done) != status::OK) {
+                    return status::FAIL;
+                }
+                poller.polled(&state.poll, done);
+                if(done) {
+                    if(finish_task(i, tasks[state.task]) != status::OK) {
+                        return status::FAIL;
+                    }
+                    finished_tasks++;
+                    any_done = true;
+                    continue;
+                }
+                state.next_poll = poller.next_poll(&state.poll);
+            }
+            first_poll = std::min(first_poll, state.next_poll);
+        }
+
+        // Free instances get their next task right away
+        if(!any_done && first_poll != CompletionPoller::clock::time_point::max()) {
+            std::this_thread::sleep_until(first_poll);
+        }
+    }
+
+    total.stop();
+    last_run_seconds = total.seconds();
+    return status::OK;
+}
+
+status MultiKernelReader::split_column(int32_t prim_width, int64_t num_values, const uint8_t* data, int64_t data_size, int num_tasks, uint8_t* values, std::vector<fpga_task>* tasks) {
+    SWParquetReader page_reader;
+    fpga_task current = {prim_width, 0, data, 0, values};
+    int64_t offset = 0;
+    int64_t values_read = 0;
+
+    tasks->clear();
+    num_tasks = std::max(num_tasks, 1);
+
+    while(values_read < num_values) {
+        int32_t page_size;
+        int32_t page_num_values;
+        if(offset >= data_size || page_reader.read_page_size(data + offset, &page_size, &page_num_values) != status::OK || offset + page_size > data_size) {
+            std::cerr << "[ERROR] Could not read the page at offset " << offset << ", after " << values_read << " of " << num_values << " values" << std::endl;
+            return status::FAIL;
+        }
+
+        page_num_values = std::min((int64_t) page_num_values, num_values - values_read);
+        offset += page_size;
+        values_read += page_num_values;
+        current.num_values += page_num_values;
+
+        // Task k ends at the first page boundary after (k + 1)/num_tasks of the values. Like the segments of pipelined reads, a
+        // task may read a little past its last page.
+        if(values_read >= (int64_t) ((double) (tasks->size() + 1)/num_tasks*num_values) || values_read == num_values) {
+            current.data_size = std::min(data + offset + FPGA_SEGMENT_MARGIN, data + data_size) - current.data;
+            tasks->push_back(current);
+            current = fpga_task{prim_width, 0, data + offset, 0, values + values_read*prim_width/8};
+        }
+    }
+
+    return status::OK;
+}
+
+status MultiKernelReader::read_prim(int32_t prim_width, int64_t num_values, const uint8_t* data, int64_t data_size, std::shared_ptr<arrow::PrimitiveArray>* prim_array) {
+    std::shared_ptr<arrow::Buffer> values;
+    std::vector<fpga_task> tasks;
+    if(allocate_buffer(num_values*prim_width/8, &values) != status::OK ||
+       split_column(prim_width, num_values, data, data_size, get_num_instances(), values->mutable_data(), &tasks) != status::OK ||
+       run_tasks(tasks) != status::OK) {
+        return status::FAIL;
+    }
+
+    if(prim_width == 32) {
+        *prim_array = std::make_shared<arrow::Int32Array>(arrow::int32(), num_values, values);
+    } else {
+        *prim_array = std::make_shared<arrow::Int64Array>(arrow::int64(), num_values, values);
+    }
+
+    return status::OK;
+}
+
+}
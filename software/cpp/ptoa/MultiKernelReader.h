@@ -0,0 +1,131 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <arrow/api.h>
+
+#include "fletcher/api.h"
+
+#include "FpgaReader.h"
+#include "ptoa.h"
+
+// Register blocks of the ParquetReader instances of a multi-instance wrapper. The block of instance i starts at
+// FPGA_REG_BASE + i*FPGA_INSTANCE_REGS, every instance has its own control and status register and writes its values to an
+// address of its own instead of the one Fletcher manages. There is no hardware wrapper with this layout yet, only the emulated
+// device in software/cpp/emu implements it. Coordinate with the wrapper once there is one.
+#define FPGA_INSTANCE_REGS 9
+#define FPGA_INSTANCE_CONTROL 0
+#define FPGA_INSTANCE_STATUS 1
+#define FPGA_INSTANCE_NUM_VAL 2
+#define FPGA_INSTANCE_PAGE_ADDR 3
+#define FPGA_INSTANCE_MAX_SIZE 5
+#define FPGA_INSTANCE_VALUES_ADDR 7
+
+// The only platform with the register blocks above, the emulated device. init refuses all others.
+#define FPGA_MULTI_INSTANCE_PLATFORM "ptoa_emu"
+
+namespace ptoa{
+
+// Integer values of whole pages that are converted by a single instance. data points to the first page, data_size bytes from
+// there on may be read by the instance. The values are written to host memory with room for num_values values.
+struct fpga_task {
+    int32_t prim_width;
+    int64_t num_values;
+    const uint8_t* data;
+    int64_t data_size;
+    uint8_t* values;
+};
+
+// Instance that ran a task and the seconds spent in every step. Processing runs from the start of the instance until its done
+// bit was seen, so it includes the time between the last two polls.
+struct fpga_task_stats {
+    int instance;
+    double copy_to_device;
+    double processing;
+    double copy_to_host;
+};
+
+/**
+ * Host runtime for devices with several ParquetReader instances, each with its own register block and device buffers.
+ *
+ * run_tasks hands a list of tasks, like the columns of a row group or the page ranges of one column chunk made by
+ * split_column, to the instances. A task is started as soon as an instance is free, and the status registers of the running
+ * instances are polled on a schedule of their own from one CompletionPoller, so results are copied back in the order in which
+ * the instances finish.
+ */
+class MultiKernelReader {
+  public:
+    MultiKernelReader();
+    ~MultiKernelReader();
+    MultiKernelReader(const MultiKernelReader&) = delete;
+    MultiKernelReader& operator=(const MultiKernelReader&) = delete;
+
+    // Creates the Fletcher platform with the given name, or the one FpgaReader::init would pick without a name, for a device
+    // with num_instances instances. Fails for platforms other than FPGA_MULTI_INSTANCE_PLATFORM, whose registers are laid out
+    // differently.
+    status init(int num_instances, const std::string& platform_name = "");
+
+    status run_tasks(const std::vector<fpga_task>& tasks);
+    // Spreads the pages of one integer column chunk over all instances
+    status read_prim(int32_t prim_width, int64_t num_values, const uint8_t* data, int64_t data_size, std::shared_ptr<arrow::PrimitiveArray>* prim_array);
+
+    // Splits the pages of a column chunk in num_tasks tasks of about the same number of values, that write to their own part of
+    // values
+    static status split_column(int32_t prim_width, int64_t num_values, const uint8_t* data, int64_t data_size, int num_tasks, uint8_t* values, std::vector<fpga_task>* tasks);
+
+    int get_num_instances() const {return (int) instances.size();}
+    // Stats of every task of the last run, in the order of the tasks
+    const std::vector<fpga_task_stats>& get_last_task_stats() const {return last_task_stats;}
+    double get_last_run_seconds() const {return last_run_seconds;}
+
+    // Polls every interval_us microseconds, 0 (default) polls adaptively, see CompletionPoller
+    void set_poll_interval(int interval_us) {poller.set_fixed_interval(interval_us);}
+    poll_stats get_poll_stats() const {return poller.get_stats();}
+    void clear_poll_stats() {poller.clear_stats();}
+
+  private:
+    // Device buffers of an instance and the task it is running
+    struct instance_state {
+        da_t pages;
+        int64_t pages_capacity;
+        da_t values;
+        int64_t values_capacity;
+        int64_t task;
+        fletcher::Timer timer;
+        CompletionPoller::poll_state poll;
+        CompletionPoller::clock::time_point next_poll;
+    };
+
+    status start_task(int instance, size_t task_index, const fpga_task& task);
+    status finish_task(int instance, const fpga_task& task);
+    status is_done(int instance, bool* done);
+    void write_register(int instance, uint64_t offset, uint32_t value);
+    void write_address(int instance, uint64_t offset, da_t address);
+    status device_realloc(da_t* address, int64_t* capacity, int64_t size);
+
+    std::shared_ptr<fletcher::Platform> platform;
+
+    std::vector<instance_state> instances;
+    CompletionPoller poller;
+    std::vector<fpga_task_stats> last_task_stats;
+    double last_run_seconds;
+    std::mutex run_mutex;
+};
+
+}
@@ -11,8 +11,6 @@
 // limitations under the License.
 
 
-#include <arrow/array/builder_binary.h>
-#include <arrow/array/builder_primitive.h>
 #include <arrow/io/file.h>
 #include <arrow/memory_pool.h>
 #include <arrow/result.h>
@@ -25,6 +23,7 @@
 #include <parquet/properties.h>
 #include <parquet/types.h>
 #include <climits>
+#include <limits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -34,22 +33,12 @@
 #include <vector>
 #include <cmath>
 
-#define NAMEBUFSIZE 64
-
-std::string gen_random_string(const int length) {
-    static const char alphanum[] =
-            "0123456789"
-            "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-            "abcdefghijklmnopqrstuvwxyz";
-
-    std::string result(length, 0);
+#include "datagen.h"
 
-    for (int i = 0; i < length; ++i) {
-        result[i] = alphanum[rand() % (sizeof(alphanum) - 1)];
-    }
+#define NAMEBUFSIZE 64
 
-    return result;
-}
+// Column c is generated with seed SEED + c, so the columns are not correlated
+#define SEED 123
 
 std::shared_ptr<arrow::Table> generate_int64_table(int num_values, int nCols, bool deltaVaried) {
     //Create the schema
@@ -61,26 +50,23 @@ std::shared_ptr<arrow::Table> generate_int64_table(int num_values, int nCols, bo
     }
     std::shared_ptr<arrow::Schema> schema = arrow::schema(fields);
 
-    //Generate the values
+    //Generate the values. With deltaVaried every miniblock of deltas gets a random bit packing width.
+    datagen::int_options options;
+    if (deltaVaried) {
+    	options.distribution = datagen::BIT_WIDTH_MIX;
+    	options.bit_widths.clear();
+    	for (int width = 0; width < 63; width++) {
+    		options.bit_widths.push_back(width);
+    	}
+    } else {
+    	options.min = std::numeric_limits<int64_t>::min();
+    	options.max = std::numeric_limits<int64_t>::max();
+    }
+
     std::vector<std::shared_ptr<arrow::Array>> arrays;
     for (int c = 0; c < nCols; c++) {
-		arrow::Int64Builder i64builder;
-		long modulo = std::pow(2, (rand() % 63));
-		for (int i = 0; i < num_values; i++) {
-			long number;
-			if (deltaVaried) {
-				number = (((long)rand() << 32) | rand()) % modulo;
-				if ((i % 256) == 0) {
-					modulo = std::pow(2, (rand() % 63));
-				}
-			} else {
-				number = ((long)rand() << 32) | rand();
-			}
-			PARQUET_THROW_NOT_OK(i64builder.Append(number));
-
-		}
 		std::shared_ptr<arrow::Array> i64array;
-		PARQUET_THROW_NOT_OK(i64builder.Finish(&i64array));
+		PARQUET_ASSIGN_OR_THROW(i64array, datagen::generate_int64(num_values, options, SEED + c));
 		arrays.push_back(i64array);
     }
 
@@ -97,26 +83,20 @@ std::shared_ptr<arrow::Table> generate_int32_table(int num_values, int nCols, bo
     }
     std::shared_ptr<arrow::Schema> schema = arrow::schema(fields);
 
-    //Generate the values
+    //Generate the values. With deltaVaried every miniblock of deltas gets a random bit packing width.
+    datagen::int_options options;
+    if (deltaVaried) {
+    	options.distribution = datagen::BIT_WIDTH_MIX;
+    	options.bit_widths.clear();
+    	for (int width = 0; width < 31; width++) {
+    		options.bit_widths.push_back(width);
+    	}
+    }
+
     std::vector<std::shared_ptr<arrow::Array>> arrays;
     for (int c = 0; c < nCols; c++) {
-		arrow::Int32Builder i32builder;
-		long modulo = std::pow(2, (rand() % 31));
-		for (int i = 0; i < num_values; i++) {
-			long number;
-			if (deltaVaried) {
-				number = rand() % modulo;
-				if ((i % 256) == 0) {
-					modulo = std::pow(2, (rand() % 31));
-				}
-			} else {
-				number = rand();
-			}
-			PARQUET_THROW_NOT_OK(i32builder.Append(number));
-
-		}
 		std::shared_ptr<arrow::Array> i32array;
-		PARQUET_THROW_NOT_OK(i32builder.Finish(&i32array));
+		PARQUET_ASSIGN_OR_THROW(i32array, datagen::generate_int32(num_values, options, SEED + c));
 		arrays.push_back(i32array);
     }
 
@@ -134,15 +114,14 @@ std::shared_ptr<arrow::Table> generate_str_table(int num_values, int nCols, int
     std::shared_ptr<arrow::Schema> schema = arrow::schema(fields);
 
     //Generate the values
+    datagen::string_options options;
+    options.min_length = min_length;
+    options.max_length = max_length;
+
     std::vector<std::shared_ptr<arrow::Array>> arrays;
     for (int c = 0; c < nCols; c++) {
-		arrow::StringBuilder strbuilder;
-		for (int i = 0; i < num_values; i++) {
-			int length = rand() % (max_length - min_length + 1) + min_length;
-			PARQUET_THROW_NOT_OK(strbuilder.Append(gen_random_string(length)));
-		}
 		std::shared_ptr<arrow::Array> strarray;
-		PARQUET_THROW_NOT_OK(strbuilder.Finish(&strarray));
+		PARQUET_ASSIGN_OR_THROW(strarray, datagen::generate_strings(num_values, options, SEED + c));
 		arrays.push_back(strarray);
     }
     return arrow::Table::Make(schema, arrays);
@@ -179,7 +158,6 @@ void write_parquet(std::shared_ptr<arrow::Table> table, std::string name) {
 }
 
 int main(int argc, char **argv) {
-	srand(123);
 	int nRows = 100;
 	int nCols = 1;
 	enum Datatype {int32, int64, str};